@@ -0,0 +1,57 @@
+#include <new>
+#include <atomic>
+#include <cstdlib>
+
+#include "allocations.h"
+
+
+static std::atomic<uint64_t> _allocations(0);
+
+
+void *operator new(std::size_t size) {
+	void *ret;
+
+	_allocations.fetch_add(1, std::memory_order_relaxed);
+
+	ret = malloc(size ? size : 1);
+	if (ret == nullptr) {
+		throw std::bad_alloc();
+	}
+
+	return ret;
+}
+
+
+void *operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+
+void operator delete(void *ptr) noexcept {
+	free(ptr);
+}
+
+
+void operator delete[](void *ptr) noexcept {
+	free(ptr);
+}
+
+
+void operator delete(void *ptr, std::size_t size) noexcept {
+	free(ptr);
+}
+
+
+void operator delete[](void *ptr, std::size_t size) noexcept {
+	free(ptr);
+}
+
+
+uint64_t allocations_get() {
+	return _allocations.load(std::memory_order_relaxed);
+}
+
+
+void allocations_report(benchmark::State &state, uint64_t start) {
+	state.counters["allocs/op"] = benchmark::Counter(allocations_get() - start, benchmark::Counter::kAvgIterations);
+}
@@ -0,0 +1,19 @@
+#ifndef BENCH_ALLOCATIONS_H_
+#define BENCH_ALLOCATIONS_H_
+
+#include <cstdint>
+
+#include <benchmark/benchmark.h>
+
+/*
+ * Number of heap allocations done by the whole process so far, counted by
+ * replaced global operator new.
+ */
+uint64_t allocations_get();
+
+/*
+ * Reports allocations done since start as "allocs/op" counter.
+ */
+void allocations_report(benchmark::State &state, uint64_t start);
+
+#endif /* BENCH_ALLOCATIONS_H_ */
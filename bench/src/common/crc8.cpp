@@ -0,0 +1,136 @@
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "common/crc8.h"
+#include "common/protocol.h"
+#include "common/protocol/packet.h"
+
+
+/* Bit by bit calculation, the way CRC8 was calculated before lookup tables */
+static uint8_t _crc8GetForByteBitwise(uint8_t byte, uint8_t polynomial, uint8_t start) {
+	uint8_t remainder = start ^ byte;
+
+	for (int bit = 0; bit < 8; bit++) {
+		remainder = (remainder & 0x01) ? (remainder >> 1) ^ polynomial : (remainder >> 1);
+	}
+
+	return remainder;
+}
+
+
+static std::vector<uint8_t> _getData(size_t size) {
+	std::vector<uint8_t> ret(size);
+
+	for (size_t i = 0; i < size; i++) {
+		ret[i] = i * 7 + 3;
+	}
+
+	return ret;
+}
+
+
+static void BM_crc8_getForByte_bitwise(benchmark::State &state) {
+	auto data = _getData(state.range(0));
+
+	for (auto _ : state) {
+		uint8_t crc = PROTO_CRC8_START;
+
+		for (auto b : data) {
+			crc = _crc8GetForByteBitwise(b, PROTO_CRC8_POLY, crc);
+		}
+
+		benchmark::DoNotOptimize(crc);
+	}
+
+	state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_crc8_getForByte_bitwise)->Arg(64)->Arg(4096);
+
+
+static void BM_crc8_getForByte(benchmark::State &state) {
+	auto data = _getData(state.range(0));
+
+	for (auto _ : state) {
+		uint8_t crc = PROTO_CRC8_START;
+
+		for (auto b : data) {
+			crc = crc8_getForByte(b, PROTO_CRC8_POLY, crc);
+		}
+
+		benchmark::DoNotOptimize(crc);
+	}
+
+	state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_crc8_getForByte)->Arg(64)->Arg(4096);
+
+
+static void BM_crc8_get(benchmark::State &state) {
+	auto data = _getData(state.range(0));
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(crc8_get(data.data(), data.size(), PROTO_CRC8_POLY, PROTO_CRC8_START));
+	}
+
+	state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_crc8_get)->Arg(64)->Arg(4096);
+
+
+static uint16_t _encodeFrame(std::vector<uint8_t> &frame, uint16_t payloadSize) {
+	ProtoPkt pkt;
+
+	proto_pkt_init(&pkt, frame.data(), frame.size(), PROTO_CMD_SPI_TRANSFER, 0x12);
+	proto_pkt_prepare(&pkt, frame.data(), frame.size(), payloadSize);
+
+	for (uint16_t i = 0; i < pkt.payloadSize; i++) {
+		pkt.payload[i] = i * 7 + 3;
+	}
+
+	return proto_pkt_encode(&pkt, frame.data(), frame.size());
+}
+
+
+static void BM_proto_pkt_dec_putByte(benchmark::State &state) {
+	std::vector<uint8_t> frame(state.range(0) + 8);
+	std::vector<uint8_t> rxBuffer(frame.size());
+	uint16_t             frameSize = _encodeFrame(frame, state.range(0));
+
+	for (auto _ : state) {
+		ProtoPktDes ctx;
+		ProtoPkt    pkt;
+		uint8_t     ret = PROTO_PKT_DES_RET_IDLE;
+
+		proto_pkt_dec_setup(&ctx, rxBuffer.data(), rxBuffer.size());
+
+		for (uint16_t i = 0; i < frameSize; i++) {
+			ret = proto_pkt_dec_putByte(&ctx, frame[i], &pkt);
+		}
+
+		benchmark::DoNotOptimize(ret);
+	}
+
+	state.SetBytesProcessed(state.iterations() * frameSize);
+}
+BENCHMARK(BM_proto_pkt_dec_putByte)->Arg(64)->Arg(255)->Arg(4096);
+
+
+static void BM_proto_pkt_dec_putBytes(benchmark::State &state) {
+	std::vector<uint8_t> frame(state.range(0) + 8);
+	std::vector<uint8_t> rxBuffer(frame.size());
+	uint16_t             frameSize = _encodeFrame(frame, state.range(0));
+
+	for (auto _ : state) {
+		ProtoPktDes ctx;
+		ProtoPkt    pkt;
+		uint16_t    consumed;
+
+		proto_pkt_dec_setup(&ctx, rxBuffer.data(), rxBuffer.size());
+
+		benchmark::DoNotOptimize(proto_pkt_dec_putBytes(&ctx, frame.data(), frameSize, &consumed, &pkt));
+	}
+
+	state.SetBytesProcessed(state.iterations() * frameSize);
+}
+BENCHMARK(BM_proto_pkt_dec_putBytes)->Arg(64)->Arg(255)->Arg(4096);
@@ -0,0 +1,114 @@
+#include <vector>
+#include <cstring>
+
+#include <benchmark/benchmark.h>
+
+#include "common/protocol.h"
+#include "common/protocol/packet.h"
+#include "common/protocol/request.h"
+
+#include "../allocations.h"
+
+
+static void BM_proto_pkt_encode(benchmark::State &state) {
+	std::vector<uint8_t> frame(state.range(0) + 8);
+	uint64_t             allocations = allocations_get();
+	uint16_t             frameSize   = 0;
+
+	for (auto _ : state) {
+		ProtoPkt pkt;
+
+		proto_pkt_init(&pkt, frame.data(), frame.size(), PROTO_CMD_SPI_TRANSFER, 0x12);
+		proto_pkt_prepare(&pkt, frame.data(), frame.size(), state.range(0));
+
+		// Data differs byte by byte, so RLE does not shorten it
+		for (uint16_t i = 0; i < pkt.payloadSize; i++) {
+			pkt.payload[i] = i * 7 + 3;
+		}
+
+		frameSize = proto_pkt_encode(&pkt, frame.data(), frame.size());
+
+		benchmark::DoNotOptimize(frameSize);
+	}
+
+	state.SetBytesProcessed(state.iterations() * frameSize);
+
+	allocations_report(state, allocations);
+}
+BENCHMARK(BM_proto_pkt_encode)->Arg(64)->Arg(255)->Arg(4096);
+
+
+static void _fillTransfer(ProtoReq &request, uint16_t txSize) {
+	ProtoReqTransfer &t = request.request.transfer;
+
+	t.txBufferSize = txSize;
+	t.rxBufferSize = txSize;
+	t.rxSkipSize   = 4;
+	t.flags        = PROTO_SPI_TRANSFER_FLAG_KEEP_CS;
+}
+
+
+/*
+ * TX data of SPI_TRANSFER is used in place, so encoding time does not depend
+ * on its size.
+ */
+static void BM_proto_req_encode(benchmark::State &state) {
+	std::vector<uint8_t> payload(state.range(0) + 16);
+	std::vector<uint8_t> data(state.range(0), 0x5a);
+	uint64_t             allocations = allocations_get();
+	uint16_t             size        = 0;
+
+	for (auto _ : state) {
+		ProtoReq request;
+
+		proto_req_init(&request, payload.data(), payload.size(), PROTO_CMD_SPI_TRANSFER);
+		_fillTransfer(request, data.size());
+
+		size = proto_req_getPayloadSize(&request);
+
+		proto_req_assign(&request, payload.data(), size);
+		memcpy(request.request.transfer.txBuffer, data.data(), data.size());
+
+		benchmark::DoNotOptimize(proto_req_encode(&request, payload.data(), size));
+	}
+
+	state.SetBytesProcessed(state.iterations() * size);
+
+	allocations_report(state, allocations);
+}
+BENCHMARK(BM_proto_req_encode)->Arg(16)->Arg(255)->Arg(4096);
+
+
+static void BM_proto_req_decode(benchmark::State &state) {
+	std::vector<uint8_t> payload(state.range(0) + 16);
+	uint64_t             allocations;
+	uint16_t             size;
+
+	{
+		ProtoReq request;
+
+		proto_req_init(&request, payload.data(), payload.size(), PROTO_CMD_SPI_TRANSFER);
+		_fillTransfer(request, state.range(0));
+
+		size = proto_req_getPayloadSize(&request);
+
+		proto_req_assign(&request, payload.data(), size);
+		proto_req_encode(&request, payload.data(), size);
+	}
+
+	allocations = allocations_get();
+
+	for (auto _ : state) {
+		ProtoReq request;
+
+		proto_req_init(&request, payload.data(), size, PROTO_CMD_SPI_TRANSFER);
+
+		benchmark::DoNotOptimize(proto_req_decode(&request, payload.data(), size));
+		benchmark::DoNotOptimize(request.request.transfer.txBuffer);
+	}
+
+	state.SetBytesProcessed(state.iterations() * size);
+
+	allocations_report(state, allocations);
+}
+BENCHMARK(BM_proto_req_decode)->Arg(16)->Arg(255)->Arg(4096);
@@ -0,0 +1,115 @@
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+#include <benchmark/benchmark.h>
+
+#include "common/protocol.h"
+
+#include "firmware/programmer.h"
+
+#include "flashutil/spi/serial.h"
+#include "flashutil/exception.h"
+
+#include "../allocations.h"
+
+
+/*
+ * In-memory link to firmware programmer, SPI bus returns sent bytes and
+ * pattern when nothing is sent.
+ */
+class LoopbackSerial : public Serial {
+	public:
+		LoopbackSerial(size_t packetSize, uint8_t windowSize) : _packetBuffer(packetSize) {
+			programmer_setup(&this->_programmer, this->_packetBuffer.data(), this->_packetBuffer.size(), _requestCallback, _responseCallback, this);
+			programmer_setWindowSize(&this->_programmer, windowSize);
+		}
+
+		void write(void *buffer, std::size_t bufferSize, int timeoutMs) override {
+			programmer_putBytes(&this->_programmer, (const uint8_t *) buffer, bufferSize);
+		}
+
+		void read(void *buffer, std::size_t bufferSize, int timeoutMs) override {
+			this->readSome(buffer, bufferSize, bufferSize, timeoutMs);
+		}
+
+		std::size_t readSome(void *buffer, std::size_t minSize, std::size_t bufferSize, int timeoutMs) override {
+			size_t size = std::min(bufferSize, this->_output.size());
+
+			if (size < minSize) {
+				throw_Exception("Not enough data in buffer!");
+			}
+
+			std::copy(this->_output.begin(), this->_output.begin() + size, (uint8_t *) buffer);
+
+			this->_output.erase(this->_output.begin(), this->_output.begin() + size);
+
+			return size;
+		}
+
+	private:
+		static void _requestCallback(ProtoReq *request, ProtoRes *response, void *callbackData) {
+			if (request->cmd != PROTO_CMD_SPI_TRANSFER) {
+				return;
+			}
+
+			{
+				ProtoReqTransfer &req = request->request.transfer;
+				ProtoResTransfer &res = response->response.transfer;
+
+				uint16_t total = std::max<uint16_t>(req.txBufferSize, req.rxSkipSize + req.rxBufferSize);
+
+				for (uint16_t i = req.rxSkipSize; i < total && i - req.rxSkipSize < res.rxBufferSize; i++) {
+					res.rxBuffer[i - req.rxSkipSize] = i < req.txBufferSize ? req.txBuffer[i] : (uint8_t) (i * 7 + 3);
+				}
+			}
+		}
+
+		static void _responseCallback(uint8_t *buffer, uint16_t bufferSize, void *callbackData) {
+			LoopbackSerial *self = (LoopbackSerial *) callbackData;
+
+			self->_output.insert(self->_output.end(), buffer, buffer + bufferSize);
+		}
+
+	private:
+		Programmer           _programmer;
+		std::vector<uint8_t> _packetBuffer;
+		std::deque<uint8_t>  _output;
+};
+
+
+/*
+ * Message sends range(0) bytes and receives the same amount, frames carry
+ * up to range(1) bytes.
+ */
+static void BM_SerialSpi_transfer(benchmark::State &state) {
+	LoopbackSerial serial(state.range(1), 4);
+	SerialSpi      spi(serial);
+	uint64_t       allocations;
+
+	std::vector<uint8_t> data(state.range(0));
+
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = i * 13 + 1;
+	}
+
+	spi.attach();
+
+	allocations = allocations_get();
+
+	for (auto _ : state) {
+		Spi::Messages msgs;
+
+		msgs.add().send().data(data.data(), data.size());
+		msgs.at(0).recv().bytes(data.size());
+
+		spi.transfer(msgs);
+
+		benchmark::DoNotOptimize(msgs.at(0).recv().data().data());
+	}
+
+	state.SetBytesProcessed(state.iterations() * data.size() * 2);
+
+	allocations_report(state, allocations);
+}
+BENCHMARK(BM_SerialSpi_transfer)->Args({16, 64})->Args({4096, 255})->Args({4096, 4096});
@@ -0,0 +1,47 @@
+#include <benchmark/benchmark.h>
+
+#include "flashutil/spi.h"
+
+#include "../allocations.h"
+
+
+static void BM_Spi_RecvOpts_bytes(benchmark::State &state) {
+	uint64_t allocations = allocations_get();
+
+	for (auto _ : state) {
+		Spi::Message msg;
+
+		msg.recv().bytes(state.range(0));
+
+		benchmark::DoNotOptimize(msg.recv().data().data());
+	}
+
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+
+	allocations_report(state, allocations);
+}
+BENCHMARK(BM_Spi_RecvOpts_bytes)->Arg(16)->Arg(256)->Arg(64 * 1024);
+
+
+/*
+ * Skipped bytes received while command, address and dummy bytes are sent.
+ */
+static void BM_Spi_RecvOpts_getSkipMap(benchmark::State &state) {
+	Spi::Message msg;
+	uint64_t     allocations;
+
+	msg.recv().skip(state.range(0)).bytes(256);
+
+	allocations = allocations_get();
+
+	for (auto _ : state) {
+		auto skipMap = msg.recv().getSkipMap();
+
+		benchmark::DoNotOptimize(skipMap.size());
+	}
+
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+
+	allocations_report(state, allocations);
+}
+BENCHMARK(BM_Spi_RecvOpts_getSkipMap)->Arg(5)->Arg(64)->Arg(4096);
@@ -0,0 +1,80 @@
+# Generates lookup tables of reflected CRC calculation for polynomial defined
+# by a macro of C header (e.g. PROTO_CRC8_POLY defined in common/protocol.h).
+#
+# Table 0 is used to calculate CRC a byte at a time, table N contains CRC of
+# byte followed by N zero bytes and it is used by slice-by-N calculation.
+#
+# Usage: crc_generate_table(<name> <width> <header path> <poly macro> <slices> <output header path>)
+#
+# Generated header defines <name>_TABLE_POLY and <name>_TABLE_0 ...
+# <name>_TABLE_<slices - 1> initializers.
+
+function(crc_generate_table name width header poly_macro slices output)
+	file(STRINGS ${header} poly_line REGEX "^#define ${poly_macro} ")
+	string(REGEX REPLACE "^#define ${poly_macro} +(0x[0-9A-Fa-f]+).*$" "\\1" poly_hex "${poly_line}")
+
+	math(EXPR poly "${poly_hex}")
+	math(EXPR digits "${width} / 4")
+	math(EXPR last_slice "${slices} - 1")
+
+	set(slice0)
+	foreach(value RANGE 255)
+		set(crc ${value})
+
+		foreach(bit RANGE 7)
+			math(EXPR lsb "${crc} & 1")
+			math(EXPR crc "${crc} >> 1")
+
+			if(lsb)
+				math(EXPR crc "${crc} ^ ${poly}")
+			endif()
+		endforeach()
+
+		list(APPEND slice0 ${crc})
+	endforeach()
+
+	set(content "/*\n * Generated by common/cmake/crc_table.cmake, do not edit.\n */\n\n")
+	string(APPEND content "#define ${name}_TABLE_POLY ${poly_hex}\n")
+
+	set(slice ${slice0})
+	foreach(n RANGE ${last_slice})
+		set(line "")
+		set(entries "")
+		set(next)
+		set(column 0)
+
+		foreach(crc ${slice})
+			math(EXPR hex "${crc}" OUTPUT_FORMAT HEXADECIMAL)
+			string(SUBSTRING "${hex}" 2 -1 hex)
+			string(LENGTH "${hex}" length)
+			while(length LESS digits)
+				set(hex "0${hex}")
+				math(EXPR length "${length} + 1")
+			endwhile()
+
+			string(APPEND line " 0x${hex},")
+
+			math(EXPR column "${column} + 1")
+			if(column EQUAL 16 OR (digits GREATER 4 AND column EQUAL 8))
+				string(APPEND entries "\t${line} \\\n")
+				set(line "")
+				set(column 0)
+			endif()
+
+			# CRC of the same byte followed by one more zero byte
+			math(EXPR index "${crc} & 0xff")
+			list(GET slice0 ${index} shifted)
+			math(EXPR shifted "(${crc} >> 8) ^ ${shifted}")
+			list(APPEND next ${shifted})
+		endforeach()
+
+		string(APPEND content "\n#define ${name}_TABLE_${n} { \\\n${entries}}\n")
+
+		set(slice ${next})
+	endforeach()
+
+	file(WRITE ${output}.tmp "${content}")
+	configure_file(${output}.tmp ${output} COPYONLY)
+
+	set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${header})
+endfunction()
@@ -0,0 +1,31 @@
+/*
+ * common/crc16.h
+ *
+ *  Created on: 17 paz 2026
+ *      Author: Jaroslaw Bielski (bielski.j@gmail.com)
+ */
+
+#ifndef COMMON_INCLUDE_CRC16_H_
+#define COMMON_INCLUDE_CRC16_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * CRC-16/KERMIT (CCITT, reflected polynomial 0x8408). Value returned for
+ * a buffer can be passed as crc argument to continue calculation with the
+ * next buffer. Calculation starts with crc equal to CRC16_START.
+ */
+#define CRC16_POLY  0x8408
+#define CRC16_START 0x0000
+
+uint16_t crc16_get(const uint8_t *buffer, uint16_t bufferSize, uint16_t crc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COMMON_INCLUDE_CRC16_H_ */
@@ -0,0 +1,31 @@
+/*
+ * common/crc32.h
+ *
+ *  Created on: 17 paz 2026
+ *      Author: Jaroslaw Bielski (bielski.j@gmail.com)
+ */
+
+#ifndef COMMON_INCLUDE_CRC32_H_
+#define COMMON_INCLUDE_CRC32_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320). Value returned for
+ * a buffer can be passed as crc argument to continue calculation with the
+ * next buffer. Calculation starts with crc equal to CRC32_START.
+ */
+#define CRC32_POLY  0xEDB88320UL
+#define CRC32_START 0x00000000UL
+
+uint32_t crc32_get(const uint8_t *buffer, uint16_t bufferSize, uint32_t crc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COMMON_INCLUDE_CRC32_H_ */
@@ -17,34 +17,61 @@
 #define PROTO_CRC8_POLY  0xAB
 #define PROTO_CRC8_START 0x00
 
-#define PROTO_SYNC_NIBBLE_MASK 0xf0
-#define PROTO_SYNC_NIBBLE      0xd0
+#define PROTO_SYNC_NIBBLE_MASK  0xf0
+#define PROTO_SYNC_NIBBLE       0xd0
+#define PROTO_SYNC_NIBBLE_CRC16 0xe0
+#define PROTO_SYNC_NIBBLE_CRC32 0xb0
 
-#define PROTO_CMD_NIBBLE_MASK  0x07
+#define PROTO_CMD_NIBBLE_MASK  0x0f
 
 #define PROTO_FRAME_MIN_SIZE 5
 
+/*
+ * Frame checksum types. Bitmap of types supported by the programmer is
+ * reported by GET_INFO command (PROTO_CHECKSUM_MASK).
+ */
+#define PROTO_CHECKSUM_CRC8  0x0
+#define PROTO_CHECKSUM_CRC16 0x1
+#define PROTO_CHECKSUM_CRC32 0x2
+
+#define PROTO_CHECKSUM_MASK(_checksum) (1 << (_checksum))
+
 /*
  * VLEN field definition.
  *
  * VLEN is a variable length field containing unsigned integer value. It is:
  *  - 1B length if the MSB bit is cleared. Allowed integer range is 0 - 127
  *  - 2B length if the MSB bit is set. Allowed integer range is 0 - 32767
+ *
+ * VLEN limits payload of a single frame to PROTO_INT_VAL_MAX bytes.
  */
+#define PROTO_INT_VAL_MAX 0x7fff
 
 /*
  * 1) Protocol frame.
  *
- * [      8b      ][ 1B ][ 1/2B ][       VLEN       ]
- * [  4b  ][  4b  ][    ][      ][     ][   ][      ]
- * [ SYNC ][ CTRL ][ ID ][ VLEN ][ PLD ][...][ CRC8 ]
+ * [      8b      ][ 1B ][ 1/2B ][       VLEN       ][  1/2/4B  ]
+ * [  4b  ][  4b  ][    ][      ][     ][   ][      ][          ]
+ * [ SYNC ][ CTRL ][ ID ][ VLEN ][ PLD ][...][      ][ CHECKSUM ]
  *
- * SYNC: Synchronization byte. Always 0xd.
- * CTRL: [R...] command (request) or error code (response) MSB bit is reserved for future use. Should be set to 0.
+ * SYNC: Synchronization nibble. It selects checksum of the frame:
+ *         - 0xd - CRC8 (PROTO_CRC8_POLY), always supported
+ *         - 0xe - CRC16 (common/crc16.h)
+ *         - 0xb - CRC32 (common/crc32.h)
+ * CTRL: command (request) or error code (response).
  * ID:   Command unique identifier. Used to recognize response frame.
- * VLEN: Length of payload data (does not include CRC8 field)
+ * VLEN: Length of payload data (does not include CHECKSUM field)
  * PLD:  Frame payload
- * CRC8: Checksum of overall frame
+ * CHECKSUM: Checksum of overall frame, big endian
+ *
+ * The programmer answers with the checksum type of the request. The host may
+ * use any of checksums reported by GET_INFO command.
+ *
+ * A request which cannot be executed is answered at once with a NAK frame:
+ * error code (PROTO_ERROR_*) in CTRL, ID of the request and no payload.
+ * Frames broken on the link (PROTO_ERROR_INVALID_CRC,
+ * PROTO_ERROR_INVALID_LENGTH) are answered with the ID read from their
+ * header, which may be damaged as well.
  */
 
 /*
@@ -52,28 +79,271 @@
  *
  * This commands returns the following information:
  *  - protocol version
- *  - maximal payload size supported by protocol packet
+ *  - maximal frame size the programmer is able to receive (limited to
+ *    PROTO_INT_VAL_MAX). The host sizes its frames and splits transfers
+ *    accordingly, programmers with more RAM advertise frames of kilobytes.
+ *  - window size, number of requests which can be sent without waiting for
+ *    a response. Optional field, programmers which do not send it are handled
+ *    in stop-and-wait mode (window of size 1).
+ *  - bitmap of supported commands (bit N is set if command N is supported).
+ *    Optional field, if not sent only GET_INFO and SPI_TRANSFER are available.
+ *  - bitmap of supported protocol features (PROTO_FEATURE_*). Optional field,
+ *    if not sent no feature is available.
+ *  - bitmap of supported frame checksums (PROTO_CHECKSUM_MASK). Optional
+ *    field, if not sent only CRC8 is available.
+ *  - maximal SPI clock in Hz. Optional field, 0 if unknown.
+ *  - bitmap of supported SPI I/O widths (PROTO_IO_WIDTH_*). Optional field,
+ *    if not sent only single I/O is available.
  *
  * Request payload:
  *  - No payload
  *
  * Response payload:
- *  [    4b   ][    4b   ][   1/2B   ]
- *  [ VER_MAJ ][ VER_MIN ][ PLD_SIZE ]
+ *  [    4b   ][    4b   ][   1/2B   ][   1B   ][  2B  ][    1B    ][     1B    ]
+ *  [ VER_MAJ ][ VER_MIN ][ PLD_SIZE ][ WINDOW ][ CMDS ][ FEATURES ][ CHECKSUMS ]
+ *
+ *  [     4B    ][     1B    ]
+ *  [ SPI_CLOCK ][ IO_WIDTHS ]
  */
 #define PROTO_CMD_GET_INFO     0x0
 
+#define PROTO_IO_WIDTH_SINGLE (1 << 0)
+#define PROTO_IO_WIDTH_DUAL   (1 << 1)
+#define PROTO_IO_WIDTH_QUAD   (1 << 2)
+
+/*
+ * Programmer is able to send RX data compressed with run-length encoding
+ * (see common/rle.h) if it is requested by the host.
+ */
+#define PROTO_FEATURE_RLE    (1 << 0)
+
+/*
+ * Programmer accepts TX data (and page data of FLASH_WRITE_PAGE) compressed
+ * with run-length encoding.
+ */
+#define PROTO_FEATURE_TX_RLE (1 << 1)
+
+/*
+ * Programmer recognizes retransmitted requests. GET_INFO starts a session,
+ * following requests have to carry consecutive IDs. A request whose ID is
+ * neither the next one nor one of the last executed ones follows a lost
+ * request, it is not executed and answered with PROTO_ERROR_OUT_OF_SEQUENCE.
+ *
+ * The host resends requests with their original IDs when a response is lost
+ * or broken. Already executed requests are answered with the remembered
+ * response if it was small enough, re-executed if they are idempotent
+ * (GET_INFO, FLASH_READ, SPI_POLL, FLASH_CRC32, FLASH_BLANK_CHECK,
+ * FLASH_COMPARE, SPI_CONFIG) or rejected with PROTO_ERROR_DUPLICATE.
+ * After PROTO_ERROR_DUPLICATE the host deselects CS and sends the whole
+ * SPI transaction again.
+ */
+#define PROTO_FEATURE_RETRANSMIT (1 << 2)
+
 
 #define PROTO_SPI_TRANSFER_FLAG_KEEP_CS (1 << 0)
+#define PROTO_SPI_TRANSFER_FLAG_RLE     (1 << 1)
+#define PROTO_SPI_TRANSFER_FLAG_TX_RLE  (1 << 2)
 
 /*
  * 3) CMD_SPI_TRANSFER
  *
  * [  1B   ][  1/2B   ][    TX_SIZE     ][     1/2B     ][  1/2B   ]
  * [ FLAGS ][ TX_SIZE ][ TX_DATA ][ ... ][ RX_SKIP_SIZE ][ RX_SIZE ]
+ *
+ * If PROTO_SPI_TRANSFER_FLAG_RLE is set, response carries RX data encoded
+ * with RLE. TX_SIZE + RLE_MAX_SIZE(RX_SIZE) has to fit into response payload.
+ *
+ * If PROTO_SPI_TRANSFER_FLAG_TX_RLE is set, TX_DATA is encoded with RLE
+ * (TX_SIZE is size of encoded data) and expanded by the programmer while
+ * it is sent. RX_SIZE has to be 0.
  */
 #define PROTO_CMD_SPI_TRANSFER 0x1
 
+/*
+ * 4) CMD_FLASH_READ
+ *
+ * Reads flash memory using READ (0x03) instruction. The programmer answers
+ * with a continuous run of response frames (all of them having ID of the
+ * request) until LENGTH bytes are delivered. At least one frame is sent.
+ *
+ * Request payload:
+ *  [    4B   ][   4B   ][  1B   ]
+ *  [ ADDRESS ][ LENGTH ][ FLAGS ]
+ *
+ * Response payload (each frame):
+ *  [ DATA ][ ... ]
+ *
+ * FLAGS: optional field. If PROTO_FLASH_READ_FLAG_RLE is set, DATA of each
+ *        frame is encoded with RLE.
+ */
+#define PROTO_CMD_FLASH_READ   0x2
+
+#define PROTO_FLASH_READ_FLAG_RLE (1 << 0)
+
+/*
+ * 5) CMD_FLASH_WRITE_PAGE
+ *
+ * Programs flash page. The programmer sends WREN (0x06), PP (0x02) with
+ * address and data, then reads status register (0x05) until WIP bit is
+ * cleared or POLL_LIMIT reads were done. Response carries the last status
+ * register value and number of status reads - if WIP bit is still set the
+ * operation has timed out.
+ *
+ * Request payload:
+ *  [    4B   ][     2B     ][  1B   ][      ]
+ *  [ ADDRESS ][ POLL_LIMIT ][ FLAGS ][ DATA ][ ... ]
+ *
+ * FLAGS: if PROTO_FLASH_WRITE_PAGE_FLAG_RLE is set, DATA is encoded with RLE.
+ *
+ * Response payload:
+ *  [   1B   ][  2B   ]
+ *  [ STATUS ][ POLLS ]
+ */
+#define PROTO_CMD_FLASH_WRITE_PAGE 0x3
+
+#define PROTO_FLASH_WRITE_PAGE_FLAG_RLE (1 << 0)
+
+/*
+ * 6) CMD_SPI_POLL
+ *
+ * Sends OPCODE and keeps clocking out status bytes (with CS asserted) until
+ * (STATUS & MASK) == VALUE or POLL_LIMIT bytes were read. Response carries
+ * the last status byte and number of reads.
+ *
+ * Request payload:
+ *  [   1B   ][  1B  ][   1B  ][     2B     ]
+ *  [ OPCODE ][ MASK ][ VALUE ][ POLL_LIMIT ]
+ *
+ * Response payload:
+ *  [   1B   ][  2B   ]
+ *  [ STATUS ][ POLLS ]
+ */
+#define PROTO_CMD_SPI_POLL         0x4
+
+/*
+ * 7) CMD_FLASH_CRC32
+ *
+ * Reads flash memory using READ (0x03) instruction and returns CRC-32 of
+ * the read data (see common/crc32.h).
+ *
+ * Request payload:
+ *  [    4B   ][   4B   ]
+ *  [ ADDRESS ][ LENGTH ]
+ *
+ * Response payload:
+ *  [   4B  ]
+ *  [ CRC32 ]
+ */
+#define PROTO_CMD_FLASH_CRC32      0x5
+
+/*
+ * 8) CMD_FLASH_BLANK_CHECK
+ *
+ * Reads flash memory using READ (0x03) instruction and checks if all bytes
+ * are erased (0xff). Reading stops on the first non erased byte.
+ *
+ * Request payload:
+ *  [    4B   ][   4B   ]
+ *  [ ADDRESS ][ LENGTH ]
+ *
+ * Response payload:
+ *  [   4B   ]
+ *  [ OFFSET ]
+ *
+ * OFFSET: offset (relative to ADDRESS) of the first non erased byte or
+ *         PROTO_FLASH_BLANK if whole area is erased.
+ */
+#define PROTO_CMD_FLASH_BLANK_CHECK 0x6
+
+#define PROTO_FLASH_BLANK 0xffffffffUL
+
+/*
+ * 9) CMD_FLASH_COMPARE
+ *
+ * Reads PAGE_COUNT consecutive pages of PAGE_SIZE bytes starting at ADDRESS
+ * (the count is given by payload length) and compares CRC-32 of each of them
+ * with CRC sent by the host. Response contains bitmap of pages with different
+ * content - bit N (N % 8 of byte N / 8) is set if CRC of page N differs.
+ *
+ * Request payload:
+ *  [    4B   ][     2B    ][   4B  ][       ]
+ *  [ ADDRESS ][ PAGE_SIZE ][ CRC32 ][ ..... ]
+ *
+ * Response payload:
+ *  [ (PAGE_COUNT + 7) / 8 ]
+ *  [        BITMAP        ]
+ */
+#define PROTO_CMD_FLASH_COMPARE     0x7
+
+/*
+ * 10) CMD_SPI_BATCH
+ *
+ * Executes a list of SPI transfers back-to-back and answers with RX data of
+ * all of them in a single frame. Each sub-transfer is encoded the same way as
+ * CMD_SPI_TRANSFER request, only PROTO_SPI_TRANSFER_FLAG_KEEP_CS flag is
+ * allowed. Request payload size plus RX_SIZE of all sub-transfers can not
+ * exceed maximal payload size.
+ *
+ * Request payload:
+ *  [       ...      ][       ...      ][ ... ]
+ *  [ SPI_TRANSFER 1 ][ SPI_TRANSFER 2 ][ ... ]
+ *
+ * Response payload:
+ *  [  RX_SIZE 1  ][  RX_SIZE 2  ][ ... ]
+ *  [ RX_DATA 1   ][ RX_DATA 2   ][ ... ]
+ */
+#define PROTO_CMD_SPI_BATCH         0x8
+
+/*
+ * 11) CMD_SPI_CONFIG
+ *
+ * Sets SPI clock and mode used by following transfers. The programmer picks
+ * the highest clock it is able to generate which does not exceed CLOCK, or its
+ * maximal clock (see GET_INFO) if CLOCK is 0. Response carries the clock and
+ * mode which are really used.
+ *
+ * Request payload:
+ *  [   4B  ][  1B  ]
+ *  [ CLOCK ][ MODE ]
+ *
+ * Response payload:
+ *  [   4B  ][  1B  ]
+ *  [ CLOCK ][ MODE ]
+ *
+ * MODE: SPI mode 0 - 3 (PROTO_SPI_MODE_CPOL | PROTO_SPI_MODE_CPHA).
+ */
+#define PROTO_CMD_SPI_CONFIG        0x9
+
+#define PROTO_SPI_MODE_CPHA (1 << 0)
+#define PROTO_SPI_MODE_CPOL (1 << 1)
+#define PROTO_SPI_MODE_MAX  (PROTO_SPI_MODE_CPOL | PROTO_SPI_MODE_CPHA)
+
+/*
+ * 12) CMD_SERIAL_BAUD
+ *
+ * Switches UART of the programmer to BAUD. Response is sent with the current
+ * rate and carries BAUD if the programmer is able to use it or 0 otherwise
+ * (also when the link has no baud rate, like USB CDC). The new rate is used
+ * after the response is transmitted.
+ *
+ * The host confirms the new rate with any request. If no valid frame is
+ * received within PROTO_SERIAL_BAUD_TIMEOUT_MS, the programmer returns to the
+ * previous rate (not later than after twice the timeout).
+ *
+ * Request payload:
+ *  [  4B  ]
+ *  [ BAUD ]
+ *
+ * Response payload:
+ *  [  4B  ]
+ *  [ BAUD ]
+ */
+#define PROTO_CMD_SERIAL_BAUD       0xa
+
+#define PROTO_SERIAL_BAUD_TIMEOUT_MS 1000
+
+#define PROTO_CMD_MASK(_cmd) (1 << (_cmd))
+
 /*
  * Error codes.
  */
@@ -83,5 +353,7 @@
 #define PROTO_ERROR_INVALID_CRC       0x03
 #define PROTO_ERROR_INVALID_PAYLOAD   0x04
 #define PROTO_ERROR_INVALID_MESSAGE   0x05
+#define PROTO_ERROR_DUPLICATE         0x06
+#define PROTO_ERROR_OUT_OF_SEQUENCE   0x07
 
 #endif /* FIRMWARE_INCLUDE_PROTOCOL_H_ */
@@ -25,6 +25,9 @@ typedef struct _ProtoPkt {
 
 	uint8_t   *payload;
 	uint16_t   payloadSize;
+
+	/// Frame checksum type (PROTO_CHECKSUM_*)
+	uint8_t    checksum;
 } ProtoPkt;
 
 
@@ -33,7 +36,10 @@ typedef struct _ProtoPktDesCtx {
 
 	uint8_t id;
 	uint8_t code;
-	uint8_t crc;
+
+	uint8_t  checksum;
+	uint8_t  checksumRead;
+	uint32_t crc;
 
 	uint16_t dataSize;
 	uint16_t dataRead;
@@ -45,12 +51,34 @@ typedef struct _ProtoPktDesCtx {
 
 void     proto_pkt_init   (ProtoPkt *pkt, void *mem, uint16_t memSize, uint8_t code, uint8_t id);
 bool     proto_pkt_prepare(ProtoPkt *pkt, void *mem, uint16_t memSize, uint16_t payloadSize);
+
+/*
+ * Selects checksum of the frame (CRC8 is set by proto_pkt_init) and updates
+ * maximal payload size. Has to be called before proto_pkt_prepare.
+ */
+void     proto_pkt_setChecksum(ProtoPkt *pkt, void *mem, uint16_t memSize, uint8_t checksum);
+
 uint16_t proto_pkt_encode (ProtoPkt *pkt, void *mem, uint16_t memSize);
 
 void proto_pkt_dec_setup(ProtoPktDes *ctx, uint8_t *buffer, uint16_t bufferSize);
 
 uint8_t proto_pkt_dec_putByte(ProtoPktDes *ctx, uint8_t byte, ProtoPkt *pkt);
 
+/*
+ * Consumes bytes until the end of buffer or until a frame is completed or
+ * broken, the number of consumed bytes is stored in consumed. Payload is
+ * copied and checksummed in bulk. Returns the same value as
+ * proto_pkt_dec_putByte, remaining bytes have to be passed in the next call.
+ */
+uint8_t proto_pkt_dec_putBytes(ProtoPktDes *ctx, const uint8_t *bytes, uint16_t bytesSize, uint16_t *consumed, ProtoPkt *pkt);
+
+/*
+ * Returns number of bytes known to belong to the frame being decoded
+ * (remaining payload and checksum), so they may be read at once. Header bytes
+ * are requested one by one.
+ */
+uint16_t proto_pkt_dec_getPendingSize(const ProtoPktDes *ctx);
+
 void proto_pkt_dec_reset(ProtoPktDes *ctx);
 
 #ifdef __cplusplus
@@ -31,12 +31,85 @@ typedef struct _ProtoReqTransfer {
 } ProtoReqTransfer;
 
 
+typedef struct _ProtoReqFlashRead {
+	uint32_t address;
+	uint32_t length;
+
+	/// PROTO_FLASH_READ_FLAG_*, sent with FLASH_READ only
+	uint8_t flags;
+} ProtoReqFlashRead;
+
+
+typedef ProtoReqFlashRead ProtoReqFlashCrc32;
+typedef ProtoReqFlashRead ProtoReqFlashBlankCheck;
+
+
+typedef struct _ProtoReqFlashWritePage {
+	uint32_t address;
+	uint16_t pollLimit;
+
+	/// PROTO_FLASH_WRITE_PAGE_FLAG_*
+	uint8_t flags;
+
+	uint8_t *data;
+	uint16_t dataSize;
+} ProtoReqFlashWritePage;
+
+
+typedef struct _ProtoReqFlashCompare {
+	uint32_t address;
+	uint16_t pageSize;
+
+	/// CRC-32 of pages, 4B each in big endian order
+	uint8_t *crcs;
+	uint16_t pageCount;
+} ProtoReqFlashCompare;
+
+
+typedef struct _ProtoReqSpiBatch {
+	/// Sub-transfers encoded as SPI_TRANSFER requests
+	uint8_t *transfers;
+	uint16_t transfersSize;
+} ProtoReqSpiBatch;
+
+
+typedef struct _ProtoReqSpiPoll {
+	uint8_t  opcode;
+	uint8_t  mask;
+	uint8_t  value;
+	uint16_t pollLimit;
+} ProtoReqSpiPoll;
+
+
+typedef struct _ProtoReqSpiConfig {
+	/// Requested SPI clock in Hz, 0 selects the maximal one
+	uint32_t clock;
+
+	/// SPI mode (PROTO_SPI_MODE_*)
+	uint8_t mode;
+} ProtoReqSpiConfig;
+
+
+typedef struct _ProtoReqSerialBaud {
+	uint32_t baud;
+} ProtoReqSerialBaud;
+
+
 typedef struct _ProtoReq {
 	uint8_t cmd;
 
 	union {
-		ProtoReqGetInfo  getInfo;
-		ProtoReqTransfer transfer;
+		ProtoReqGetInfo         getInfo;
+		ProtoReqTransfer        transfer;
+		ProtoReqFlashRead       flashRead;
+		ProtoReqFlashWritePage  flashWritePage;
+		ProtoReqSpiPoll         spiPoll;
+		ProtoReqFlashCrc32      flashCrc32;
+		ProtoReqFlashBlankCheck flashBlankCheck;
+		ProtoReqFlashCompare    flashCompare;
+		ProtoReqSpiBatch        spiBatch;
+		ProtoReqSpiConfig       spiConfig;
+		ProtoReqSerialBaud      serialBaud;
 	} request;
 } ProtoReq;
 
@@ -48,6 +121,13 @@ uint16_t proto_req_decode(ProtoReq *request, void *memory, uint16_t memorySize);
 
 uint16_t proto_req_getPayloadSize(ProtoReq *request);
 
+/*
+ * Decodes sub-transfer of SPI_BATCH request placed at offset of transfers
+ * buffer, txBuffer points to the batch memory. Returns encoded size of the
+ * sub-transfer or 0 if it exceeds the buffer.
+ */
+uint16_t proto_req_spiBatch_getTransfer(const ProtoReqSpiBatch *batch, uint16_t offset, ProtoReqTransfer *transfer);
+
 #ifdef __cplusplus
 }
 #endif
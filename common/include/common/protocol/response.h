@@ -31,6 +31,24 @@ typedef struct _ProtoResGetInfo {
 
 	/// Maximal supported size of packet.
 	uint16_t packetSize;
+
+	/// Number of requests which can be queued by the programmer.
+	uint8_t windowSize;
+
+	/// Bitmap of supported commands (PROTO_CMD_MASK)
+	uint16_t cmds;
+
+	/// Bitmap of supported features (PROTO_FEATURE_*)
+	uint8_t features;
+
+	/// Bitmap of supported frame checksums (PROTO_CHECKSUM_MASK)
+	uint8_t checksums;
+
+	/// Maximal SPI clock in Hz, 0 if unknown
+	uint32_t spiClock;
+
+	/// Bitmap of supported SPI I/O widths (PROTO_IO_WIDTH_*)
+	uint8_t ioWidths;
 } ProtoResGetInfo;
 
 
@@ -40,12 +58,82 @@ typedef struct _ProtoResTransfer {
 } ProtoResTransfer;
 
 
+/// RX data of all sub-transfers
+typedef ProtoResTransfer ProtoResSpiBatch;
+
+
+typedef struct _ProtoResFlashRead {
+	uint8_t *data;
+	uint16_t dataSize;
+} ProtoResFlashRead;
+
+
+typedef struct _ProtoResFlashWritePage {
+	/// Last read value of status register
+	uint8_t status;
+
+	/// Number of status register reads
+	uint16_t polls;
+} ProtoResFlashWritePage;
+
+
+typedef struct _ProtoResSpiPoll {
+	/// Last read status byte
+	uint8_t status;
+
+	/// Number of status reads
+	uint16_t polls;
+} ProtoResSpiPoll;
+
+
+typedef struct _ProtoResFlashCrc32 {
+	uint32_t crc;
+} ProtoResFlashCrc32;
+
+
+typedef struct _ProtoResFlashBlankCheck {
+	/// Offset of first non erased byte or PROTO_FLASH_BLANK
+	uint32_t offset;
+} ProtoResFlashBlankCheck;
+
+
+typedef struct _ProtoResFlashCompare {
+	/// Bitmap of pages which differ
+	uint8_t *bitmap;
+	uint16_t bitmapSize;
+} ProtoResFlashCompare;
+
+
+typedef struct _ProtoResSpiConfig {
+	/// SPI clock in Hz set by the programmer
+	uint32_t clock;
+
+	/// SPI mode (PROTO_SPI_MODE_*)
+	uint8_t mode;
+} ProtoResSpiConfig;
+
+
+typedef struct _ProtoResSerialBaud {
+	/// Baud rate used after the response or 0 if not supported
+	uint32_t baud;
+} ProtoResSerialBaud;
+
+
 typedef struct _ProtoRes {
 	uint8_t cmd;
 
 	union {
-		ProtoResGetInfo  getInfo;
-		ProtoResTransfer transfer;
+		ProtoResGetInfo         getInfo;
+		ProtoResTransfer        transfer;
+		ProtoResFlashRead       flashRead;
+		ProtoResFlashWritePage  flashWritePage;
+		ProtoResSpiPoll         spiPoll;
+		ProtoResFlashCrc32      flashCrc32;
+		ProtoResFlashBlankCheck flashBlankCheck;
+		ProtoResFlashCompare    flashCompare;
+		ProtoResSpiBatch        spiBatch;
+		ProtoResSpiConfig       spiConfig;
+		ProtoResSerialBaud      serialBaud;
 	} response;
 } ProtoRes;
 
@@ -0,0 +1,64 @@
+/*
+ * common/rle.h
+ *
+ *  Created on: 17 paz 2026
+ *      Author: Jaroslaw Bielski (bielski.j@gmail.com)
+ */
+
+#ifndef COMMON_INCLUDE_RLE_H_
+#define COMMON_INCLUDE_RLE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Run-length encoding used to compress data read from flash (erased areas
+ * and areas filled with a single value).
+ *
+ * Encoded data is a sequence of blocks:
+ *  [ 0LLLLLLL ][ DATA ][ ... ] - L + 1 literal bytes follow
+ *  [ 1LLLLLLL ][ VALUE ]       - VALUE repeated L + RLE_RUN_MIN times
+ */
+#define RLE_RUN_FLAG    0x80
+#define RLE_RUN_MIN     3
+#define RLE_RUN_MAX     (0x7f + RLE_RUN_MIN)
+#define RLE_LITERAL_MAX 0x80
+
+#define RLE_ERROR -1
+
+/*
+ * Maximal size of encoded data of given size.
+ */
+#define RLE_MAX_SIZE(_size) ((_size) + (_size) / RLE_LITERAL_MAX + 1)
+
+/*
+ * Encodes srcSize bytes of src into dst and returns size of encoded data.
+ * Buffers may overlap if dst is placed at least
+ * RLE_MAX_SIZE(srcSize) - srcSize bytes before src.
+ */
+uint16_t rle_encode(uint8_t *dst, const uint8_t *src, uint16_t srcSize);
+
+/*
+ * Decodes srcSize bytes of src into dst. Returns size of decoded data or
+ * RLE_ERROR if data is malformed or does not fit into dstSize bytes.
+ */
+int32_t rle_decode(uint8_t *dst, uint16_t dstSize, const uint8_t *src, uint16_t srcSize);
+
+/*
+ * Returns size of decoded data or RLE_ERROR if data is malformed.
+ */
+int32_t rle_getDecodedSize(const uint8_t *src, uint16_t srcSize);
+
+/*
+ * Returns the largest size of data which encoded fits into encodedSize bytes.
+ */
+uint16_t rle_getMaxDecodedSize(uint16_t encodedSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COMMON_INCLUDE_RLE_H_ */
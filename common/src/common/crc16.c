@@ -0,0 +1,26 @@
+#include "common/crc16.h"
+#include "common/crc16_table.h"
+
+#if defined(__AVR__)
+	#include <avr/pgmspace.h>
+
+	#define CRC16_TABLE_ATTR PROGMEM
+	#define CRC16_TABLE_GET(_idx) pgm_read_word(&_table[_idx])
+#else
+	#define CRC16_TABLE_ATTR
+	#define CRC16_TABLE_GET(_idx) _table[_idx]
+#endif
+
+
+static const uint16_t _table[256] CRC16_TABLE_ATTR = CRC16_TABLE_0;
+
+
+uint16_t crc16_get(const uint8_t *buffer, uint16_t bufferSize, uint16_t crc) {
+	uint16_t byte;
+
+	for (byte = 0; byte < bufferSize; ++byte) {
+		crc = (crc >> 8) ^ CRC16_TABLE_GET((crc ^ buffer[byte]) & 0xff);
+	}
+
+	return crc;
+}
@@ -0,0 +1,56 @@
+#include "common/crc32.h"
+#include "common/crc32_table.h"
+
+#if defined(__AVR__)
+	#include <avr/pgmspace.h>
+
+	#define CRC32_TABLE_ATTR PROGMEM
+	#define CRC32_TABLE_GET(_table, _idx) pgm_read_dword(&(_table)[_idx])
+#else
+	#define CRC32_TABLE_ATTR
+	#define CRC32_TABLE_GET(_table, _idx) (_table)[_idx]
+#endif
+
+
+static const uint32_t _table[256] CRC32_TABLE_ATTR = CRC32_TABLE_0;
+
+#ifdef CRC32_SLICE_BY_8
+static const uint32_t _slices[8][256] = {
+	CRC32_TABLE_7, CRC32_TABLE_6, CRC32_TABLE_5, CRC32_TABLE_4,
+	CRC32_TABLE_3, CRC32_TABLE_2, CRC32_TABLE_1, CRC32_TABLE_0
+};
+#endif
+
+
+uint32_t crc32_get(const uint8_t *buffer, uint16_t bufferSize, uint32_t crc) {
+	uint16_t byte = 0;
+
+	crc = ~crc;
+
+#ifdef CRC32_SLICE_BY_8
+	// Slice N holds CRC of a byte followed by 7 - N zero bytes
+	for (; byte + 8 <= bufferSize; byte += 8) {
+		crc ^=
+			((uint32_t) buffer[byte + 0] <<  0) |
+			((uint32_t) buffer[byte + 1] <<  8) |
+			((uint32_t) buffer[byte + 2] << 16) |
+			((uint32_t) buffer[byte + 3] << 24);
+
+		crc =
+			_slices[0][(crc >>  0) & 0xff] ^
+			_slices[1][(crc >>  8) & 0xff] ^
+			_slices[2][(crc >> 16) & 0xff] ^
+			_slices[3][(crc >> 24) & 0xff] ^
+			_slices[4][buffer[byte + 4]] ^
+			_slices[5][buffer[byte + 5]] ^
+			_slices[6][buffer[byte + 6]] ^
+			_slices[7][buffer[byte + 7]];
+	}
+#endif
+
+	for (; byte < bufferSize; ++byte) {
+		crc = (crc >> 8) ^ CRC32_TABLE_GET(_table, (crc ^ buffer[byte]) & 0xff);
+	}
+
+	return ~crc;
+}
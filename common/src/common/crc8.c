@@ -1,7 +1,28 @@
 #include "common/crc8.h"
+#include "common/crc8_table.h"
 
+#if defined(__AVR__)
+	#include <avr/pgmspace.h>
 
-uint8_t crc8_getForByte(uint8_t byte, uint8_t polynomial, uint8_t start) {
+	#define CRC8_TABLE_ATTR PROGMEM
+	#define CRC8_TABLE_GET(_table, _idx) pgm_read_byte(&(_table)[_idx])
+#else
+	#define CRC8_TABLE_ATTR
+	#define CRC8_TABLE_GET(_table, _idx) (_table)[_idx]
+#endif
+
+
+static const uint8_t _table[256] CRC8_TABLE_ATTR = CRC8_TABLE_0;
+
+#ifdef CRC8_SLICE_BY_8
+static const uint8_t _slices[8][256] = {
+	CRC8_TABLE_7, CRC8_TABLE_6, CRC8_TABLE_5, CRC8_TABLE_4,
+	CRC8_TABLE_3, CRC8_TABLE_2, CRC8_TABLE_1, CRC8_TABLE_0
+};
+#endif
+
+
+static uint8_t _getForByteBitwise(uint8_t byte, uint8_t polynomial, uint8_t start) {
 	uint8_t remainder = start;
 
 	remainder ^= byte;
@@ -24,13 +45,44 @@ uint8_t crc8_getForByte(uint8_t byte, uint8_t polynomial, uint8_t start) {
 }
 
 
+uint8_t crc8_getForByte(uint8_t byte, uint8_t polynomial, uint8_t start) {
+	if (polynomial == CRC8_TABLE_POLY) {
+		return CRC8_TABLE_GET(_table, start ^ byte);
+	}
+
+	return _getForByteBitwise(byte, polynomial, start);
+}
+
+
 uint8_t crc8_get(uint8_t *buffer, uint16_t bufferSize, uint8_t polynomial, uint8_t start) {
 	uint8_t remainder = start;
-	uint16_t byte;
+	uint16_t byte = 0;
+
+	if (polynomial == CRC8_TABLE_POLY) {
+#ifdef CRC8_SLICE_BY_8
+		// Slice N holds CRC of a byte followed by 7 - N zero bytes
+		for (; byte + 8 <= bufferSize; byte += 8) {
+			remainder =
+				_slices[0][buffer[byte + 0] ^ remainder] ^
+				_slices[1][buffer[byte + 1]] ^
+				_slices[2][buffer[byte + 2]] ^
+				_slices[3][buffer[byte + 3]] ^
+				_slices[4][buffer[byte + 4]] ^
+				_slices[5][buffer[byte + 5]] ^
+				_slices[6][buffer[byte + 6]] ^
+				_slices[7][buffer[byte + 7]];
+		}
+#endif
+
+		for (; byte < bufferSize; ++byte) {
+			remainder = CRC8_TABLE_GET(_table, remainder ^ buffer[byte]);
+		}
 
-	// Perform modulo-2 division, a byte at a time.
-	for (byte = 0; byte < bufferSize; ++byte) {
-		remainder = crc8_getForByte(buffer[byte], polynomial, remainder);
+	} else {
+		// Perform modulo-2 division, a byte at a time.
+		for (; byte < bufferSize; ++byte) {
+			remainder = _getForByteBitwise(buffer[byte], polynomial, remainder);
+		}
 	}
 
 	return remainder;
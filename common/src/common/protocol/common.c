@@ -43,3 +43,37 @@ uint8_t proto_int_val_encode(uint16_t len, uint8_t val[2]) {
 
 	return ret;
 }
+
+
+uint16_t proto_int16_decode(uint8_t val[2]) {
+	return
+		((uint16_t) val[0] << 8) |
+		((uint16_t) val[1] << 0);
+}
+
+
+uint8_t proto_int16_encode(uint16_t val, uint8_t buffer[2]) {
+	buffer[0] = (val >> 8) & 0xff;
+	buffer[1] = (val >> 0) & 0xff;
+
+	return 2;
+}
+
+
+uint32_t proto_int32_decode(uint8_t val[4]) {
+	return
+		((uint32_t) val[0] << 24) |
+		((uint32_t) val[1] << 16) |
+		((uint32_t) val[2] <<  8) |
+		((uint32_t) val[3] <<  0);
+}
+
+
+uint8_t proto_int32_encode(uint32_t val, uint8_t buffer[4]) {
+	buffer[0] = (val >> 24) & 0xff;
+	buffer[1] = (val >> 16) & 0xff;
+	buffer[2] = (val >>  8) & 0xff;
+	buffer[3] = (val >>  0) & 0xff;
+
+	return 4;
+}
@@ -25,6 +25,14 @@ uint16_t proto_int_val_decode(uint8_t val[2]);
 
 uint8_t proto_int_val_encode(uint16_t len, uint8_t val[2]);
 
+uint16_t proto_int16_decode(uint8_t val[2]);
+
+uint8_t proto_int16_encode(uint16_t val, uint8_t buffer[2]);
+
+uint32_t proto_int32_decode(uint8_t val[4]);
+
+uint8_t proto_int32_encode(uint32_t val, uint8_t buffer[4]);
+
 #ifdef __cplusplus
 }
 #endif
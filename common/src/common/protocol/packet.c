@@ -4,6 +4,8 @@
 #include "common/protocol.h"
 #include "common/protocol/packet.h"
 #include "common/crc8.h"
+#include "common/crc16.h"
+#include "common/crc32.h"
 
 #include "common.h"
 
@@ -23,8 +25,77 @@ typedef enum _State {
 } State;
 
 
-uint16_t _getMaxPayloadSize(uint16_t memSize) {
-	uint8_t overhead = 3;
+#define CHECKSUM_UNKNOWN 0xff
+
+
+static uint8_t _getChecksumSize(uint8_t checksum) {
+	switch (checksum) {
+		case PROTO_CHECKSUM_CRC16: return 2;
+		case PROTO_CHECKSUM_CRC32: return 4;
+
+		default:
+			return 1;
+	}
+}
+
+
+static uint8_t _getSyncNibble(uint8_t checksum) {
+	switch (checksum) {
+		case PROTO_CHECKSUM_CRC16: return PROTO_SYNC_NIBBLE_CRC16;
+		case PROTO_CHECKSUM_CRC32: return PROTO_SYNC_NIBBLE_CRC32;
+
+		default:
+			return PROTO_SYNC_NIBBLE;
+	}
+}
+
+
+static uint8_t _getChecksumBySync(uint8_t byte) {
+	switch (byte & PROTO_SYNC_NIBBLE_MASK) {
+		case PROTO_SYNC_NIBBLE:       return PROTO_CHECKSUM_CRC8;
+		case PROTO_SYNC_NIBBLE_CRC16: return PROTO_CHECKSUM_CRC16;
+		case PROTO_SYNC_NIBBLE_CRC32: return PROTO_CHECKSUM_CRC32;
+
+		default:
+			return CHECKSUM_UNKNOWN;
+	}
+}
+
+
+static uint32_t _checksumStart(uint8_t checksum) {
+	switch (checksum) {
+		case PROTO_CHECKSUM_CRC16: return CRC16_START;
+		case PROTO_CHECKSUM_CRC32: return CRC32_START;
+
+		default:
+			return PROTO_CRC8_START;
+	}
+}
+
+
+static uint32_t _checksumUpdate(uint8_t checksum, const uint8_t *buffer, uint16_t bufferSize, uint32_t crc) {
+	switch (checksum) {
+		case PROTO_CHECKSUM_CRC16: return crc16_get(buffer, bufferSize, crc);
+		case PROTO_CHECKSUM_CRC32: return crc32_get(buffer, bufferSize, crc);
+
+		default:
+			return crc8_get((uint8_t *) buffer, bufferSize, PROTO_CRC8_POLY, crc);
+	}
+}
+
+
+static uint32_t _checksumUpdateByte(uint8_t checksum, uint8_t byte, uint32_t crc) {
+	if (checksum == PROTO_CHECKSUM_CRC8) {
+		return crc8_getForByte(byte, PROTO_CRC8_POLY, crc);
+	}
+
+	return _checksumUpdate(checksum, &byte, 1, crc);
+}
+
+
+uint16_t _getMaxPayloadSize(uint16_t memSize, uint8_t checksum) {
+	// SYNC/CTRL, ID, 1B VLEN and checksum
+	uint8_t overhead = 3 + _getChecksumSize(checksum);
 
 	if (memSize <= overhead) {
 		return 0;
@@ -34,15 +105,28 @@ uint16_t _getMaxPayloadSize(uint16_t memSize) {
 		overhead++;
 	}
 
+	if (memSize - overhead > PROTO_INT_VAL_MAX) {
+		return PROTO_INT_VAL_MAX;
+	}
+
 	return memSize - overhead;
 }
 
 
 void proto_pkt_init(ProtoPkt *pkt, void *mem, uint16_t memSize, uint8_t code, uint8_t id) {
-	pkt->code = code;
-	pkt->id   = id;
+	pkt->code     = code;
+	pkt->id       = id;
+	pkt->checksum = PROTO_CHECKSUM_CRC8;
+
+	pkt->payloadSize = _getMaxPayloadSize(memSize, pkt->checksum);
+	pkt->payload     = NULL;
+}
+
 
-	pkt->payloadSize = _getMaxPayloadSize(memSize);
+void proto_pkt_setChecksum(ProtoPkt *pkt, void *mem, uint16_t memSize, uint8_t checksum) {
+	pkt->checksum = checksum;
+
+	pkt->payloadSize = _getMaxPayloadSize(memSize, pkt->checksum);
 	pkt->payload     = NULL;
 }
 
@@ -50,20 +134,18 @@ void proto_pkt_init(ProtoPkt *pkt, void *mem, uint16_t memSize, uint8_t code, ui
 bool proto_pkt_prepare(ProtoPkt *pkt, void *mem, uint16_t memSize, uint16_t payloadSize) {
 	bool ret = true;
 
-	if (payloadSize != pkt->payloadSize) {
-		if (payloadSize) {
-			if (payloadSize > _getMaxPayloadSize(memSize)) {
-				ret = false;
-
-			} else {
-				pkt->payloadSize = payloadSize;
-				pkt->payload     = ((uint8_t *) mem) + 2 + proto_int_val_length_estimate(pkt->payloadSize);
-			}
+	if (payloadSize) {
+		if (payloadSize > _getMaxPayloadSize(memSize, pkt->checksum)) {
+			ret = false;
 
 		} else {
-			pkt->payloadSize = 0;
-			pkt->payload     = NULL;
+			pkt->payloadSize = payloadSize;
+			pkt->payload     = ((uint8_t *) mem) + 2 + proto_int_val_length_estimate(pkt->payloadSize);
 		}
+
+	} else {
+		pkt->payloadSize = 0;
+		pkt->payload     = NULL;
 	}
 
 	return ret;
@@ -76,16 +158,23 @@ uint16_t proto_pkt_encode(ProtoPkt *pkt, void *mem, uint16_t memSize) {
 	{
 		uint8_t *buff = (uint8_t *) mem;
 
-		buff[ret++] = PROTO_SYNC_NIBBLE | pkt->code;
+		uint8_t  checksumSize = _getChecksumSize(pkt->checksum);
+		uint32_t crc;
+
+		buff[ret++] = _getSyncNibble(pkt->checksum) | pkt->code;
 		buff[ret++] = pkt->id;
 
 		ret += proto_int_val_encode(pkt->payloadSize, buff + ret);
 		ret += pkt->payloadSize;
 
-		buff[ret] = crc8_get(buff, ret, PROTO_CRC8_POLY, PROTO_CRC8_START);
+		crc = _checksumUpdate(pkt->checksum, buff, ret, _checksumStart(pkt->checksum));
+
+		while (checksumSize--) {
+			buff[ret++] = (crc >> (8 * checksumSize)) & 0xff;
+		}
 	};
 
-	return ret + 1;
+	return ret;
 }
 
 
@@ -103,10 +192,13 @@ uint8_t proto_pkt_dec_putByte(ProtoPktDes *ctx, uint8_t byte, ProtoPkt *request)
 	switch (ctx->state) {
 		case STATE_WAIT_SYNC:
 			{
-				if ((byte & PROTO_SYNC_NIBBLE_MASK) == PROTO_SYNC_NIBBLE) {
-					ctx->code   = PROTO_CMD_NIBBLE_MASK & byte;
-					ctx->state = STATE_ID;
-					ctx->crc   = crc8_getForByte(byte, PROTO_CRC8_POLY, PROTO_CRC8_START);
+				uint8_t checksum = _getChecksumBySync(byte);
+
+				if (checksum != CHECKSUM_UNKNOWN) {
+					ctx->code     = PROTO_CMD_NIBBLE_MASK & byte;
+					ctx->state    = STATE_ID;
+					ctx->checksum = checksum;
+					ctx->crc      = _checksumUpdateByte(checksum, byte, _checksumStart(checksum));
 				}
 			}
 			break;
@@ -115,7 +207,7 @@ uint8_t proto_pkt_dec_putByte(ProtoPktDes *ctx, uint8_t byte, ProtoPkt *request)
 			{
 				ctx->id    = byte;
 				ctx->state = STATE_VLEN_HI;
-				ctx->crc   = crc8_getForByte(byte, PROTO_CRC8_POLY, ctx->crc);
+				ctx->crc   = _checksumUpdateByte(ctx->checksum, byte, ctx->crc);
 			}
 			break;
 
@@ -137,7 +229,7 @@ uint8_t proto_pkt_dec_putByte(ProtoPktDes *ctx, uint8_t byte, ProtoPkt *request)
 					ctx->state = STATE_VLEN_LO;
 				}
 
-				ctx->crc = crc8_getForByte(byte, PROTO_CRC8_POLY, ctx->crc);
+				ctx->crc = _checksumUpdateByte(ctx->checksum, byte, ctx->crc);
 			}
 			break;
 
@@ -149,7 +241,7 @@ uint8_t proto_pkt_dec_putByte(ProtoPktDes *ctx, uint8_t byte, ProtoPkt *request)
 
 				ctx->state = STATE_CHECK_PAYLOAD;
 
-				ctx->crc = crc8_getForByte(byte, PROTO_CRC8_POLY, ctx->crc);
+				ctx->crc = _checksumUpdateByte(ctx->checksum, byte, ctx->crc);
 			}
 			break;
 
@@ -161,18 +253,28 @@ uint8_t proto_pkt_dec_putByte(ProtoPktDes *ctx, uint8_t byte, ProtoPkt *request)
 					ctx->state = STATE_CRC;
 				}
 
-				ctx->crc = crc8_getForByte(byte, PROTO_CRC8_POLY, ctx->crc);
+				ctx->crc = _checksumUpdateByte(ctx->checksum, byte, ctx->crc);
 			}
 			break;
 
 		case STATE_CRC:
 			{
-				if (ctx->crc != byte) {
+				uint8_t remaining = _getChecksumSize(ctx->checksum) - ++ctx->checksumRead;
+
+				// Received bytes are cleared from computed value, whole checksum is compared after its last byte.
+				ctx->crc ^= (uint32_t) byte << (8 * remaining);
+
+				if (remaining > 0) {
+					break;
+				}
+
+				if (ctx->crc != 0) {
 					error = PROTO_ERROR_INVALID_CRC;
 
 				} else {
-					request->code = ctx->code;
-					request->id   = ctx->id;
+					request->code     = ctx->code;
+					request->id       = ctx->id;
+					request->checksum = ctx->checksum;
 
 					request->payloadSize = ctx->dataSize;
 					if (request->payloadSize) {
@@ -203,6 +305,13 @@ uint8_t proto_pkt_dec_putByte(ProtoPktDes *ctx, uint8_t byte, ProtoPkt *request)
 		if (error != PROTO_NO_ERROR) {
 			ret = PROTO_PKT_DES_RET_SET_ERROR_CODE(error);
 
+			// Report header of broken packet. It allows to match error with the request.
+			request->code        = ctx->code;
+			request->id          = ctx->id;
+			request->checksum    = ctx->checksum;
+			request->payload     = NULL;
+			request->payloadSize = 0;
+
 		} else if (ctx->state == STATE_CMD_RDY) {
 			ret = PROTO_PKT_DES_RET_SET_ERROR_CODE(error);
 		}
@@ -216,11 +325,62 @@ uint8_t proto_pkt_dec_putByte(ProtoPktDes *ctx, uint8_t byte, ProtoPkt *request)
 }
 
 
+uint8_t proto_pkt_dec_putBytes(ProtoPktDes *ctx, const uint8_t *bytes, uint16_t bytesSize, uint16_t *consumed, ProtoPkt *pkt) {
+	uint8_t  ret = PROTO_PKT_DES_RET_IDLE;
+	uint16_t i   = 0;
+
+	while (i < bytesSize && ret == PROTO_PKT_DES_RET_IDLE) {
+		if (ctx->state == STATE_PAYLOAD) {
+			uint16_t count = ctx->dataSize - ctx->dataRead;
+
+			if (count > bytesSize - i) {
+				count = bytesSize - i;
+			}
+
+			memcpy(ctx->mem + ctx->dataRead, bytes + i, count);
+
+			ctx->crc       = _checksumUpdate(ctx->checksum, bytes + i, count, ctx->crc);
+			ctx->dataRead += count;
+
+			if (ctx->dataRead == ctx->dataSize) {
+				ctx->state = STATE_CRC;
+			}
+
+			i += count;
+
+		} else {
+			ret = proto_pkt_dec_putByte(ctx, bytes[i++], pkt);
+		}
+	}
+
+	*consumed = i;
+
+	return ret;
+}
+
+
+uint16_t proto_pkt_dec_getPendingSize(const ProtoPktDes *ctx) {
+	switch (ctx->state) {
+		case STATE_PAYLOAD:
+			return ctx->dataSize - ctx->dataRead + _getChecksumSize(ctx->checksum);
+
+		case STATE_CRC:
+			return _getChecksumSize(ctx->checksum) - ctx->checksumRead;
+
+		default:
+			return 1;
+	}
+}
+
+
 void proto_pkt_dec_reset(ProtoPktDes *ctx) {
 	ctx->state    = STATE_WAIT_SYNC;
+	ctx->checksum = PROTO_CHECKSUM_CRC8;
 	ctx->crc      = PROTO_CRC8_START;
 	ctx->id       = ID_UNKNOWN;
 	ctx->code     = CMD_UNKNOWN;
 	ctx->dataRead = 0;
 	ctx->dataSize = 0;
+
+	ctx->checksumRead = 0;
 }
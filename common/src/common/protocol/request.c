@@ -28,8 +28,68 @@ void proto_req_init(ProtoReq *request, void *memory, uint16_t memorySize, uint8_
 
 				t->txBuffer     = NULL;
 				t->rxBufferSize = 0;
-				t->rxBufferSize = 0;
 				t->rxSkipSize   = 0;
+				t->flags        = 0;
+			}
+			break;
+
+		case PROTO_CMD_FLASH_READ:
+		case PROTO_CMD_FLASH_CRC32:
+		case PROTO_CMD_FLASH_BLANK_CHECK:
+			{
+				ProtoReqFlashRead *r = &request->request.flashRead;
+
+				r->address = 0;
+				r->length  = 0;
+				r->flags   = 0;
+			}
+			break;
+
+		case PROTO_CMD_FLASH_WRITE_PAGE:
+			{
+				ProtoReqFlashWritePage *w = &request->request.flashWritePage;
+
+				uint8_t overhead = 4 + 2 + 1;
+
+				if (memorySize > overhead) {
+					w->dataSize = memorySize - overhead;
+
+				} else {
+					w->dataSize = 0;
+				}
+
+				w->data      = NULL;
+				w->address   = 0;
+				w->pollLimit = 0;
+				w->flags     = 0;
+			}
+			break;
+
+		case PROTO_CMD_SPI_BATCH:
+			{
+				ProtoReqSpiBatch *b = &request->request.spiBatch;
+
+				b->transfers     = NULL;
+				b->transfersSize = memorySize;
+			}
+			break;
+
+		case PROTO_CMD_FLASH_COMPARE:
+			{
+				ProtoReqFlashCompare *c = &request->request.flashCompare;
+
+				uint8_t overhead = 4 + 2;
+
+				if (memorySize > overhead) {
+					c->pageCount = (memorySize - overhead) / 4;
+
+				} else {
+					c->pageCount = 0;
+				}
+
+				c->crcs     = NULL;
+				c->address  = 0;
+				c->pageSize = 0;
 			}
 			break;
 
@@ -56,6 +116,55 @@ uint16_t proto_req_getPayloadSize(ProtoReq *request) {
 			}
 			break;
 
+		case PROTO_CMD_FLASH_READ:
+			{
+				ret = 4 + 4 + 1;
+			}
+			break;
+
+		case PROTO_CMD_FLASH_CRC32:
+		case PROTO_CMD_FLASH_BLANK_CHECK:
+			{
+				ret = 4 + 4;
+			}
+			break;
+
+		case PROTO_CMD_FLASH_WRITE_PAGE:
+			{
+				ret = 4 + 2 + 1 + request->request.flashWritePage.dataSize;
+			}
+			break;
+
+		case PROTO_CMD_FLASH_COMPARE:
+			{
+				ret = 4 + 2 + 4 * request->request.flashCompare.pageCount;
+			}
+			break;
+
+		case PROTO_CMD_SPI_POLL:
+			{
+				ret = 1 + 1 + 1 + 2;
+			}
+			break;
+
+		case PROTO_CMD_SPI_CONFIG:
+			{
+				ret = 4 + 1;
+			}
+			break;
+
+		case PROTO_CMD_SERIAL_BAUD:
+			{
+				ret = 4;
+			}
+			break;
+
+		case PROTO_CMD_SPI_BATCH:
+			{
+				ret = request->request.spiBatch.transfersSize;
+			}
+			break;
+
 		default:
 			break;
 	}
@@ -79,6 +188,45 @@ void proto_req_assign(ProtoReq *request, void *memory, uint16_t memorySize) {
 			}
 			break;
 
+		case PROTO_CMD_FLASH_WRITE_PAGE:
+			{
+				ProtoReqFlashWritePage *w = &request->request.flashWritePage;
+
+				if (w->dataSize) {
+					w->data = PTR_U8(memory) + 4 + 2 + 1;
+
+				} else {
+					w->data = NULL;
+				}
+			}
+			break;
+
+		case PROTO_CMD_FLASH_COMPARE:
+			{
+				ProtoReqFlashCompare *c = &request->request.flashCompare;
+
+				if (c->pageCount) {
+					c->crcs = PTR_U8(memory) + 4 + 2;
+
+				} else {
+					c->crcs = NULL;
+				}
+			}
+			break;
+
+		case PROTO_CMD_SPI_BATCH:
+			{
+				ProtoReqSpiBatch *b = &request->request.spiBatch;
+
+				if (b->transfersSize) {
+					b->transfers = PTR_U8(memory);
+
+				} else {
+					b->transfers = NULL;
+				}
+			}
+			break;
+
 		default:
 			break;
 	}
@@ -109,6 +257,79 @@ uint16_t proto_req_encode(ProtoReq *request, void *memory, uint16_t memorySize)
 			}
 			break;
 
+		case PROTO_CMD_FLASH_READ:
+		case PROTO_CMD_FLASH_CRC32:
+		case PROTO_CMD_FLASH_BLANK_CHECK:
+			{
+				ProtoReqFlashRead *r = &request->request.flashRead;
+
+				ret += proto_int32_encode(r->address, PTR_U8(memory) + ret);
+				ret += proto_int32_encode(r->length,  PTR_U8(memory) + ret);
+
+				if (request->cmd == PROTO_CMD_FLASH_READ) {
+					PTR_U8(memory)[ret++] = r->flags;
+				}
+			}
+			break;
+
+		case PROTO_CMD_FLASH_WRITE_PAGE:
+			{
+				ProtoReqFlashWritePage *w = &request->request.flashWritePage;
+
+				ret += proto_int32_encode(w->address,   PTR_U8(memory) + ret);
+				ret += proto_int16_encode(w->pollLimit, PTR_U8(memory) + ret);
+
+				PTR_U8(memory)[ret++] = w->flags;
+
+				ret += w->dataSize;
+			}
+			break;
+
+		case PROTO_CMD_FLASH_COMPARE:
+			{
+				ProtoReqFlashCompare *c = &request->request.flashCompare;
+
+				ret += proto_int32_encode(c->address,  PTR_U8(memory) + ret);
+				ret += proto_int16_encode(c->pageSize, PTR_U8(memory) + ret);
+
+				ret += 4 * c->pageCount;
+			}
+			break;
+
+		case PROTO_CMD_SPI_POLL:
+			{
+				ProtoReqSpiPoll *p = &request->request.spiPoll;
+
+				PTR_U8(memory)[ret++] = p->opcode;
+				PTR_U8(memory)[ret++] = p->mask;
+				PTR_U8(memory)[ret++] = p->value;
+
+				ret += proto_int16_encode(p->pollLimit, PTR_U8(memory) + ret);
+			}
+			break;
+
+		case PROTO_CMD_SPI_CONFIG:
+			{
+				ProtoReqSpiConfig *c = &request->request.spiConfig;
+
+				ret += proto_int32_encode(c->clock, PTR_U8(memory) + ret);
+
+				PTR_U8(memory)[ret++] = c->mode;
+			}
+			break;
+
+		case PROTO_CMD_SERIAL_BAUD:
+			{
+				ret += proto_int32_encode(request->request.serialBaud.baud, PTR_U8(memory) + ret);
+			}
+			break;
+
+		case PROTO_CMD_SPI_BATCH:
+			{
+				ret += request->request.spiBatch.transfersSize;
+			}
+			break;
+
 		default:
 			{
 
@@ -144,9 +365,150 @@ uint16_t proto_req_decode(ProtoReq *request, void *memory, uint16_t memorySize)
 			}
 			break;
 
+		case PROTO_CMD_FLASH_READ:
+		case PROTO_CMD_FLASH_CRC32:
+		case PROTO_CMD_FLASH_BLANK_CHECK:
+			{
+				ProtoReqFlashRead *r = &request->request.flashRead;
+
+				r->address = proto_int32_decode(PTR_U8(memory) + ret); ret += 4;
+				r->length  = proto_int32_decode(PTR_U8(memory) + ret); ret += 4;
+				r->flags   = 0;
+
+				// Optional field, not sent by older hosts
+				if (request->cmd == PROTO_CMD_FLASH_READ && ret < memorySize) {
+					r->flags = PTR_U8(memory)[ret++];
+				}
+			}
+			break;
+
+		case PROTO_CMD_FLASH_WRITE_PAGE:
+			{
+				ProtoReqFlashWritePage *w = &request->request.flashWritePage;
+
+				w->address   = proto_int32_decode(PTR_U8(memory) + ret); ret += 4;
+				w->pollLimit = proto_int16_decode(PTR_U8(memory) + ret); ret += 2;
+				w->flags     = PTR_U8(memory)[ret++];
+				w->data      = NULL;
+				w->dataSize  = memorySize - ret;
+
+				ret += w->dataSize;
+			}
+			break;
+
+		case PROTO_CMD_FLASH_COMPARE:
+			{
+				ProtoReqFlashCompare *c = &request->request.flashCompare;
+
+				c->address   = proto_int32_decode(PTR_U8(memory) + ret); ret += 4;
+				c->pageSize  = proto_int16_decode(PTR_U8(memory) + ret); ret += 2;
+				c->crcs      = NULL;
+				c->pageCount = (memorySize - ret) / 4;
+
+				ret += 4 * c->pageCount;
+			}
+			break;
+
+		case PROTO_CMD_SPI_POLL:
+			{
+				ProtoReqSpiPoll *p = &request->request.spiPoll;
+
+				p->opcode    = PTR_U8(memory)[ret++];
+				p->mask      = PTR_U8(memory)[ret++];
+				p->value     = PTR_U8(memory)[ret++];
+				p->pollLimit = proto_int16_decode(PTR_U8(memory) + ret); ret += 2;
+			}
+			break;
+
+		case PROTO_CMD_SPI_CONFIG:
+			{
+				ProtoReqSpiConfig *c = &request->request.spiConfig;
+
+				c->clock = proto_int32_decode(PTR_U8(memory) + ret); ret += 4;
+				c->mode  = PTR_U8(memory)[ret++];
+			}
+			break;
+
+		case PROTO_CMD_SERIAL_BAUD:
+			{
+				request->request.serialBaud.baud = proto_int32_decode(PTR_U8(memory) + ret); ret += 4;
+			}
+			break;
+
+		case PROTO_CMD_SPI_BATCH:
+			{
+				ProtoReqSpiBatch *b = &request->request.spiBatch;
+
+				b->transfers     = NULL;
+				b->transfersSize = memorySize;
+
+				ret += b->transfersSize;
+			}
+			break;
+
 		default:
 			break;
 	}
 
 	return ret;
 }
+
+
+/*
+ * Decodes VLEN field at offset, returns its length or 0 if it exceeds the buffer.
+ */
+static uint8_t _decodeIntVal(const uint8_t *memory, uint16_t memorySize, uint32_t offset, uint16_t *val) {
+	uint8_t length;
+
+	if (offset >= memorySize) {
+		return 0;
+	}
+
+	length = proto_int_val_length_probe(memory[offset]);
+	if (offset + length > memorySize) {
+		return 0;
+	}
+
+	*val = proto_int_val_decode((uint8_t *) memory + offset);
+
+	return length;
+}
+
+
+uint16_t proto_req_spiBatch_getTransfer(const ProtoReqSpiBatch *batch, uint16_t offset, ProtoReqTransfer *transfer) {
+	uint32_t ret = offset;
+	uint8_t  length;
+
+	if (ret >= batch->transfersSize) {
+		return 0;
+	}
+
+	transfer->flags = batch->transfers[ret++];
+
+	length = _decodeIntVal(batch->transfers, batch->transfersSize, ret, &transfer->txBufferSize);
+	if (length == 0) {
+		return 0;
+	}
+
+	ret += length;
+
+	transfer->txBuffer = transfer->txBufferSize ? batch->transfers + ret : NULL;
+
+	ret += transfer->txBufferSize;
+
+	length = _decodeIntVal(batch->transfers, batch->transfersSize, ret, &transfer->rxSkipSize);
+	if (length == 0) {
+		return 0;
+	}
+
+	ret += length;
+
+	length = _decodeIntVal(batch->transfers, batch->transfersSize, ret, &transfer->rxBufferSize);
+	if (length == 0) {
+		return 0;
+	}
+
+	ret += length;
+
+	return ret - offset;
+}
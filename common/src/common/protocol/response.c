@@ -16,6 +16,7 @@ void proto_res_init(ProtoRes *response, void *memory, uint16_t memorySize, uint8
 
 	switch (cmd) {
 		case PROTO_CMD_SPI_TRANSFER:
+		case PROTO_CMD_SPI_BATCH:
 			{
 				ProtoResTransfer *t = &response->response.transfer;
 
@@ -27,6 +28,67 @@ void proto_res_init(ProtoRes *response, void *memory, uint16_t memorySize, uint8
 			}
 			break;
 
+		case PROTO_CMD_FLASH_READ:
+			{
+				ProtoResFlashRead *r = &response->response.flashRead;
+
+				r->dataSize = memorySize;
+				r->data     = NULL;
+			}
+			break;
+
+		case PROTO_CMD_FLASH_WRITE_PAGE:
+			{
+				ProtoResFlashWritePage *w = &response->response.flashWritePage;
+
+				w->status = 0;
+				w->polls  = 0;
+			}
+			break;
+
+		case PROTO_CMD_SPI_POLL:
+			{
+				ProtoResSpiPoll *p = &response->response.spiPoll;
+
+				p->status = 0;
+				p->polls  = 0;
+			}
+			break;
+
+		case PROTO_CMD_FLASH_CRC32:
+			{
+				response->response.flashCrc32.crc = 0;
+			}
+			break;
+
+		case PROTO_CMD_FLASH_BLANK_CHECK:
+			{
+				response->response.flashBlankCheck.offset = PROTO_FLASH_BLANK;
+			}
+			break;
+
+		case PROTO_CMD_SPI_CONFIG:
+			{
+				response->response.spiConfig.clock = 0;
+				response->response.spiConfig.mode  = 0;
+			}
+			break;
+
+		case PROTO_CMD_SERIAL_BAUD:
+			{
+				response->response.serialBaud.baud = 0;
+			}
+			break;
+
+		case PROTO_CMD_FLASH_COMPARE:
+			{
+				ProtoResFlashCompare *c = &response->response.flashCompare;
+
+				c->bitmapSize = memorySize;
+				c->bitmap     = NULL;
+			}
+			break;
+
 		default:
 			break;
 	}
@@ -39,11 +101,12 @@ uint16_t proto_res_getPayloadSize(ProtoRes *response) {
 	switch (response->cmd) {
 		case PROTO_CMD_GET_INFO:
 			{
-				ret = 1 + proto_int_val_length_estimate(response->response.getInfo.packetSize);
+				ret = 1 + proto_int_val_length_estimate(response->response.getInfo.packetSize) + 1 + 2 + 1 + 1 + 4 + 1;
 			}
 			break;
 
 		case PROTO_CMD_SPI_TRANSFER:
+		case PROTO_CMD_SPI_BATCH:
 			{
 				ProtoResTransfer *t = &response->response.transfer;
 
@@ -51,6 +114,44 @@ uint16_t proto_res_getPayloadSize(ProtoRes *response) {
 			}
 			break;
 
+		case PROTO_CMD_FLASH_READ:
+			{
+				ret = response->response.flashRead.dataSize;
+			}
+			break;
+
+		case PROTO_CMD_FLASH_WRITE_PAGE:
+		case PROTO_CMD_SPI_POLL:
+			{
+				ret = 1 + 2;
+			}
+			break;
+
+		case PROTO_CMD_FLASH_CRC32:
+		case PROTO_CMD_FLASH_BLANK_CHECK:
+			{
+				ret = 4;
+			}
+			break;
+
+		case PROTO_CMD_SPI_CONFIG:
+			{
+				ret = 4 + 1;
+			}
+			break;
+
+		case PROTO_CMD_SERIAL_BAUD:
+			{
+				ret = 4;
+			}
+			break;
+
+		case PROTO_CMD_FLASH_COMPARE:
+			{
+				ret = response->response.flashCompare.bitmapSize;
+			}
+			break;
+
 		default:
 			break;
 	}
@@ -67,6 +168,7 @@ void proto_res_assign(ProtoRes *response, void *memory, uint16_t memorySize) {
 			break;
 
 		case PROTO_CMD_SPI_TRANSFER:
+		case PROTO_CMD_SPI_BATCH:
 			{
 				ProtoResTransfer *t = &response->response.transfer;
 
@@ -79,6 +181,32 @@ void proto_res_assign(ProtoRes *response, void *memory, uint16_t memorySize) {
 			}
 			break;
 
+		case PROTO_CMD_FLASH_READ:
+			{
+				ProtoResFlashRead *r = &response->response.flashRead;
+
+				if (r->dataSize) {
+					r->data = PTR_U8(memory);
+
+				} else {
+					r->data = NULL;
+				}
+			}
+			break;
+
+		case PROTO_CMD_FLASH_COMPARE:
+			{
+				ProtoResFlashCompare *c = &response->response.flashCompare;
+
+				if (c->bitmapSize) {
+					c->bitmap = PTR_U8(memory);
+
+				} else {
+					c->bitmap = NULL;
+				}
+			}
+			break;
+
 		default:
 			{
 
@@ -99,10 +227,24 @@ uint16_t proto_res_encode(ProtoRes *response, void *memory, uint16_t memorySize)
 				PTR_U8(memory)[ret++] = (info->version.major << 4) | (info->version.minor & 0x0f);
 
 				ret += proto_int_val_encode(info->packetSize, PTR_U8(memory) + ret);
+
+				PTR_U8(memory)[ret++] = info->windowSize;
+				PTR_U8(memory)[ret++] = info->cmds >> 8;
+				PTR_U8(memory)[ret++] = info->cmds & 0xff;
+				PTR_U8(memory)[ret++] = info->features;
+				PTR_U8(memory)[ret++] = info->checksums;
+
+				// SPI bus fields are omitted when they do not fit into a frame of tiny programmer
+				if (ret + 4 + 1 <= memorySize) {
+					ret += proto_int32_encode(info->spiClock, PTR_U8(memory) + ret);
+
+					PTR_U8(memory)[ret++] = info->ioWidths;
+				}
 			}
 			break;
 
 		case PROTO_CMD_SPI_TRANSFER:
+		case PROTO_CMD_SPI_BATCH:
 			{
 				ProtoResTransfer *t = &response->response.transfer;
 
@@ -110,6 +252,64 @@ uint16_t proto_res_encode(ProtoRes *response, void *memory, uint16_t memorySize)
 			}
 			break;
 
+		case PROTO_CMD_FLASH_READ:
+			{
+				ret += response->response.flashRead.dataSize;
+			}
+			break;
+
+		case PROTO_CMD_FLASH_WRITE_PAGE:
+			{
+				ProtoResFlashWritePage *w = &response->response.flashWritePage;
+
+				PTR_U8(memory)[ret++] = w->status;
+
+				ret += proto_int16_encode(w->polls, PTR_U8(memory) + ret);
+			}
+			break;
+
+		case PROTO_CMD_SPI_POLL:
+			{
+				ProtoResSpiPoll *p = &response->response.spiPoll;
+
+				PTR_U8(memory)[ret++] = p->status;
+
+				ret += proto_int16_encode(p->polls, PTR_U8(memory) + ret);
+			}
+			break;
+
+		case PROTO_CMD_FLASH_CRC32:
+			{
+				ret += proto_int32_encode(response->response.flashCrc32.crc, PTR_U8(memory) + ret);
+			}
+			break;
+
+		case PROTO_CMD_FLASH_BLANK_CHECK:
+			{
+				ret += proto_int32_encode(response->response.flashBlankCheck.offset, PTR_U8(memory) + ret);
+			}
+			break;
+
+		case PROTO_CMD_SPI_CONFIG:
+			{
+				ret += proto_int32_encode(response->response.spiConfig.clock, PTR_U8(memory) + ret);
+
+				PTR_U8(memory)[ret++] = response->response.spiConfig.mode;
+			}
+			break;
+
+		case PROTO_CMD_SERIAL_BAUD:
+			{
+				ret += proto_int32_encode(response->response.serialBaud.baud, PTR_U8(memory) + ret);
+			}
+			break;
+
+		case PROTO_CMD_FLASH_COMPARE:
+			{
+				ret += response->response.flashCompare.bitmapSize;
+			}
+			break;
+
 		default:
 			break;
 	}
@@ -131,10 +331,45 @@ uint16_t proto_res_decode(ProtoRes *response, void *memory, uint16_t memorySize)
 				info->packetSize   = proto_int_val_decode(PTR_U8(memory) + ret);
 
 				ret += proto_int_val_length_estimate(info->packetSize);
+
+				// Optional fields, not sent by older programmers.
+				info->windowSize = 1;
+				info->cmds       = PROTO_CMD_MASK(PROTO_CMD_GET_INFO) | PROTO_CMD_MASK(PROTO_CMD_SPI_TRANSFER);
+				info->features   = 0;
+				info->checksums  = PROTO_CHECKSUM_MASK(PROTO_CHECKSUM_CRC8);
+				info->spiClock   = 0;
+				info->ioWidths   = PROTO_IO_WIDTH_SINGLE;
+
+				if (ret < memorySize) {
+					info->windowSize = PTR_U8(memory)[ret++];
+				}
+
+				if (ret + 2 <= memorySize) {
+					info->cmds = ((uint16_t) PTR_U8(memory)[ret] << 8) | PTR_U8(memory)[ret + 1];
+
+					ret += 2;
+				}
+
+				if (ret < memorySize) {
+					info->features = PTR_U8(memory)[ret++];
+				}
+
+				if (ret < memorySize) {
+					info->checksums = PTR_U8(memory)[ret++];
+				}
+
+				if (ret + 4 <= memorySize) {
+					info->spiClock = proto_int32_decode(PTR_U8(memory) + ret); ret += 4;
+				}
+
+				if (ret < memorySize) {
+					info->ioWidths = PTR_U8(memory)[ret++];
+				}
 			}
 			break;
 
 		case PROTO_CMD_SPI_TRANSFER:
+		case PROTO_CMD_SPI_BATCH:
 			{
 				ProtoResTransfer *t = &response->response.transfer;
 
@@ -145,6 +380,71 @@ uint16_t proto_res_decode(ProtoRes *response, void *memory, uint16_t memorySize)
 			}
 			break;
 
+		case PROTO_CMD_FLASH_READ:
+			{
+				ProtoResFlashRead *r = &response->response.flashRead;
+
+				r->data     = NULL;
+				r->dataSize = memorySize;
+
+				ret += r->dataSize;
+			}
+			break;
+
+		case PROTO_CMD_FLASH_WRITE_PAGE:
+			{
+				ProtoResFlashWritePage *w = &response->response.flashWritePage;
+
+				w->status = PTR_U8(memory)[ret++];
+				w->polls  = proto_int16_decode(PTR_U8(memory) + ret); ret += 2;
+			}
+			break;
+
+		case PROTO_CMD_SPI_POLL:
+			{
+				ProtoResSpiPoll *p = &response->response.spiPoll;
+
+				p->status = PTR_U8(memory)[ret++];
+				p->polls  = proto_int16_decode(PTR_U8(memory) + ret); ret += 2;
+			}
+			break;
+
+		case PROTO_CMD_FLASH_CRC32:
+			{
+				response->response.flashCrc32.crc = proto_int32_decode(PTR_U8(memory) + ret); ret += 4;
+			}
+			break;
+
+		case PROTO_CMD_FLASH_BLANK_CHECK:
+			{
+				response->response.flashBlankCheck.offset = proto_int32_decode(PTR_U8(memory) + ret); ret += 4;
+			}
+			break;
+
+		case PROTO_CMD_SPI_CONFIG:
+			{
+				response->response.spiConfig.clock = proto_int32_decode(PTR_U8(memory) + ret); ret += 4;
+				response->response.spiConfig.mode  = PTR_U8(memory)[ret++];
+			}
+			break;
+
+		case PROTO_CMD_SERIAL_BAUD:
+			{
+				response->response.serialBaud.baud = proto_int32_decode(PTR_U8(memory) + ret); ret += 4;
+			}
+			break;
+
+		case PROTO_CMD_FLASH_COMPARE:
+			{
+				ProtoResFlashCompare *c = &response->response.flashCompare;
+
+				c->bitmap     = NULL;
+				c->bitmapSize = memorySize;
+
+				ret += c->bitmapSize;
+			}
+			break;
+
 		default:
 			break;
 	}
@@ -0,0 +1,135 @@
+#include "common/rle.h"
+
+
+static uint16_t _getRunLength(const uint8_t *src, uint16_t srcSize) {
+	uint16_t ret = 1;
+
+	while (ret < srcSize && ret < RLE_RUN_MAX && src[ret] == src[0]) {
+		ret++;
+	}
+
+	return ret;
+}
+
+
+uint16_t rle_encode(uint8_t *dst, const uint8_t *src, uint16_t srcSize) {
+	uint16_t ret = 0;
+	uint16_t i   = 0;
+
+	while (i < srcSize) {
+		uint16_t length = _getRunLength(src + i, srcSize - i);
+
+		if (length >= RLE_RUN_MIN) {
+			uint8_t value = src[i];
+
+			dst[ret++] = RLE_RUN_FLAG | (length - RLE_RUN_MIN);
+			dst[ret++] = value;
+
+		} else {
+			uint16_t j;
+
+			// Literal block ends where the next run starts
+			length = 0;
+			while (i + length < srcSize && length < RLE_LITERAL_MAX) {
+				if (length > 0 && _getRunLength(src + i + length, srcSize - i - length) >= RLE_RUN_MIN) {
+					break;
+				}
+
+				length++;
+			}
+
+			dst[ret++] = length - 1;
+
+			// Forward copy, dst never overtakes src when buffers overlap
+			for (j = 0; j < length; j++) {
+				dst[ret++] = src[i + j];
+			}
+		}
+
+		i += length;
+	}
+
+	return ret;
+}
+
+
+int32_t rle_decode(uint8_t *dst, uint16_t dstSize, const uint8_t *src, uint16_t srcSize) {
+	int32_t  ret = 0;
+	uint16_t i   = 0;
+
+	while (i < srcSize) {
+		uint8_t  header = src[i++];
+		uint16_t length;
+		uint16_t j;
+
+		if (header & RLE_RUN_FLAG) {
+			length = (header & ~RLE_RUN_FLAG) + RLE_RUN_MIN;
+
+			if (i + 1 > srcSize || ret + length > dstSize) {
+				return RLE_ERROR;
+			}
+
+			for (j = 0; j < length; j++) {
+				dst[ret++] = src[i];
+			}
+
+			i++;
+
+		} else {
+			length = header + 1;
+
+			if (i + length > srcSize || ret + length > dstSize) {
+				return RLE_ERROR;
+			}
+
+			for (j = 0; j < length; j++) {
+				dst[ret++] = src[i++];
+			}
+		}
+	}
+
+	return ret;
+}
+
+
+int32_t rle_getDecodedSize(const uint8_t *src, uint16_t srcSize) {
+	int32_t  ret = 0;
+	uint16_t i   = 0;
+
+	while (i < srcSize) {
+		uint8_t header = src[i++];
+
+		if (header & RLE_RUN_FLAG) {
+			ret += (header & ~RLE_RUN_FLAG) + RLE_RUN_MIN;
+			i   += 1;
+
+		} else {
+			ret += header + 1;
+			i   += header + 1;
+		}
+	}
+
+	if (i != srcSize) {
+		return RLE_ERROR;
+	}
+
+	return ret;
+}
+
+
+uint16_t rle_getMaxDecodedSize(uint16_t encodedSize) {
+	uint16_t ret;
+
+	if (encodedSize == 0) {
+		return 0;
+	}
+
+	ret = encodedSize - 1;
+	ret = ret - ret / (RLE_LITERAL_MAX + 1);
+
+	while (RLE_MAX_SIZE(ret) > encodedSize) {
+		ret--;
+	}
+
+	return ret;
+}
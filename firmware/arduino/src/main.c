@@ -6,6 +6,8 @@
  */
 
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
 
 #include "common/protocol.h"
 
@@ -50,6 +52,32 @@
 
 #define _waitForTransmit() while (! (UCSR0A & _BV(UDRE0)));
 
+/*
+ * Received bytes are queued by the RX interrupt. It allows to receive next
+ * request while the current one is still being processed or its response is
+ * being transmitted. The buffer has to be able to keep at least one complete
+ * frame (DATA_BUFFER_SIZE bytes).
+ */
+#define UART_RX_BUFFER_SIZE 512
+#define UART_RX_BUFFER_MASK (UART_RX_BUFFER_SIZE - 1)
+
+static volatile uint8_t  _uartRxBuffer[UART_RX_BUFFER_SIZE];
+static volatile uint16_t _uartRxHead;
+static volatile uint16_t _uartRxTail;
+
+
+ISR(USART_RX_vect) {
+	uint8_t byte = UDR0;
+
+	// Head and tail are free running counters. Drop the byte on overflow,
+	// the host will detect broken frame.
+	if ((uint16_t)(_uartRxHead - _uartRxTail) < UART_RX_BUFFER_SIZE) {
+		_uartRxBuffer[_uartRxHead & UART_RX_BUFFER_MASK] = byte;
+		_uartRxHead++;
+	}
+}
+
+
 void uart_initialize() {
 	// Configure usart
 	UBRR0H = ((UART_BAUD_REG) >> 8);
@@ -62,20 +90,155 @@ void uart_initialize() {
 	// 8bit, 1bit stop, no parity
 	UCSR0C  = _BV(UCSZ00) | _BV(UCSZ01);
 
+	_uartRxHead = 0;
+	_uartRxTail = 0;
+
 	// enable
-	UCSR0B |= (_BV(TXEN0) | _BV(RXEN0));
+	UCSR0B |= (_BV(TXEN0) | _BV(RXEN0) | _BV(RXCIE0));
 }
 
 
 void uart_send(char c) {
 	_waitForTransmit();
 
+	// Cleared by writing one, set again when the byte leaves the shift register. Error flags have to be written as zero.
+	UCSR0A = (UCSR0A & (_BV(U2X0) | _BV(MPCM0))) | _BV(TXC0);
+
 	UDR0 = c;
 }
 
 
+/************************
+ * Timer
+ */
+
+// Timer 1 in CTC mode interrupts every TIMER_TICK_MS
+#define TIMER_TICK_MS   10
+#define TIMER_PRESCALER 1024
+
+#define TIMER_COMPARE_REG ((uint16_t) ((F_CPU / TIMER_PRESCALER) * TIMER_TICK_MS / 1000 - 1))
+
+#define TIMER_TICKS(_ms) (((_ms) + TIMER_TICK_MS - 1) / TIMER_TICK_MS)
+
+
+static void uart_onTimerTick();
+
+
+ISR(TIMER1_COMPA_vect) {
+	uart_onTimerTick();
+}
+
+
+void timer_initialize() {
+	OCR1A  = TIMER_COMPARE_REG;
+	TCCR1A = 0;
+	TCCR1B = _BV(WGM12) | _BV(CS12) | _BV(CS10);
+
+	TIMSK1 = _BV(OCIE1A);
+}
+
+
+/*
+ * Rate switched by SERIAL_BAUD command. Double speed mode is used for all
+ * rates, rates with error above 2% are rejected.
+ */
+#define UART_BAUD_MAX_ERROR_PERMILLE 20
+
+// Timer ticks after which not confirmed rate is reverted
+#define UART_BAUD_CONFIRM_TICKS TIMER_TICKS(PROTO_SERIAL_BAUD_TIMEOUT_MS)
+
+#if UART_BAUD_CONFIRM_TICKS > 255
+	#error "Confirmation window does not fit into 8 bit counter"
+#endif
+
+static uint16_t _uartBaudRegPending;
+
+// Decremented by the timer interrupt, single byte is written atomically
+static volatile uint8_t _uartBaudConfirmTicks;
+static volatile uint8_t _uartBaudReverted;
+
+// Rate restored if the new one is not confirmed
+static uint8_t _uartPreviousUbrrH;
+static uint8_t _uartPreviousUbrrL;
+static uint8_t _uartPreviousU2x;
+
+
+/*
+ * Returns value of UBRR register (+1, 0 if rate is not available) for given
+ * rate in double speed mode.
+ */
+static uint16_t uart_getBaudReg(uint32_t baud) {
+	uint32_t div;
+	uint32_t real;
+
+	if (baud == 0 || baud > F_CPU / 8) {
+		return 0;
+	}
+
+	div  = (F_CPU / 8 + baud / 2) / baud;
+	real = F_CPU / 8 / div;
+
+	if (div > 4096) {
+		return 0;
+	}
+
+	if ((real > baud ? real - baud : baud - real) * 1000 > baud * UART_BAUD_MAX_ERROR_PERMILLE) {
+		return 0;
+	}
+
+	return div;
+}
+
+
+/*
+ * Called when the response of SERIAL_BAUD is sent.
+ */
+static void uart_switchPendingBaud() {
+	if (_uartBaudRegPending == 0) {
+		return;
+	}
+
+	// Wait until the last byte of the response leaves the shift register
+	while (! (UCSR0A & _BV(TXC0))) {}
+
+	_uartPreviousUbrrH = UBRR0H;
+	_uartPreviousUbrrL = UBRR0L;
+	_uartPreviousU2x   = UCSR0A & _BV(U2X0);
+
+	UCSR0A = (UCSR0A & _BV(MPCM0)) | _BV(U2X0);
+	UBRR0H = (_uartBaudRegPending - 1) >> 8;
+	UBRR0L = (_uartBaudRegPending - 1) & 0xff;
+
+	_uartBaudRegPending   = 0;
+	_uartBaudConfirmTicks = UART_BAUD_CONFIRM_TICKS;
+}
+
+
+/*
+ * Reverts not confirmed rate, called from the timer interrupt. Bytes
+ * received with the wrong rate do not delay it.
+ */
+static void uart_onTimerTick() {
+	if (_uartBaudConfirmTicks == 0 || --_uartBaudConfirmTicks > 0) {
+		return;
+	}
+
+	UCSR0A = (UCSR0A & _BV(MPCM0)) | _uartPreviousU2x;
+	UBRR0H = _uartPreviousUbrrH;
+	UBRR0L = _uartPreviousUbrrL;
+
+	_uartBaudReverted = 1;
+}
+
+
 char uart_poll() {
-	if (UCSR0A & _BV(RXC0)) {
+	uint16_t head;
+
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		head = _uartRxHead;
+	}
+
+	if (head != _uartRxTail) {
 		return 1;
 	}
 
@@ -84,7 +247,13 @@ char uart_poll() {
 
 
 uint8_t uart_get() {
-	return UDR0;
+	uint8_t ret = _uartRxBuffer[_uartRxTail & UART_RX_BUFFER_MASK];
+
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		_uartRxTail++;
+	}
+
+	return ret;
 }
 
 
@@ -118,6 +287,54 @@ void spi_initialize() {
 }
 
 
+/*
+ * Selects the fastest f_osc/2^n clock (n = 1..7) not exceeding given one,
+ * returns the clock really set.
+ */
+static uint32_t spi_configure(uint32_t clock, uint8_t mode) {
+	uint8_t shift = 1;
+
+	if (clock == 0) {
+		clock = F_CPU / 2;
+	}
+
+	while (shift < 7 && (F_CPU >> shift) > clock) {
+		shift++;
+	}
+
+	{
+		uint8_t spcr = SPCR & ~(_BV(SPR1) | _BV(SPR0) | _BV(CPOL) | _BV(CPHA));
+
+		// f_osc/128 has no double speed variant
+		if (shift == 7) {
+			spcr |= _BV(SPR1) | _BV(SPR0);
+			SPSR &= ~_BV(SPI2X);
+
+		} else {
+			spcr |= (shift - 1) / 2;
+
+			if (shift & 1) {
+				SPSR |= _BV(SPI2X);
+			} else {
+				SPSR &= ~_BV(SPI2X);
+			}
+		}
+
+		if (mode & PROTO_SPI_MODE_CPOL) {
+			spcr |= _BV(CPOL);
+		}
+
+		if (mode & PROTO_SPI_MODE_CPHA) {
+			spcr |= _BV(CPHA);
+		}
+
+		SPCR = spcr;
+	}
+
+	return F_CPU >> shift;
+}
+
+
 static void _programmerRequestCallback(ProtoReq *request, ProtoRes *response, void *callbackData) {
 	switch (request->cmd) {
 		case PROTO_CMD_SPI_TRANSFER:
@@ -154,6 +371,24 @@ static void _programmerRequestCallback(ProtoReq *request, ProtoRes *response, vo
 			}
 			break;
 
+		case PROTO_CMD_SPI_CONFIG:
+			{
+				ProtoResSpiConfig *res = &response->response.spiConfig;
+
+				res->clock = spi_configure(res->clock, res->mode);
+			}
+			break;
+
+		case PROTO_CMD_SERIAL_BAUD:
+			{
+				_uartBaudRegPending = uart_getBaudReg(request->request.serialBaud.baud);
+
+				if (_uartBaudRegPending != 0) {
+					response->response.serialBaud.baud = request->request.serialBaud.baud;
+				}
+			}
+			break;
+
 		default:
 			break;
 	}
@@ -164,6 +399,13 @@ static void _programmerResponseCallback(uint8_t *buffer, uint16_t bufferSize, vo
 	for (uint16_t i = 0; i < bufferSize; i++) {
 		uart_send(buffer[i]);
 	}
+
+	// A valid request has been received with the new rate
+	if ((buffer[0] & PROTO_CMD_NIBBLE_MASK) == PROTO_NO_ERROR) {
+		_uartBaudConfirmTicks = 0;
+	}
+
+	uart_switchPendingBaud();
 }
 
 
@@ -177,6 +419,7 @@ int main(int argc, char *argv[]) {
 
 	uart_initialize();
 	spi_initialize();
+	timer_initialize();
 
 	programmer_setup(
 		&programmer,
@@ -187,11 +430,26 @@ int main(int argc, char *argv[]) {
 		NULL
 	);
 
+	// RX buffer keeps one complete request while the other one is processed.
+	programmer_setWindowSize(&programmer, 2);
+
+	// SPI runs at f_osc/2 (see spi_initialize())
+	programmer_setSpiInfo(&programmer, F_CPU / 2, PROTO_IO_WIDTH_SINGLE);
+
+	sei();
+
 	{
 		uint16_t idleCounter = 0;
 
 		while (1) {
 			if (! uart_poll()) {
+				// Frame started with the wrong rate is abandoned
+				if (_uartBaudReverted) {
+					_uartBaudReverted = 0;
+
+					programmer_reset(&programmer);
+				}
+
 				if (++idleCounter == 60000) {
 					programmer_reset(&programmer);
 				}
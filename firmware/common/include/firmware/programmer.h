@@ -12,15 +12,66 @@
 extern "C" {
 #endif
 
+/*
+ * Called for SPI_TRANSFER, SPI_CONFIG and SERIAL_BAUD requests. For SPI_CONFIG
+ * the platform sets clock and mode of the response (clock 0 selects the
+ * maximal one) and stores the clock really generated back into the response.
+ * For SERIAL_BAUD it sets the requested rate in the response if it switches
+ * to it once the response is sent (see PROTO_CMD_SERIAL_BAUD).
+ */
 typedef void (*ProgrammerRequestCallback)(ProtoReq *request, ProtoRes *response, void *callbackData);
 typedef void (*ProgrammerResponseCallback)(uint8_t *buffer, uint16_t bufferSize, void *callbackData);
 
+/*
+ * Number of executed requests remembered to recognize retransmissions
+ * (PROTO_FEATURE_RETRANSMIT), it limits the window size.
+ */
+#ifndef PROGRAMMER_HISTORY_SIZE
+#define PROGRAMMER_HISTORY_SIZE 4
+#endif
+
+/*
+ * Responses with payload up to this size are remembered and sent again when
+ * the request is retransmitted. It covers responses of FLASH_WRITE_PAGE and
+ * short SPI_TRANSFER reads like status or ID registers.
+ */
+#ifndef PROGRAMMER_HISTORY_PAYLOAD_SIZE
+#define PROGRAMMER_HISTORY_PAYLOAD_SIZE 4
+#endif
+
+typedef struct _ProgrammerHistory {
+	uint8_t id;
+	uint8_t cmd;
+
+	/// Response of the request, payloadSize is 0xff if it was not remembered
+	uint8_t code;
+	uint8_t payloadSize;
+	uint8_t payload[PROGRAMMER_HISTORY_PAYLOAD_SIZE];
+} ProgrammerHistory;
+
 typedef struct _Programmer {
 	uint8_t *mem;
 	uint16_t memSize;
 
+	uint8_t windowSize;
+
+	/// SPI bus parameters reported by GET_INFO
+	uint32_t spiClock;
+	uint8_t  ioWidths;
+
+	/// Checksum of the request being processed, used by its response frames
+	uint8_t checksum;
+
 	ProtoPktDes packetDeserializer;
 
+	/// Ring of executed requests, empty until GET_INFO starts a session
+	ProgrammerHistory history[PROGRAMMER_HISTORY_SIZE];
+	uint8_t           historySize;
+	uint8_t           historyLast;
+
+	/// Entry of the request being processed, its response is remembered there
+	ProgrammerHistory *historyEntry;
+
 	ProgrammerRequestCallback  requestCallback;
 	ProgrammerResponseCallback responseCallback;
 	void                      *callbackData;
@@ -36,8 +87,29 @@ void programmer_setup(
 	void                      *callbackData
 );
 
+/*
+ * Sets number of requests which can be received by the platform while
+ * the previous one is still being processed. It is reported to the host by
+ * GET_INFO command. Default value is 1 (no pipelining), it is limited to
+ * PROGRAMMER_HISTORY_SIZE.
+ */
+void programmer_setWindowSize(Programmer *programmer, uint8_t windowSize);
+
+/*
+ * Sets SPI clock in Hz and bitmap of I/O widths (PROTO_IO_WIDTH_*) reported
+ * to the host by GET_INFO command. By default clock is unknown (0) and only
+ * single I/O is reported.
+ */
+void programmer_setSpiInfo(Programmer *programmer, uint32_t spiClock, uint8_t ioWidths);
+
 void programmer_putByte(Programmer *programmer, uint8_t byte);
 
+/*
+ * Feeds a chunk of received bytes, payload is copied in bulk. Equivalent to
+ * calling programmer_putByte for each byte.
+ */
+void programmer_putBytes(Programmer *programmer, const uint8_t *bytes, uint16_t bytesSize);
+
 void programmer_reset(Programmer *programmer);
 
 #ifdef __cplusplus
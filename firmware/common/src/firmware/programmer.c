@@ -1,7 +1,64 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/crc32.h"
+#include "common/rle.h"
 #include "common/protocol.h"
 
 #include "firmware/programmer.h"
 
+#define FLASH_CMD_READ         0x03
+#define FLASH_CMD_WRITE_ENABLE 0x06
+#define FLASH_CMD_PAGE_PROGRAM 0x02
+#define FLASH_CMD_READ_STATUS  0x05
+
+#define FLASH_STATUS_WIP 0x01
+
+// Stack buffer used to read pages being compared
+#define FLASH_COMPARE_BUFFER_SIZE 32
+
+// Stack buffer used to expand runs of RLE encoded TX data
+#define RLE_RUN_BUFFER_SIZE 16
+
+#define PROGRAMMER_CMDS ( \
+	PROTO_CMD_MASK(PROTO_CMD_GET_INFO)          | \
+	PROTO_CMD_MASK(PROTO_CMD_SPI_TRANSFER)      | \
+	PROTO_CMD_MASK(PROTO_CMD_FLASH_READ)        | \
+	PROTO_CMD_MASK(PROTO_CMD_FLASH_WRITE_PAGE)  | \
+	PROTO_CMD_MASK(PROTO_CMD_SPI_POLL)          | \
+	PROTO_CMD_MASK(PROTO_CMD_FLASH_CRC32)       | \
+	PROTO_CMD_MASK(PROTO_CMD_FLASH_BLANK_CHECK) | \
+	PROTO_CMD_MASK(PROTO_CMD_FLASH_COMPARE)     | \
+	PROTO_CMD_MASK(PROTO_CMD_SPI_BATCH)         | \
+	PROTO_CMD_MASK(PROTO_CMD_SPI_CONFIG)        | \
+	PROTO_CMD_MASK(PROTO_CMD_SERIAL_BAUD)         \
+)
+
+#define PROGRAMMER_FEATURES ( \
+	PROTO_FEATURE_RLE        | \
+	PROTO_FEATURE_TX_RLE     | \
+	PROTO_FEATURE_RETRANSMIT   \
+)
+
+// Commands executed again when they are retransmitted and their response was not remembered
+#define PROGRAMMER_IDEMPOTENT_CMDS ( \
+	PROTO_CMD_MASK(PROTO_CMD_GET_INFO)          | \
+	PROTO_CMD_MASK(PROTO_CMD_FLASH_READ)        | \
+	PROTO_CMD_MASK(PROTO_CMD_SPI_POLL)          | \
+	PROTO_CMD_MASK(PROTO_CMD_FLASH_CRC32)       | \
+	PROTO_CMD_MASK(PROTO_CMD_FLASH_BLANK_CHECK) | \
+	PROTO_CMD_MASK(PROTO_CMD_FLASH_COMPARE)     | \
+	PROTO_CMD_MASK(PROTO_CMD_SPI_CONFIG)          \
+)
+
+#define HISTORY_NOT_REMEMBERED 0xff
+
+#define PROGRAMMER_CHECKSUMS ( \
+	PROTO_CHECKSUM_MASK(PROTO_CHECKSUM_CRC8)  | \
+	PROTO_CHECKSUM_MASK(PROTO_CHECKSUM_CRC16) | \
+	PROTO_CHECKSUM_MASK(PROTO_CHECKSUM_CRC32)   \
+)
+
 
 void programmer_setup(
 	Programmer                *programmer,
@@ -11,8 +68,16 @@ void programmer_setup(
 	ProgrammerResponseCallback responseCallback,
 	void                      *callbackData
 ) {
-	programmer->mem     = memory;
-	programmer->memSize = memorySize;
+	programmer->mem        = memory;
+	programmer->memSize    = memorySize;
+	programmer->windowSize = 1;
+	programmer->spiClock   = 0;
+	programmer->ioWidths   = PROTO_IO_WIDTH_SINGLE;
+	programmer->checksum   = PROTO_CHECKSUM_CRC8;
+
+	programmer->historySize  = 0;
+	programmer->historyLast  = 0;
+	programmer->historyEntry = NULL;
 
 	programmer->requestCallback  = requestCallback;
 	programmer->responseCallback = responseCallback;
@@ -26,87 +91,827 @@ void programmer_setup(
 }
 
 
+void programmer_setWindowSize(Programmer *programmer, uint8_t windowSize) {
+	if (windowSize == 0) {
+		windowSize = 1;
+	}
+
+	// Every request of the window has to be recognized when it is retransmitted
+	if (windowSize > PROGRAMMER_HISTORY_SIZE) {
+		windowSize = PROGRAMMER_HISTORY_SIZE;
+	}
+
+	programmer->windowSize = windowSize;
+}
+
+
+void programmer_setSpiInfo(Programmer *programmer, uint32_t spiClock, uint8_t ioWidths) {
+	if (ioWidths == 0) {
+		ioWidths = PROTO_IO_WIDTH_SINGLE;
+	}
+
+	programmer->spiClock = spiClock;
+	programmer->ioWidths = ioWidths;
+}
+
+
+/*
+ * Initializes response frame protected with checksum of the request.
+ */
+static void _initPacket(Programmer *programmer, ProtoPkt *packet, uint8_t code, uint8_t id) {
+	proto_pkt_init       (packet, programmer->mem, programmer->memSize, code, id);
+	proto_pkt_setChecksum(packet, programmer->mem, programmer->memSize, programmer->checksum);
+}
+
+
+/*
+ * Encodes response frame and passes it to the platform. Response of the
+ * request being processed is remembered if it is small enough.
+ */
+static void _sendPacket(Programmer *programmer, ProtoPkt *packet) {
+	ProgrammerHistory *entry = programmer->historyEntry;
+
+	if (entry != NULL && packet->payloadSize <= PROGRAMMER_HISTORY_PAYLOAD_SIZE) {
+		entry->code        = packet->code;
+		entry->payloadSize = packet->payloadSize;
+
+		if (packet->payloadSize) {
+			memcpy(entry->payload, packet->payload, packet->payloadSize);
+		}
+	}
+
+	programmer->responseCallback(
+		programmer->mem, proto_pkt_encode(packet, programmer->mem, programmer->memSize), programmer->callbackData
+	);
+}
+
+
+/*
+ * Replaces the response with NAK frame carrying the error code and ID of the
+ * request, it is sent by _sendPacket.
+ */
 static void _sendError(Programmer *programmer, ProtoPkt *packet, ProtoRes *response, uint8_t errorCode) {
-	proto_pkt_init(packet, programmer->mem, programmer->memSize, packet->code, packet->id);
+	_initPacket(programmer, packet, errorCode, packet->id);
 	proto_pkt_prepare(packet, programmer->mem, programmer->memSize, 0);
 }
 
 
-void programmer_putByte(Programmer *programmer, uint8_t byte) {
-	ProtoPkt packet;
+/*
+ * Executes SPI transfer using platform's SPI_TRANSFER implementation. RX data
+ * is collected after all TX bytes are sent.
+ */
+static void _spiTransfer(
+	Programmer *programmer,
+	uint8_t    *txBuffer,
+	uint16_t    txBufferSize,
+	uint8_t    *rxBuffer,
+	uint16_t    rxBufferSize,
+	uint8_t     flags
+) {
+	ProtoReq request;
+	ProtoRes response;
 
-	uint8_t ret = proto_pkt_dec_putByte(&programmer->packetDeserializer, byte, &packet);
+	request.cmd  = PROTO_CMD_SPI_TRANSFER;
+	response.cmd = PROTO_CMD_SPI_TRANSFER;
 
-	if (ret != PROTO_PKT_DES_RET_IDLE) {
-		ProtoRes response;
+	{
+		ProtoReqTransfer *t = &request.request.transfer;
+
+		t->txBuffer     = txBuffer;
+		t->txBufferSize = txBufferSize;
+		t->rxBufferSize = rxBufferSize;
+		t->rxSkipSize   = rxBufferSize ? txBufferSize : 0;
+		t->flags        = flags;
+	}
+
+	{
+		ProtoResTransfer *t = &response.response.transfer;
+
+		t->rxBuffer     = rxBuffer;
+		t->rxBufferSize = rxBufferSize;
+	}
+
+	programmer->requestCallback(&request, &response, programmer->callbackData);
+}
+
+
+/*
+ * Sends READ instruction, CS is left asserted.
+ */
+static void _flashReadBegin(Programmer *programmer, uint32_t address) {
+	uint8_t header[4];
+
+	header[0] = FLASH_CMD_READ;
+	header[1] = (address >> 16) & 0xff;
+	header[2] = (address >>  8) & 0xff;
+	header[3] = (address >>  0) & 0xff;
+
+	_spiTransfer(programmer, header, sizeof(header), NULL, 0, PROTO_SPI_TRANSFER_FLAG_KEEP_CS);
+}
+
+
+/*
+ * Prepares packet with RLE encoded data. The data has to be placed at the end
+ * of programmer memory, encoded data is written in front of it.
+ */
+static void _preparePacketRle(Programmer *programmer, ProtoPkt *packet, const uint8_t *data, uint16_t dataSize) {
+	// Encoded after header with 2B VLEN, moved if the final header is shorter
+	uint8_t *payload     = programmer->mem + 4;
+	uint16_t payloadSize = rle_encode(payload, data, dataSize);
+
+	proto_pkt_prepare(packet, programmer->mem, programmer->memSize, payloadSize);
+
+	if (payloadSize) {
+		memmove(packet->payload, payload, payloadSize);
+	}
+}
+
+
+/*
+ * Executes SPI_TRANSFER with RLE encoded response. RX data is received at the
+ * end of programmer memory, behind TX data of the request.
+ */
+static void _spiTransferRle(Programmer *programmer, ProtoReq *request, ProtoPkt *packet) {
+	ProtoRes response;
+	uint16_t rxSize = request->request.transfer.rxBufferSize;
+	uint8_t *rx     = programmer->mem + programmer->memSize - rxSize;
+
+	response.cmd = PROTO_CMD_SPI_TRANSFER;
+
+	response.response.transfer.rxBuffer     = rx;
+	response.response.transfer.rxBufferSize = rxSize;
+
+	programmer->requestCallback(request, &response, programmer->callbackData);
+
+	_preparePacketRle(programmer, packet, rx, rxSize);
+
+	_sendPacket(programmer, packet);
+}
+
+
+/*
+ * Executes sub-transfers of SPI_BATCH request. RX data of all of them is
+ * received at the end of programmer memory, behind the request, then it is
+ * sent in a single response frame. Returns false if the request is invalid.
+ */
+static bool _spiBatch(Programmer *programmer, const ProtoReqSpiBatch *request, ProtoPkt *packet) {
+	uint32_t requestEnd = 0;
+	uint32_t rxSize     = 0;
+	uint16_t offset     = 0;
+	uint16_t size;
+	uint8_t *rx;
+
+	while (offset < request->transfersSize) {
+		ProtoReqTransfer transfer;
+
+		size = proto_req_spiBatch_getTransfer(request, offset, &transfer);
+
+		if (size == 0 || (transfer.flags & ~PROTO_SPI_TRANSFER_FLAG_KEEP_CS) != 0) {
+			return false;
+		}
+
+		rxSize += transfer.rxBufferSize;
+		offset += size;
+	}
+
+	if (request->transfersSize) {
+		requestEnd = (request->transfers - programmer->mem) + request->transfersSize;
+	}
+
+	if (rxSize > packet->payloadSize || requestEnd + rxSize > programmer->memSize) {
+		return false;
+	}
+
+	rx = programmer->mem + programmer->memSize - rxSize;
+
+	for (offset = 0; offset < request->transfersSize; offset += size) {
+		ProtoReq req;
+		ProtoRes res;
+
+		req.cmd = PROTO_CMD_SPI_TRANSFER;
+		res.cmd = PROTO_CMD_SPI_TRANSFER;
+
+		size = proto_req_spiBatch_getTransfer(request, offset, &req.request.transfer);
+
+		res.response.transfer.rxBuffer     = rx;
+		res.response.transfer.rxBufferSize = req.request.transfer.rxBufferSize;
+
+		programmer->requestCallback(&req, &res, programmer->callbackData);
+
+		rx += res.response.transfer.rxBufferSize;
+	}
+
+	proto_pkt_prepare(packet, programmer->mem, programmer->memSize, rxSize);
+
+	if (rxSize) {
+		memmove(packet->payload, programmer->mem + programmer->memSize - rxSize, rxSize);
+	}
+
+	_sendPacket(programmer, packet);
+
+	return true;
+}
+
+
+/*
+ * Sends RLE encoded data. Literals are sent directly from the data buffer,
+ * runs are expanded in a small stack buffer. Data has to be validated with
+ * rle_getDecodedSize() before.
+ */
+static void _spiTransmitRle(Programmer *programmer, uint8_t *data, uint16_t dataSize, uint8_t flags) {
+	uint16_t i = 0;
+
+	while (i < dataSize) {
+		uint8_t  header = data[i++];
+		uint16_t length;
+
+		if (header & RLE_RUN_FLAG) {
+			uint8_t buffer[RLE_RUN_BUFFER_SIZE];
+
+			length = (header & ~RLE_RUN_FLAG) + RLE_RUN_MIN;
+
+			memset(buffer, data[i++], sizeof(buffer));
+
+			while (length > 0) {
+				uint16_t chunkSize = length;
+
+				if (chunkSize > sizeof(buffer)) {
+					chunkSize = sizeof(buffer);
+				}
+
+				_spiTransfer(programmer, buffer, chunkSize, NULL, 0, PROTO_SPI_TRANSFER_FLAG_KEEP_CS);
+
+				length -= chunkSize;
+			}
+
+		} else {
+			length = header + 1;
+
+			_spiTransfer(programmer, data + i, length, NULL, 0, PROTO_SPI_TRANSFER_FLAG_KEEP_CS);
+
+			i += length;
+		}
+	}
+
+	if ((flags & PROTO_SPI_TRANSFER_FLAG_KEEP_CS) == 0) {
+		// Release CS
+		_spiTransfer(programmer, NULL, 0, NULL, 0, 0);
+	}
+}
+
+
+static void _flashRead(Programmer *programmer, const ProtoReqFlashRead *request, uint8_t id) {
+	uint32_t length = request->length;
+	bool     rle    = (request->flags & PROTO_FLASH_READ_FLAG_RLE) != 0;
+
+	_flashReadBegin(programmer, request->address);
+
+	do {
+		ProtoPkt packet;
+		uint16_t chunkSize;
+		uint8_t  flags;
+
+		_initPacket(programmer, &packet, PROTO_NO_ERROR, id);
+
+		chunkSize = packet.payloadSize;
+		if (rle) {
+			chunkSize = rle_getMaxDecodedSize(chunkSize);
+		}
+
+		if (chunkSize > length) {
+			chunkSize = length;
+		}
+
+		length -= chunkSize;
+
+		flags = length ? PROTO_SPI_TRANSFER_FLAG_KEEP_CS : 0;
+
+		if (rle) {
+			uint8_t *data = programmer->mem + programmer->memSize - chunkSize;
+
+			_spiTransfer(programmer, NULL, 0, data, chunkSize, flags);
+
+			_preparePacketRle(programmer, &packet, data, chunkSize);
+
+		} else {
+			proto_pkt_prepare(&packet, programmer->mem, programmer->memSize, chunkSize);
+
+			_spiTransfer(programmer, NULL, 0, packet.payload, chunkSize, flags);
+		}
+
+		programmer->responseCallback(
+			programmer->mem, proto_pkt_encode(&packet, programmer->mem, programmer->memSize), programmer->callbackData
+		);
+	} while (length > 0);
+}
+
+
+/*
+ * Reads flash region in chunks of bufferSize bytes and calculates its CRC-32.
+ */
+static uint32_t _flashCrc32(Programmer *programmer, const ProtoReqFlashCrc32 *request, uint8_t *buffer, uint16_t bufferSize) {
+	uint32_t length = request->length;
+	uint32_t ret    = CRC32_START;
+
+	_flashReadBegin(programmer, request->address);
+
+	do {
+		uint16_t chunkSize = bufferSize;
+
+		if (chunkSize > length) {
+			chunkSize = length;
+		}
+
+		length -= chunkSize;
+
+		_spiTransfer(programmer, NULL, 0, buffer, chunkSize, length ? PROTO_SPI_TRANSFER_FLAG_KEEP_CS : 0);
+
+		ret = crc32_get(buffer, chunkSize, ret);
+	} while (length > 0);
+
+	return ret;
+}
+
+
+/*
+ * Reads flash region in chunks of bufferSize bytes until non erased byte is
+ * found. Returns its offset or PROTO_FLASH_BLANK.
+ */
+static uint32_t _flashBlankCheck(Programmer *programmer, const ProtoReqFlashBlankCheck *request, uint8_t *buffer, uint16_t bufferSize) {
+	uint32_t offset = 0;
+	uint32_t ret    = PROTO_FLASH_BLANK;
+
+	_flashReadBegin(programmer, request->address);
+
+	while ((offset < request->length) && (ret == PROTO_FLASH_BLANK)) {
+		uint16_t chunkSize = bufferSize;
+		uint16_t i;
 
-		do {
-			ProtoReq request;
-			uint8_t  packetCmd;
+		if (chunkSize > request->length - offset) {
+			chunkSize = request->length - offset;
+		}
 
-			if (PROTO_PKT_DES_RET_GET_ERROR_CODE(ret) != PROTO_NO_ERROR) {
-				_sendError(programmer, &packet, &response, PROTO_PKT_DES_RET_GET_ERROR_CODE(ret));
+		_spiTransfer(programmer, NULL, 0, buffer, chunkSize, PROTO_SPI_TRANSFER_FLAG_KEEP_CS);
+
+		for (i = 0; i < chunkSize; i++) {
+			if (buffer[i] != 0xff) {
+				ret = offset + i;
 				break;
 			}
+		}
 
-			// Parse, assign request to coming packet
-			proto_req_init  (&request, packet.payload, packet.payloadSize, packet.code);
-			proto_req_decode(&request, packet.payload, packet.payloadSize);
-			proto_req_assign(&request, packet.payload, packet.payloadSize);
+		offset += chunkSize;
+	}
 
-			packetCmd = packet.code;
+	// Release CS
+	_spiTransfer(programmer, NULL, 0, NULL, 0, 0);
 
-			// Start preparation of response
-			proto_pkt_init(&packet, programmer->mem, programmer->memSize, PROTO_NO_ERROR, packet.id);
-			proto_res_init(&response, packet.payload, packet.payloadSize, packetCmd);
+	return ret;
+}
 
-			switch (request.cmd) {
-				case PROTO_CMD_GET_INFO:
-					{
-						ProtoResGetInfo *res = &response.response.getInfo;
 
-						res->version.major = PROTO_VERSION_MAJOR;
-						res->version.minor = PROTO_VERSION_MINOR;
+/*
+ * Reads consecutive pages and compares their CRC-32 with the ones sent by
+ * the host. Result bitmap is built in place of already compared CRCs, then
+ * it is sent in response frame.
+ */
+static void _flashCompare(Programmer *programmer, const ProtoReqFlashCompare *request, uint8_t id) {
+	uint8_t *bitmap     = request->crcs;
+	uint16_t bitmapSize = (request->pageCount + 7) / 8;
+	uint16_t page;
 
-						res->packetSize = programmer->memSize;
-					}
-					break;
+	_flashReadBegin(programmer, request->address);
+
+	for (page = 0; page < request->pageCount; page++) {
+		uint8_t  buffer[FLASH_COMPARE_BUFFER_SIZE];
+		uint16_t remaining = request->pageSize;
+		uint32_t crc       = CRC32_START;
+		uint32_t expected;
+
+		{
+			uint8_t *c = request->crcs + 4 * page;
+
+			expected =
+				((uint32_t) c[0] << 24) |
+				((uint32_t) c[1] << 16) |
+				((uint32_t) c[2] <<  8) |
+				((uint32_t) c[3] <<  0);
+		}
+
+		while (remaining > 0) {
+			uint16_t chunkSize = remaining;
+
+			if (chunkSize > sizeof(buffer)) {
+				chunkSize = sizeof(buffer);
+			}
+
+			_spiTransfer(programmer, NULL, 0, buffer, chunkSize, PROTO_SPI_TRANSFER_FLAG_KEEP_CS);
+
+			crc = crc32_get(buffer, chunkSize, crc);
+
+			remaining -= chunkSize;
+		}
+
+		if ((page % 8) == 0) {
+			bitmap[page / 8] = 0;
+		}
+
+		if (crc != expected) {
+			bitmap[page / 8] |= (1 << (page % 8));
+		}
+	}
+
+	// Release CS
+	_spiTransfer(programmer, NULL, 0, NULL, 0, 0);
+
+	{
+		ProtoPkt packet;
+
+		_initPacket      (programmer, &packet, PROTO_NO_ERROR, id);
+		proto_pkt_prepare(&packet, programmer->mem, programmer->memSize, bitmapSize);
+
+		if (bitmapSize) {
+			memmove(packet.payload, bitmap, bitmapSize);
+		}
+
+		_sendPacket(programmer, &packet);
+	}
+}
+
+
+/*
+ * Sends opcode and reads status bytes in a single CS cycle until
+ * (status & mask) == value or pollLimit reads were done. At least one read
+ * is done. Returns number of reads.
+ */
+static uint16_t _spiPoll(
+	Programmer *programmer,
+	uint8_t     opcode,
+	uint8_t     mask,
+	uint8_t     value,
+	uint16_t    pollLimit,
+	uint8_t    *status
+) {
+	uint16_t ret = 0;
+
+	_spiTransfer(programmer, &opcode, 1, NULL, 0, PROTO_SPI_TRANSFER_FLAG_KEEP_CS);
+
+	do {
+		_spiTransfer(programmer, NULL, 0, status, 1, PROTO_SPI_TRANSFER_FLAG_KEEP_CS);
+
+		ret++;
+	} while (((*status & mask) != value) && (ret < pollLimit));
+
+	// Release CS
+	_spiTransfer(programmer, NULL, 0, NULL, 0, 0);
+
+	return ret;
+}
+
+
+static void _flashWritePage(Programmer *programmer, const ProtoReqFlashWritePage *request, ProtoResFlashWritePage *response) {
+	uint8_t header[4];
+
+	header[0] = FLASH_CMD_WRITE_ENABLE;
+
+	_spiTransfer(programmer, header, 1, NULL, 0, 0);
+
+	header[0] = FLASH_CMD_PAGE_PROGRAM;
+	header[1] = (request->address >> 16) & 0xff;
+	header[2] = (request->address >>  8) & 0xff;
+	header[3] = (request->address >>  0) & 0xff;
+
+	_spiTransfer(programmer, header, sizeof(header), NULL, 0, PROTO_SPI_TRANSFER_FLAG_KEEP_CS);
+
+	if (request->flags & PROTO_FLASH_WRITE_PAGE_FLAG_RLE) {
+		_spiTransmitRle(programmer, request->data, request->dataSize, 0);
+
+	} else {
+		_spiTransfer(programmer, request->data, request->dataSize, NULL, 0, 0);
+	}
+
+	response->polls = _spiPoll(
+		programmer, FLASH_CMD_READ_STATUS, FLASH_STATUS_WIP, 0, request->pollLimit, &response->status
+	);
+}
+
+
+/*
+ * Checks ID of the request against the session (PROTO_FEATURE_RETRANSMIT)
+ * and selects its history entry. Returns false if the request must not be
+ * executed, it is then answered with the remembered response or rejected.
+ */
+static bool _checkSequence(Programmer *programmer, ProtoPkt *packet) {
+	ProgrammerHistory *entry;
+	uint8_t            i;
+
+	// GET_INFO starts a new session
+	if (packet->code == PROTO_CMD_GET_INFO) {
+		programmer->historySize = 0;
+		programmer->historyLast = PROGRAMMER_HISTORY_SIZE - 1;
+
+	} else if (programmer->historySize == 0) {
+		return true;
+	}
+
+	for (i = 0; i < programmer->historySize; i++) {
+		entry = &programmer->history[i];
+
+		if (entry->id != packet->id) {
+			continue;
+		}
+
+		// ID of a different request, the host is out of sync
+		if (entry->cmd != packet->code) {
+			_sendError (programmer, packet, NULL, PROTO_ERROR_OUT_OF_SEQUENCE);
+			_sendPacket(programmer, packet);
+			return false;
+		}
+
+		if (entry->payloadSize != HISTORY_NOT_REMEMBERED) {
+			_initPacket(programmer, packet, entry->code, entry->id);
+			proto_pkt_prepare(packet, programmer->mem, programmer->memSize, entry->payloadSize);
+
+			if (entry->payloadSize) {
+				memcpy(packet->payload, entry->payload, entry->payloadSize);
+			}
+
+			_sendPacket(programmer, packet);
+			return false;
+		}
+
+		if (PROTO_CMD_MASK(entry->cmd) & PROGRAMMER_IDEMPOTENT_CMDS) {
+			programmer->historyEntry = entry;
+			return true;
+		}
+
+		_sendError (programmer, packet, NULL, PROTO_ERROR_DUPLICATE);
+		_sendPacket(programmer, packet);
+		return false;
+	}
+
+	// Request following a lost one, it is sent again after the lost one
+	if (programmer->historySize > 0 && packet->id != (uint8_t) (programmer->history[programmer->historyLast].id + 1)) {
+		_sendError (programmer, packet, NULL, PROTO_ERROR_OUT_OF_SEQUENCE);
+		_sendPacket(programmer, packet);
+		return false;
+	}
+
+	programmer->historyLast = (programmer->historyLast + 1) % PROGRAMMER_HISTORY_SIZE;
+	if (programmer->historySize < PROGRAMMER_HISTORY_SIZE) {
+		programmer->historySize++;
+	}
+
+	entry = &programmer->history[programmer->historyLast];
+
+	entry->id          = packet->id;
+	entry->cmd         = packet->code;
+	entry->payloadSize = HISTORY_NOT_REMEMBERED;
+
+	programmer->historyEntry = entry;
+
+	return true;
+}
+
+
+/*
+ * Executes request of decoded frame (or reports decoding error) and sends
+ * the response.
+ */
+static void _processPacket(Programmer *programmer, ProtoPkt *packet, uint8_t ret) {
+	ProtoRes response;
+
+	programmer->checksum     = packet->checksum;
+	programmer->historyEntry = NULL;
 
-				case PROTO_CMD_SPI_TRANSFER:
-					{
-						ProtoResTransfer *res = &response.response.transfer;
+	do {
+		ProtoReq request;
+		uint8_t  packetCmd;
 
-						if (res->rxBufferSize < request.request.transfer.rxBufferSize) {
-							_sendError(programmer, &packet, &response, PROTO_ERROR_INVALID_MESSAGE);
+		if (PROTO_PKT_DES_RET_GET_ERROR_CODE(ret) != PROTO_NO_ERROR) {
+			_sendError(programmer, packet, &response, PROTO_PKT_DES_RET_GET_ERROR_CODE(ret));
+			break;
+		}
+
+		if (! _checkSequence(programmer, packet)) {
+			return;
+		}
+
+		// Parse, assign request to coming packet
+		proto_req_init  (&request, packet->payload, packet->payloadSize, packet->code);
+		proto_req_decode(&request, packet->payload, packet->payloadSize);
+		proto_req_assign(&request, packet->payload, packet->payloadSize);
+
+		packetCmd = packet->code;
+
+		// Start preparation of response
+		_initPacket   (programmer, packet, PROTO_NO_ERROR, packet->id);
+		proto_res_init(&response, packet->payload, packet->payloadSize, packetCmd);
+
+		switch (request.cmd) {
+			case PROTO_CMD_GET_INFO:
+				{
+					ProtoResGetInfo *res = &response.response.getInfo;
+
+					res->version.major = PROTO_VERSION_MAJOR;
+					res->version.minor = PROTO_VERSION_MINOR;
+
+					// PLD_SIZE is VLEN encoded, bigger pools are not used for a single frame
+					res->packetSize = programmer->memSize > PROTO_INT_VAL_MAX ? PROTO_INT_VAL_MAX : programmer->memSize;
+					res->windowSize = programmer->windowSize;
+					res->cmds       = PROGRAMMER_CMDS;
+					res->features   = PROGRAMMER_FEATURES;
+					res->checksums  = PROGRAMMER_CHECKSUMS;
+					res->spiClock   = programmer->spiClock;
+					res->ioWidths   = programmer->ioWidths;
+				}
+				break;
+
+			case PROTO_CMD_SPI_TRANSFER:
+				{
+					const ProtoReqTransfer *req = &request.request.transfer;
+					ProtoResTransfer       *res = &response.response.transfer;
+
+					if (req->flags & PROTO_SPI_TRANSFER_FLAG_TX_RLE) {
+						if (req->rxBufferSize == 0 && rle_getDecodedSize(req->txBuffer, req->txBufferSize) != RLE_ERROR) {
+							_spiTransmitRle(programmer, req->txBuffer, req->txBufferSize, req->flags);
 
 						} else {
-							res->rxBufferSize = request.request.transfer.rxBufferSize;
+							_sendError(programmer, packet, &response, PROTO_ERROR_INVALID_PAYLOAD);
 						}
+
+						// Response has no payload, the platform is not called again
+						proto_pkt_prepare(packet, programmer->mem, programmer->memSize, 0);
+
+						_sendPacket(programmer, packet);
+						return;
 					}
-					break;
 
-				default:
-					_sendError(programmer, &packet, &response, PROTO_ERROR_INVALID_CMD);
-					break;
-			}
+					if (req->flags & PROTO_SPI_TRANSFER_FLAG_RLE) {
+						if (res->rxBufferSize < req->txBufferSize + RLE_MAX_SIZE(req->rxBufferSize)) {
+							_sendError(programmer, packet, &response, PROTO_ERROR_INVALID_MESSAGE);
+							break;
+						}
 
-			if (packet.code != PROTO_NO_ERROR) {
+						// Response frame is sent after the transfer
+						_spiTransferRle(programmer, &request, packet);
+						return;
+					}
+
+					if (res->rxBufferSize < req->rxBufferSize) {
+						_sendError(programmer, packet, &response, PROTO_ERROR_INVALID_MESSAGE);
+
+					} else {
+						res->rxBufferSize = req->rxBufferSize;
+					}
+				}
 				break;
-			}
 
-			proto_pkt_prepare(&packet, programmer->mem, programmer->memSize, proto_res_getPayloadSize(&response));
+			case PROTO_CMD_FLASH_READ:
+				{
+					// Response frames are sent while reading
+					_flashRead(programmer, &request.request.flashRead, packet->id);
+				}
+				return;
+
+			case PROTO_CMD_FLASH_WRITE_PAGE:
+				{
+					const ProtoReqFlashWritePage *req = &request.request.flashWritePage;
+
+					if ((req->flags & PROTO_FLASH_WRITE_PAGE_FLAG_RLE) && rle_getDecodedSize(req->data, req->dataSize) == RLE_ERROR) {
+						_sendError(programmer, packet, &response, PROTO_ERROR_INVALID_PAYLOAD);
+						break;
+					}
+
+					// Page data is consumed before response is encoded over it
+					_flashWritePage(programmer, req, &response.response.flashWritePage);
+				}
+				break;
+
+			case PROTO_CMD_SPI_POLL:
+				{
+					const ProtoReqSpiPoll *req = &request.request.spiPoll;
+					ProtoResSpiPoll       *res = &response.response.spiPoll;
+
+					res->polls = _spiPoll(programmer, req->opcode, req->mask, req->value, req->pollLimit, &res->status);
+				}
+				break;
+
+			case PROTO_CMD_FLASH_CRC32:
+				{
+					// Request is already decoded, programmer memory is used as read buffer until response is encoded
+					response.response.flashCrc32.crc = _flashCrc32(programmer, &request.request.flashCrc32, programmer->mem, programmer->memSize);
+				}
+				break;
+
+			case PROTO_CMD_FLASH_COMPARE:
+				{
+					// Response frame is sent after comparison
+					_flashCompare(programmer, &request.request.flashCompare, packet->id);
+				}
+				return;
+
+			case PROTO_CMD_FLASH_BLANK_CHECK:
+				{
+					// The same as for CRC32
+					response.response.flashBlankCheck.offset = _flashBlankCheck(programmer, &request.request.flashBlankCheck, programmer->mem, programmer->memSize);
+				}
+				break;
+
+			case PROTO_CMD_SPI_BATCH:
+				{
+					// Response frame is sent after all sub-transfers
+					if (_spiBatch(programmer, &request.request.spiBatch, packet)) {
+						return;
+					}
+
+					_sendError(programmer, packet, &response, PROTO_ERROR_INVALID_PAYLOAD);
+				}
+				break;
+
+			case PROTO_CMD_SPI_CONFIG:
+				{
+					const ProtoReqSpiConfig *req = &request.request.spiConfig;
+					ProtoResSpiConfig       *res = &response.response.spiConfig;
+
+					if (req->mode > PROTO_SPI_MODE_MAX) {
+						_sendError(programmer, packet, &response, PROTO_ERROR_INVALID_PAYLOAD);
+						break;
+					}
+
+					// The platform applies clock and mode of the response and replaces them with the real ones
+					res->clock = req->clock;
+					res->mode  = req->mode;
+
+					if (res->clock == 0 || (programmer->spiClock != 0 && res->clock > programmer->spiClock)) {
+						res->clock = programmer->spiClock;
+					}
+				}
+				break;
+
+			case PROTO_CMD_SERIAL_BAUD:
+				{
+					// The platform sets the rate in the response if it is able to switch to it
+					response.response.serialBaud.baud = 0;
+				}
+				break;
+
+			default:
+				_sendError(programmer, packet, &response, PROTO_ERROR_INVALID_CMD);
+				break;
+		}
+
+		if (packet->code != PROTO_NO_ERROR) {
+			break;
+		}
+
+		{
+			uint16_t payloadSize = proto_res_getPayloadSize(&response);
 
-			proto_res_assign(&response, packet.payload, packet.payloadSize);
-			{
-				programmer->requestCallback(&request, &response, programmer->callbackData);
+			// Optional SPI clock and I/O widths of GET_INFO do not fit into frames of tiny pools
+			if (request.cmd == PROTO_CMD_GET_INFO && payloadSize > packet->payloadSize) {
+				payloadSize -= 4 + 1;
 			}
-			proto_res_encode(&response, packet.payload, packet.payloadSize);
 
-		} while (0);
+			proto_pkt_prepare(packet, programmer->mem, programmer->memSize, payloadSize);
+		}
 
-		programmer->responseCallback(
-			programmer->mem, proto_pkt_encode(&packet, programmer->mem, programmer->memSize), programmer->callbackData
-		);
+		proto_res_assign(&response, packet->payload, packet->payloadSize);
+		{
+			programmer->requestCallback(&request, &response, programmer->callbackData);
+		}
+		proto_res_encode(&response, packet->payload, packet->payloadSize);
+
+	} while (0);
+
+	_sendPacket(programmer, packet);
+}
+
+
+void programmer_putByte(Programmer *programmer, uint8_t byte) {
+	ProtoPkt packet;
+
+	uint8_t ret = proto_pkt_dec_putByte(&programmer->packetDeserializer, byte, &packet);
+
+	if (ret != PROTO_PKT_DES_RET_IDLE) {
+		_processPacket(programmer, &packet, ret);
+	}
+}
+
+
+void programmer_putBytes(Programmer *programmer, const uint8_t *bytes, uint16_t bytesSize) {
+	while (bytesSize > 0) {
+		ProtoPkt packet;
+		uint16_t consumed;
+
+		uint8_t ret = proto_pkt_dec_putBytes(&programmer->packetDeserializer, bytes, bytesSize, &consumed, &packet);
+
+		if (ret != PROTO_PKT_DES_RET_IDLE) {
+			_processPacket(programmer, &packet, ret);
+		}
+
+		bytes     += consumed;
+		bytesSize -= consumed;
 	}
 }
 
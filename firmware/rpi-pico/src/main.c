@@ -20,7 +20,11 @@
 
 #define CDC_CHANNEL 0
 
-#define PROGRAMMER_MEMORY_POOL_SIZE 384
+// Frames of several kilobytes keep per frame overhead low, RP2040 has plenty of RAM.
+#define PROGRAMMER_MEMORY_POOL_SIZE (16 * 1024)
+#define PROGRAMMER_WINDOW_SIZE        4
+
+#define PROGRAMMER_SPI_CLOCK (60 * 1000 * 1000)
 
 static uint8_t _programmerMemoryPool[PROGRAMMER_MEMORY_POOL_SIZE] = { 0 };
 static Programmer programmer;
@@ -38,8 +42,15 @@ static void _spiCsCallback(bool assert) {
 
 
 static void _programmerResponseCallback(uint8_t *buffer, uint16_t bufferSize, void *callbackData) {
-	for (uint16_t i = 0; i < bufferSize; i++) {
-		while (tud_cdc_n_write_char(CDC_CHANNEL, buffer[i]) == 0) {
+	while (bufferSize > 0) {
+		uint32_t written = tud_cdc_n_write(CDC_CHANNEL, buffer, bufferSize);
+
+		buffer     += written;
+		bufferSize -= written;
+
+		// FIFO is full, let the USB stack send it
+		if (bufferSize > 0) {
+			tud_cdc_n_write_flush(CDC_CHANNEL);
 			tud_task();
 		}
 	}
@@ -92,6 +103,21 @@ static void _programmerRequestCallback(ProtoReq *request, ProtoRes *response, vo
 			}
 			break;
 
+		case PROTO_CMD_SPI_CONFIG:
+			{
+				ProtoResSpiConfig *res = &response->response.spiConfig;
+
+				// spi_set_baudrate() returns the closest baudrate not exceeding the requested one
+				res->clock = spi_set_baudrate(spi_default, res->clock ? res->clock : PROGRAMMER_SPI_CLOCK);
+
+				spi_set_format(spi_default, 8,
+					(res->mode & PROTO_SPI_MODE_CPOL) ? SPI_CPOL_1 : SPI_CPOL_0,
+					(res->mode & PROTO_SPI_MODE_CPHA) ? SPI_CPHA_1 : SPI_CPHA_0,
+					SPI_MSB_FIRST
+				);
+			}
+			break;
+
 		default:
 			break;
 	}
@@ -104,9 +130,7 @@ static void _cdcTask(void) {
 
 		uint32_t count = tud_cdc_n_read(CDC_CHANNEL, buf, sizeof(buf));
 
-		for (uint32_t i = 0; i < count; i++) {
-			programmer_putByte(&programmer, buf[i]);
-		}
+		programmer_putBytes(&programmer, buf, count);
 	}
 }
 
@@ -115,7 +139,7 @@ int main() {
 	board_init();
 	tusb_init();
 
-	spi_init(spi_default, 60 * 1000 * 1000);
+	uint32_t spiClock = spi_init(spi_default, PROGRAMMER_SPI_CLOCK);
 
 	gpio_set_function(PICO_DEFAULT_SPI_RX_PIN , GPIO_FUNC_SPI);
 	gpio_set_function(PICO_DEFAULT_SPI_TX_PIN,  GPIO_FUNC_SPI);
@@ -134,6 +158,13 @@ int main() {
 		NULL
 	);
 
+	// USB CDC is flow controlled, pending requests are kept by the host until
+	// the device FIFO has free space.
+	programmer_setWindowSize(&programmer, PROGRAMMER_WINDOW_SIZE);
+
+	// spi_init() returns the real baudrate achievable with the peripheral clock
+	programmer_setSpiInfo(&programmer, spiClock, PROTO_IO_WIDTH_SINGLE);
+
 	while (1) {
 		tud_task();
 
@@ -34,14 +34,22 @@ namespace flashutil {
 				UNLOCK
 			};
 
+			enum class VerifyMode {
+				// Written data is read back and compared
+				READ,
+				// CRC-32 of written area is compared with CRC of input data
+				CRC
+			};
+
 			struct Parameters {
 				int index;
 
 				Mode      mode;
 				Operation operation;
 
-				bool omitRedundantWrites;
-				bool verify;
+				bool       omitRedundantWrites;
+				bool       verify;
+				VerifyMode verifyMode;
 
 				Flash        *flashInfo;
 				std::istream *inStream;
@@ -56,6 +64,7 @@ namespace flashutil {
 					this->operation           = Operation::NO_OPERATION;
 					this->omitRedundantWrites = false;
 					this->verify              = false;
+					this->verifyMode          = VerifyMode::READ;
 					this->inStream            = nullptr;
 					this->outStream           = nullptr;
 					this->flashInfo           = nullptr;
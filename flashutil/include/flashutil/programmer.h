@@ -33,13 +33,22 @@ class Programmer {
 
 		void writePage(uint32_t address, const std::vector<uint8_t> &page);
 		std::vector<uint8_t> read(uint32_t address, size_t size);
+		uint32_t crc32(uint32_t address, size_t size);
+		bool isErased(uint32_t address, size_t size);
+		std::vector<bool> comparePages(uint32_t address, const std::vector<uint8_t> &data, size_t pageSize);
 
 		const Flash &getFlashInfo() const;
+		const Spi::Capabilities &getCapabilities() const;
 
 		FlashStatus getFlashStatus();
 		FlashStatus setFlashStatus(const FlashStatus &status);
 
 	private:
+		bool supports(Spi::Capabilities::Operation op) const;
+
+		void calibrateClock();
+		std::vector<uint8_t> readCalibrationPattern();
+
 		void verifyFlashInfoAreaByAddress(uint32_t address, size_t size, size_t alignment);
 		void verifyFlashInfoBlockNo(int blockNo);
 		void verifyFlashInfoSectorNo(int sectorNo);
@@ -52,7 +61,7 @@ class Programmer {
 		void cmdGetInfo(std::vector<uint8_t> &id);
 		void cmdGetStatus(FlashStatus &status);
 		void cmdWriteStatus(const FlashStatus &status);
-		void cmdWriteEnable();
+		void cmdWriteEnable(Spi::Messages &msgs);
 		void cmdWritePage(uint32_t address, const std::vector<uint8_t> &page);
 		void cmdFlashReadBegin(uint32_t address);
 
@@ -0,0 +1,121 @@
+/*
+ * flashutil/ringBuffer.h
+ *
+ *  Created on: 17 paz 2026
+ *      Author: Jaroslaw Bielski (bielski.j@gmail.com)
+ */
+
+#ifndef FLASHUTIL_RINGBUFFER_H_
+#define FLASHUTIL_RINGBUFFER_H_
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+/*
+ * Lock-free byte FIFO for a single producer and a single consumer thread.
+ * Producer fills contiguous free area obtained by getWriteArea() directly
+ * (for example by asynchronous read) and publishes it by commit().
+ */
+class RingBuffer {
+	public:
+		// Capacity is rounded up to a power of two
+		RingBuffer(std::size_t capacity) : _head(0), _tail(0) {
+			std::size_t size = 1;
+
+			while (size < capacity) {
+				size <<= 1;
+			}
+
+			this->_buffer.resize(size);
+		}
+
+		std::size_t capacity() const {
+			return this->_buffer.size();
+		}
+
+		// Consumer side
+
+		std::size_t available() const {
+			return this->_head.load(std::memory_order_acquire) - this->_tail.load(std::memory_order_relaxed);
+		}
+
+		std::size_t read(uint8_t *buffer, std::size_t bufferSize) {
+			std::size_t tail = this->_tail.load(std::memory_order_relaxed);
+			std::size_t size = std::min(bufferSize, this->available());
+
+			for (std::size_t done = 0; done < size;) {
+				std::size_t offset = (tail + done) & this->mask();
+				std::size_t chunk  = std::min(size - done, this->capacity() - offset);
+
+				memcpy(buffer + done, this->_buffer.data() + offset, chunk);
+
+				done += chunk;
+			}
+
+			this->_tail.store(tail + size, std::memory_order_release);
+
+			return size;
+		}
+
+		void clear() {
+			this->_tail.store(this->_head.load(std::memory_order_acquire), std::memory_order_release);
+		}
+
+		// Producer side
+
+		std::size_t getFree() const {
+			return this->capacity() - (this->_head.load(std::memory_order_relaxed) - this->_tail.load(std::memory_order_acquire));
+		}
+
+		uint8_t *getWriteArea(std::size_t &size) {
+			std::size_t offset = this->_head.load(std::memory_order_relaxed) & this->mask();
+
+			size = std::min(this->getFree(), this->capacity() - offset);
+
+			return this->_buffer.data() + offset;
+		}
+
+		void commit(std::size_t size) {
+			this->_head.store(this->_head.load(std::memory_order_relaxed) + size, std::memory_order_release);
+		}
+
+		std::size_t write(const uint8_t *buffer, std::size_t bufferSize) {
+			std::size_t done = 0;
+
+			while (done < bufferSize) {
+				std::size_t size;
+				uint8_t    *area = this->getWriteArea(size);
+
+				if (size == 0) {
+					break;
+				}
+
+				size = std::min(size, bufferSize - done);
+
+				memcpy(area, buffer + done, size);
+
+				this->commit(size);
+
+				done += size;
+			}
+
+			return done;
+		}
+
+	private:
+		std::size_t mask() const {
+			return this->_buffer.size() - 1;
+		}
+
+	private:
+		std::vector<uint8_t> _buffer;
+
+		// Free running counters, head is written by the producer, tail by the consumer
+		std::atomic<std::size_t> _head;
+		std::atomic<std::size_t> _tail;
+};
+
+#endif /* FLASHUTIL_RINGBUFFER_H_ */
@@ -19,6 +19,30 @@ class Serial {
 	public:
 		virtual void write(void *buffer, std::size_t bufferSize, int timeoutMs) = 0;
 		virtual void read(void *buffer, std::size_t bufferSize, int timeoutMs)  = 0;
+
+		/*
+		 * Reads at least minSize bytes, bytes which are already available are
+		 * read too up to bufferSize. Returns number of read bytes.
+		 */
+		virtual std::size_t readSome(void *buffer, std::size_t minSize, std::size_t bufferSize, int timeoutMs) {
+			this->read(buffer, minSize, timeoutMs);
+
+			return minSize;
+		}
+
+		/*
+		 * Returns baud rate of the port or 0 if the port has no baud rate.
+		 */
+		virtual int getBaudRate() {
+			return 0;
+		}
+
+		/*
+		 * Waits until written data is sent and switches the port to the new
+		 * baud rate, received data which has not been read yet is dropped.
+		 */
+		virtual void setBaudRate(int baud) {
+		}
 };
 
 #endif /* FLASHUTIL_SERIAL_H_ */
@@ -0,0 +1,39 @@
+/*
+ * flashutil/serial/capture.h
+ *
+ *  Created on: 17 paz 2026
+ *      Author: Jaroslaw Bielski (bielski.j@gmail.com)
+ */
+
+#ifndef FLASHUTIL_SERIAL_CAPTURE_H_
+#define FLASHUTIL_SERIAL_CAPTURE_H_
+
+#include <memory>
+#include <ostream>
+
+#include "flashutil/serial.h"
+
+/*
+ * Passes all calls to the wrapped serial and records the traffic in
+ * SerialTrace format.
+ */
+class CaptureSerial : public Serial {
+	public:
+		CaptureSerial(Serial &serial, std::ostream &output);
+		~CaptureSerial();
+
+	public:
+		void write(void *buffer, std::size_t bufferSize, int timeoutMs) override;
+		void read(void *buffer, std::size_t bufferSize, int timeoutMs) override;
+		std::size_t readSome(void *buffer, std::size_t minSize, std::size_t bufferSize, int timeoutMs) override;
+
+		int  getBaudRate() override;
+		void setBaudRate(int baud) override;
+
+	private:
+		class Impl;
+
+		std::unique_ptr<Impl> self;
+};
+
+#endif /* FLASHUTIL_SERIAL_CAPTURE_H_ */
@@ -15,12 +15,26 @@
 
 class HwSerial : public Serial {
 	public:
-		HwSerial(const std::string &serialPath, int baud);
+		enum class IoMode {
+			// I/O operations are executed by the calling thread
+			SYNC,
+
+			// Dedicated I/O thread keeps a read outstanding into a ring buffer
+			// and sends queued writes, read() only waits for buffered data.
+			BACKGROUND
+		};
+
+	public:
+		HwSerial(const std::string &serialPath, int baud, IoMode ioMode = IoMode::SYNC);
 		~HwSerial();
 
 	public:
 		void write(void *buffer, std::size_t bufferSize, int timeoutMs) override;
 		void read(void *buffer, std::size_t bufferSize, int timeoutMs) override;
+		std::size_t readSome(void *buffer, std::size_t minSize, std::size_t bufferSize, int timeoutMs) override;
+
+		int  getBaudRate() override;
+		void setBaudRate(int baud) override;
 
 	private:
 		void _flush();
@@ -0,0 +1,48 @@
+/*
+ * flashutil/serial/replay.h
+ *
+ *  Created on: 17 paz 2026
+ *      Author: Jaroslaw Bielski (bielski.j@gmail.com)
+ */
+
+#ifndef FLASHUTIL_SERIAL_REPLAY_H_
+#define FLASHUTIL_SERIAL_REPLAY_H_
+
+#include <memory>
+#include <istream>
+
+#include "flashutil/serial.h"
+
+/*
+ * Plays back traffic recorded by CaptureSerial. Written data has to match the
+ * trace, otherwise an exception is thrown.
+ */
+class ReplaySerial : public Serial {
+	public:
+		enum class Timing {
+			// Received data is delayed after the last write as in the trace
+			ORIGINAL,
+
+			// Received data is available immediately
+			FAST
+		};
+
+	public:
+		ReplaySerial(std::istream &input, Timing timing = Timing::ORIGINAL);
+		~ReplaySerial();
+
+	public:
+		void write(void *buffer, std::size_t bufferSize, int timeoutMs) override;
+		void read(void *buffer, std::size_t bufferSize, int timeoutMs) override;
+		std::size_t readSome(void *buffer, std::size_t minSize, std::size_t bufferSize, int timeoutMs) override;
+
+		int  getBaudRate() override;
+		void setBaudRate(int baud) override;
+
+	private:
+		class Impl;
+
+		std::unique_ptr<Impl> self;
+};
+
+#endif /* FLASHUTIL_SERIAL_REPLAY_H_ */
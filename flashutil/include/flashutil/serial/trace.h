@@ -0,0 +1,66 @@
+/*
+ * flashutil/serial/trace.h
+ *
+ *  Created on: 17 paz 2026
+ *      Author: Jaroslaw Bielski (bielski.j@gmail.com)
+ */
+
+#ifndef FLASHUTIL_SERIAL_TRACE_H_
+#define FLASHUTIL_SERIAL_TRACE_H_
+
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <cstdint>
+
+/*
+ * Binary trace of serial traffic written by CaptureSerial and played back by
+ * ReplaySerial.
+ *
+ * Header:
+ *  [ 4B  ][    1B   ][    4B     ]
+ *  [ FLTR ][ VERSION ][ BAUD (LE) ]
+ *
+ * Record:
+ *  [  1B  ][     varint     ][ varint ][ SIZE ]
+ *  [ TYPE ][ TIME DELTA(us) ][  SIZE  ][ DATA ]
+ *
+ * Varints are little endian base 128, time delta is counted from the previous
+ * record (from the header for the first one).
+ */
+class SerialTrace {
+	public:
+		static constexpr uint8_t VERSION = 1;
+
+		enum class Type : uint8_t {
+			// Data written by the host, time of the write call
+			WRITE   = 1,
+
+			// Data returned to the host, time when it has been received
+			READ    = 2,
+
+			// Read has failed, no data
+			TIMEOUT = 3,
+
+			// Baud rate switch, DATA carries 4B little endian rate
+			BAUD    = 4
+		};
+
+		struct Record {
+			Type                 type;
+			uint64_t             timeUs;
+			std::vector<uint8_t> data;
+		};
+
+	public:
+		static void writeHeader(std::ostream &stream, int baud);
+		static void writeRecord(std::ostream &stream, Type type, uint64_t timeDeltaUs, const uint8_t *data, std::size_t dataSize);
+
+		// Throws on invalid header
+		static int  readHeader(std::istream &stream);
+
+		// Returns false at the end of the trace, time of the record is added to record.timeUs
+		static bool readRecord(std::istream &stream, Record &record);
+};
+
+#endif /* FLASHUTIL_SERIAL_TRACE_H_ */
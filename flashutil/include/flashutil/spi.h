@@ -10,6 +10,7 @@
 
 #include <set>
 #include <map>
+#include <string>
 #include <vector>
 #include <cinttypes>
 
@@ -104,13 +105,238 @@ class Spi {
 		class Config {
 			public:
 				Config() {
+					this->reset();
 				}
+
+				// SPI clock in Hz, 0 selects the maximal clock of the programmer
+				Config &clock(uint32_t clock) {
+					this->_clock = clock; return *this;
+				}
+
+				uint32_t clock() const {
+					return this->_clock;
+				}
+
+				// SPI mode 0 - 3
+				Config &mode(uint8_t mode) {
+					this->_mode = mode; return *this;
+				}
+
+				uint8_t mode() const {
+					return this->_mode;
+				}
+
+				Config &reset() {
+					this->_clock = 0;
+					this->_mode  = 0;
+
+					return *this;
+				}
+
+			private:
+				uint32_t _clock;
+				uint8_t  _mode;
 		};
 
+		/*
+		 * Features of the attached programmer. Defaults describe a device
+		 * which supports only plain transfers.
+		 */
 		class Capabilities {
+			public:
+				enum class Operation {
+					FLASH_READ,
+					FLASH_WRITE_PAGE,
+					POLL,
+					FLASH_CRC32,
+					FLASH_BLANK_CHECK,
+					FLASH_COMPARE,
+					BATCH,
+					CONFIG
+				};
+
+				enum IoWidth : uint8_t {
+					IO_WIDTH_SINGLE = 1 << 0,
+					IO_WIDTH_DUAL   = 1 << 1,
+					IO_WIDTH_QUAD   = 1 << 2
+				};
+
 			public:
 				Capabilities() {
+					this->reset();
+				}
+
+				// Maximal number of bytes carried by a single frame, 0 if not limited
+				Capabilities &frameSize(std::size_t size) {
+					this->_frameSize = size; return *this;
+				}
+
+				std::size_t frameSize() const {
+					return this->_frameSize;
+				}
+
+				// Number of requests which can be sent without waiting for responses
+				Capabilities &pipelineDepth(std::size_t depth) {
+					this->_pipelineDepth = depth; return *this;
+				}
+
+				std::size_t pipelineDepth() const {
+					return this->_pipelineDepth;
+				}
+
+				// SPI clock in Hz, 0 if unknown
+				Capabilities &maxClock(uint32_t clock) {
+					this->_maxClock = clock; return *this;
+				}
+
+				uint32_t maxClock() const {
+					return this->_maxClock;
+				}
+
+				// Bitmap of IoWidth
+				Capabilities &ioWidths(uint8_t widths) {
+					this->_ioWidths = widths; return *this;
+				}
+
+				uint8_t ioWidths() const {
+					return this->_ioWidths;
+				}
+
+				Capabilities &supports(Operation op, bool supported) {
+					if (supported) {
+						this->_operations |= (1u << (unsigned) op);
+					} else {
+						this->_operations &= ~(1u << (unsigned) op);
+					}
+
+					return *this;
+				}
+
+				bool supports(Operation op) const {
+					return (this->_operations & (1u << (unsigned) op)) != 0;
+				}
+
+				Capabilities &reset() {
+					this->_frameSize     = 0;
+					this->_pipelineDepth = 1;
+					this->_maxClock      = 0;
+					this->_ioWidths      = IO_WIDTH_SINGLE;
+					this->_operations    = 0;
+
+					return *this;
+				}
+
+			private:
+				std::size_t _frameSize;
+				std::size_t _pipelineDepth;
+				uint32_t    _maxClock;
+				uint8_t     _ioWidths;
+				uint32_t    _operations;
+		};
+
+		/*
+		 * Counters collected by the device during the session, times are in
+		 * microseconds.
+		 */
+		class Statistics {
+			public:
+				// Bucket 0 counts zero values, bucket N values from 2^(N-1) to 2^N - 1
+				class Histogram {
+					public:
+						static constexpr std::size_t BUCKETS = 32;
+
+						Histogram() {
+							this->reset();
+						}
+
+						void add(uint64_t value);
+
+						uint64_t count() const {
+							return this->_count;
+						}
+
+						uint64_t sum() const {
+							return this->_sum;
+						}
+
+						uint64_t min() const {
+							return this->_count ? this->_min : 0;
+						}
+
+						uint64_t max() const {
+							return this->_max;
+						}
+
+						uint64_t mean() const {
+							return this->_count ? this->_sum / this->_count : 0;
+						}
+
+						uint64_t bucket(std::size_t index) const {
+							return this->_buckets[index];
+						}
+
+						// Upper bound of the bucket containing given fraction (0 - 1) of values
+						uint64_t percentile(double fraction) const;
+
+						Histogram &reset();
+
+					private:
+						uint64_t _buckets[BUCKETS];
+						uint64_t _count;
+						uint64_t _sum;
+						uint64_t _min;
+						uint64_t _max;
+				};
+
+				struct Command {
+					Command() : framesSent(0), framesReceived(0), retries(0), errors(0), txPayload(0), txWire(0), rxPayload(0), rxWire(0) {
+					}
+
+					uint64_t framesSent;
+					uint64_t framesReceived;
+					uint64_t retries;
+					uint64_t errors;
+
+					// Payload bytes carried by frames (compressed if RLE is used) and bytes really transmitted, the difference is framing overhead
+					uint64_t txPayload;
+					uint64_t txWire;
+					uint64_t rxPayload;
+					uint64_t rxWire;
+
+					// Request submission to the last response frame
+					Histogram latency;
+				};
+
+			public:
+				Statistics() {
+					this->reset();
+				}
+
+				Command &command(const std::string &name) {
+					return this->_commands[name];
+				}
+
+				const std::map<std::string, Command> &commands() const {
+					return this->_commands;
 				}
+
+				Statistics &reset();
+
+			public:
+				// Time spent writing a single frame
+				Histogram write;
+
+				// Time spent waiting for response bytes
+				Histogram wait;
+
+				// Time spent decoding a single response frame
+				Histogram decode;
+
+				// Status register reads done by the programmer while waiting for WIP clearance
+				uint64_t statusPolls;
+
+			private:
+				std::map<std::string, Command> _commands;
 		};
 
 	public:
@@ -119,13 +345,68 @@ class Spi {
 		virtual void transfer(Messages &msgs) = 0;
 		virtual void chipSelect(bool select) = 0;
 
+		/*
+		 * Configuration is kept by the device and applied on attach. If the
+		 * programmer supports Capabilities::Operation::CONFIG, getConfig()
+		 * returns the clock really used.
+		 */
 		virtual Config getConfig() = 0;
 		virtual void   setConfig(const Config &config) = 0;
 
 		virtual const Capabilities &getCapabilities() const = 0;
+		virtual const Statistics   &getStatistics() const = 0;
 		virtual void attach() = 0;
 		virtual void detach() = 0;
 
+	public:
+		/*
+		 * Flash operations executed by the programmer on its own. Default
+		 * implementations return false, in that case the operation has to be
+		 * done using plain transfers.
+		 */
+		virtual bool flashRead(uint32_t address, uint8_t *buffer, std::size_t size) {
+			return false;
+		}
+
+		/*
+		 * Enables write, programs the page and waits until WIP flag is cleared.
+		 * Status register read at the end is stored in status.
+		 */
+		virtual bool flashWritePage(uint32_t address, const uint8_t *data, std::size_t size, uint8_t &status) {
+			return false;
+		}
+
+		/*
+		 * Sends opcode and reads status byte until (status & mask) == value or
+		 * timeout expires. Last read status byte is stored in status.
+		 */
+		virtual bool poll(uint8_t opcode, uint8_t mask, uint8_t value, int timeoutMs, uint8_t &status) {
+			return false;
+		}
+
+		/*
+		 * Calculates CRC-32 (common/crc32.h) of flash region.
+		 */
+		virtual bool flashCrc32(uint32_t address, std::size_t size, uint32_t &crc) {
+			return false;
+		}
+
+		/*
+		 * Looks for the first non erased (0xff) byte in flash region. Its offset
+		 * is stored in offset, or size if whole region is erased.
+		 */
+		virtual bool flashBlankCheck(uint32_t address, std::size_t size, std::size_t &offset) {
+			return false;
+		}
+
+		/*
+		 * Compares CRC-32 of consecutive pages starting at address with given
+		 * CRCs. Element of differs is set for every page with other content.
+		 */
+		virtual bool flashCompare(uint32_t address, std::size_t pageSize, const std::vector<uint32_t> &crcs, std::vector<bool> &differs) {
+			return false;
+		}
+
 	protected:
 		Spi() {}
 };
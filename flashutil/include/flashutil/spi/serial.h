@@ -26,9 +26,23 @@ class SerialSpi : public Spi {
 		void   setConfig(const Config &config) override;
 
 		const Capabilities &getCapabilities() const override;
+		const Statistics   &getStatistics() const override;
 		void attach() override;
 		void detach() override;
 
+		/*
+		 * Enables switching the serial link to the fastest rate up to baud
+		 * supported by the programmer on attach, 0 disables it.
+		 */
+		void setMaxBaudRate(int baud);
+
+		bool flashRead(uint32_t address, uint8_t *buffer, std::size_t size) override;
+		bool flashWritePage(uint32_t address, const uint8_t *data, std::size_t size, uint8_t &status) override;
+		bool poll(uint8_t opcode, uint8_t mask, uint8_t value, int timeoutMs, uint8_t &status) override;
+		bool flashCrc32(uint32_t address, std::size_t size, uint32_t &crc) override;
+		bool flashBlankCheck(uint32_t address, std::size_t size, std::size_t &offset) override;
+		bool flashCompare(uint32_t address, std::size_t pageSize, const std::vector<uint32_t> &crcs, std::vector<bool> &differs) override;
+
 	private:
 		class Impl;
 
@@ -3,6 +3,8 @@
 #include <map>
 #include <cstring>
 
+#include "common/crc32.h"
+
 #include "flashutil/exception.h"
 #include "flashutil/programmer.h"
 #include "flashutil/entryPoint.h"
@@ -10,36 +12,14 @@
 
 using namespace flashutil;
 
+// Programmers with bulk read pipeline frames within a single read call
+#define READ_BULK_CHUNK_SIZE (256 * 1024)
+
 
 using OperationHandler  = std::function<void(Programmer &programmer, const EntryPoint::Parameters &params)>;
 using OperationHandlers = std::map<EntryPoint::Operation, std::map<EntryPoint::Mode, OperationHandler>>;
 
 
-static bool isErased(Programmer &programmer, uint32_t startAddress, size_t size) {
-	bool ret = true;
-
-	{
-		size_t bufferSize = programmer.getFlashInfo().getSectorSize();
-
-		while (size > 0) {
-			size_t toRead = std::min(size, bufferSize);
-
-			auto buffer = programmer.read(startAddress, toRead);
-
-			if (! std::all_of(buffer.begin(), buffer.end(), [](uint8_t v) { return v == 0xff; })) {
-				ret = false;
-				break;
-			}
-
-			startAddress += toRead;
-			size         -= toRead;
-		}
-	}
-
-	return ret;
-}
-
-
 static OperationHandlers _getHandlers() {
 	OperationHandlers ret;
 
@@ -97,7 +77,7 @@ static OperationHandlers _getHandlers() {
 					if (params.omitRedundantWrites) {
 						INFO("Checking if flash area at %08x of size %u is already erased");
 
-						if (isErased(programmer, address, size)) {
+						if (programmer.isErased(address, size)) {
 							INFO("Flash area is already erased. Skipping erase operation.");
 
 							doErase = false;
@@ -113,7 +93,7 @@ static OperationHandlers _getHandlers() {
 					operand(programmer);
 
 					if (params.verify) {
-						if (! isErased(programmer, address, size)) {
+						if (! programmer.isErased(address, size)) {
 							ERROR("Flash erase operation failed! Flash is not erased!");
 
 							erased = false;
@@ -202,61 +182,104 @@ static OperationHandlers _getHandlers() {
 				if (doWrite) {
 					std::vector<uint8_t> page(flashInfo.getPageSize(), 0xff);
 
-					while (! params.inStream->eof() && size > 0) {
-						bool     pageWrite = true;
-						uint32_t pageIdx   = address / flashInfo.getPageSize();
+					bool     verifyCrc    = params.verify && params.verifyMode == EntryPoint::VerifyMode::CRC;
+					bool     failed       = false;
+					uint32_t startAddress = address;
+					size_t   written      = 0;
+					uint32_t crc          = CRC32_START;
+
+					// Input is processed in chunks of block size, so all redundant pages of the chunk are found by a single compare
+					size_t chunkSize = std::max(flashInfo.getBlockSize(), page.size());
+
+					while (! params.inStream->eof() && size > 0 && ! failed) {
+						std::vector<uint8_t> chunk(std::min(chunkSize, size));
+						std::vector<bool>    modified;
+						std::vector<bool>    dirty;
 
-						params.inStream->read((char *) page.data(), page.size());
+						params.inStream->read((char *) chunk.data(), chunk.size());
 
-						size_t readSize = params.inStream->gcount();
-						if (readSize == 0) {
+						chunk.resize(params.inStream->gcount());
+						if (chunk.empty()) {
 							continue;
 						}
 
 						if (params.omitRedundantWrites) {
-							auto readPage = programmer.read(address, readSize);
+							modified = programmer.comparePages(address, chunk, page.size());
 
-							if (std::equal(readPage.begin(), readPage.end(), page.begin())) {
-								INFO("The page already contains the expected data. Skipping writing");
+							// Pages to be written are checked to be erased by comparing the chunk with erased one
+							if (std::find(modified.begin(), modified.end(), true) != modified.end()) {
+								dirty = programmer.comparePages(address, std::vector<uint8_t>(chunk.size(), 0xff), page.size());
+							}
+						}
 
-								pageWrite = false;
+						for (size_t offset = 0; offset < chunk.size(); offset += page.size()) {
+							bool     pageWrite = true;
+							uint32_t pageIdx   = address / flashInfo.getPageSize();
+							size_t   readSize  = std::min(page.size(), chunk.size() - offset);
 
-							} else if (! std::all_of(readPage.begin(), readPage.end(), [](uint8_t v) { return v == 0xff; })) {
-								ERROR("The page is set to be written, but the flash page has not been yet erased. Skipping writing.");
+							std::copy(chunk.begin() + offset, chunk.begin() + offset + readSize, page.begin());
 
-								break;
-							}
-						}
+							if (params.omitRedundantWrites) {
+								if (! modified[offset / page.size()]) {
+									INFO("The page already contains the expected data. Skipping writing");
+
+									pageWrite = false;
 
-						if (pageWrite) {
-							if (readSize != page.size()) {
-								memset(page.data() + readSize, 0xff, page.size() - readSize);
+								} else if (dirty[offset / page.size()]) {
+									ERROR("The page is set to be written, but the flash page has not been yet erased. Skipping writing.");
+
+									failed = true;
+									break;
+								}
 							}
 
-							INFO("Writing page %u, in sector: %zd, in block %zd (addr %#08x).",
-								pageIdx,
-								(pageIdx * flashInfo.getPageSize()) / flashInfo.getSectorSize(),
-								(pageIdx * flashInfo.getPageSize()) / flashInfo.getBlockSize(),
-								address
-							);
+							if (pageWrite) {
+								if (readSize != page.size()) {
+									memset(page.data() + readSize, 0xff, page.size() - readSize);
+								}
 
-							programmer.writePage(address, page);
+								INFO("Writing page %u, in sector: %zd, in block %zd (addr %#08x).",
+									pageIdx,
+									(pageIdx * flashInfo.getPageSize()) / flashInfo.getSectorSize(),
+									(pageIdx * flashInfo.getPageSize()) / flashInfo.getBlockSize(),
+									address
+								);
 
-							if (params.verify) {
-								auto readPage = programmer.read(address, readSize);
+								programmer.writePage(address, page);
 
-								if (! std::equal(readPage.begin(), readPage.end(), page.begin())) {
-									ERROR("Verification of written page has failed! The page contains different data!");
+								if (params.verify && ! verifyCrc) {
+									auto readPage = programmer.read(address, readSize);
 
-									break;
+									if (! std::equal(readPage.begin(), readPage.end(), page.begin())) {
+										ERROR("Verification of written page has failed! The page contains different data!");
+
+										failed = true;
+										break;
+									}
 								}
+
+								INFO("The page has been successfully written");
 							}
 
-							INFO("The page has been successfully written");
+							if (verifyCrc) {
+								crc      = crc32_get(page.data(), readSize, crc);
+								written += readSize;
+							}
+
+							address += page.size();
+							size    -= page.size();
 						}
+					}
+
+					if (verifyCrc && written > 0) {
+						uint32_t flashCrc = programmer.crc32(startAddress, written);
+
+						if (flashCrc != crc) {
+							ERROR("Verification of written area has failed! CRC of flash data %08x differs from CRC of input data %08x!", flashCrc, crc);
 
-						address += page.size();
-						size    -= page.size();
+						} else {
+							INFO("Written area has been successfully verified (CRC %08x).", crc);
+						}
 					}
 				}
 			};
@@ -286,8 +309,14 @@ static OperationHandlers _getHandlers() {
 
 				INFO("Reading flash area of size %zd at %08x", size, address);
 
+				size_t chunkSize = flashInfo.getBlockSize();
+
+				if (programmer.getCapabilities().supports(Spi::Capabilities::Operation::FLASH_READ)) {
+					chunkSize = std::max<size_t>(chunkSize, READ_BULK_CHUNK_SIZE);
+				}
+
 				while (read != size) {
-					size_t toReadSize = std::min(flashInfo.getBlockSize(), size - read);
+					size_t toReadSize = std::min(chunkSize, size - read);
 
 					auto readBuffer = programmer.read(address, toReadSize);
 
@@ -13,6 +13,8 @@
 #include "flashutil/flash/builder.h"
 #include "flashutil/spi/serial.h"
 #include "flashutil/serial/hw.h"
+#include "flashutil/serial/capture.h"
+#include "flashutil/serial/replay.h"
 #include "flashutil/flash/registry.h"
 #include "flashutil/flash/registry/reader/json.h"
 
@@ -27,8 +29,12 @@ namespace po = boost::program_options;
 #define OPT_OUTPUT   "output"
 #define OPT_INPUT    "input"
 #define OPT_BAUD     "serial-baud"
+#define OPT_BAUD_MAX "serial-baud-max"
 #define OPT_REGISTRY "registry"
 
+#define OPT_SPI_CLOCK "spi-clock"
+#define OPT_SPI_MODE  "spi-mode"
+
 #define OPT_READ         "read"
 #define OPT_READ_BLOCK   "read-block"
 #define OPT_READ_SECTOR  "read-sector"
@@ -44,6 +50,11 @@ namespace po = boost::program_options;
 #define OPT_VERIFY       "verify"
 #define OPT_UNPROTECT    "unprotect"
 
+#define OPT_STATS        "stats"
+#define OPT_CAPTURE      "capture"
+#define OPT_REPLAY       "replay"
+#define OPT_REPLAY_FAST  "replay-fast"
+
 #define OPT_FLASH_DESC         "flash-geometry"
 #define OPT_OMIT_REDUNDANT_OPS "no-redudant-cycles"
 
@@ -57,12 +68,52 @@ static void _usage(const po::options_description &opts) {
 }
 
 
+static void _printHistogram(const char *name, const Spi::Statistics::Histogram &h) {
+	OUT("  %-18s count: %8" PRIu64 ", total: %10" PRIu64 " us, mean: %8" PRIu64 " us, p50: %8" PRIu64 " us, p99: %8" PRIu64 " us, max: %8" PRIu64 " us",
+		name, h.count(), h.sum(), h.mean(), h.percentile(0.5), h.percentile(0.99), h.max()
+	);
+}
+
+
+static void _printStatistics(const Spi::Statistics &statistics) {
+	OUT("Protocol statistics:");
+	OUT("  %-18s %8s %8s %7s %7s %12s %12s %12s %12s", "command", "sent", "received", "retries", "errors", "tx payload", "tx overhead", "rx payload", "rx overhead");
+
+	for (const auto &it : statistics.commands()) {
+		const Spi::Statistics::Command &c = it.second;
+
+		OUT("  %-18s %8" PRIu64 " %8" PRIu64 " %7" PRIu64 " %7" PRIu64 " %12" PRIu64 " %12" PRId64 " %12" PRIu64 " %12" PRId64,
+			it.first.c_str(), c.framesSent, c.framesReceived, c.retries, c.errors,
+			c.txPayload, (int64_t) (c.txWire - c.txPayload), c.rxPayload, (int64_t) (c.rxWire - c.rxPayload)
+		);
+	}
+
+	OUT("Latency:");
+	for (const auto &it : statistics.commands()) {
+		_printHistogram(it.first.c_str(), it.second.latency);
+	}
+
+	OUT("Host time:");
+	_printHistogram("write",  statistics.write);
+	_printHistogram("wait",   statistics.wait);
+	_printHistogram("decode", statistics.decode);
+
+	OUT("WIP status polls done by programmer: %" PRIu64, statistics.statusPolls);
+}
+
+
 int main(int argc, char *argv[]) {
 	int ret = RC_FAILURE;
 
 	do {
-		std::unique_ptr<Spi>    spi;
+		// Trace files outlive serial ports using them
+		std::ofstream captureFile;
+		std::ifstream replayFile;
+
+		std::unique_ptr<Serial> port;
 		std::unique_ptr<Serial> serial;
+		std::unique_ptr<Spi>    spi;
+		bool                    printStatistics = false;
 
 		try {
 			FlashRegistry                     flashRegistry;
@@ -74,6 +125,8 @@ int main(int argc, char *argv[]) {
 
 				std::string serialPath;
 				int         serialBaud = 500000;
+				int         serialBaudMax = 2000000;
+				Spi::Config spiConfig;
 
 				std::ifstream inFile;
 				std::ofstream outFile;
@@ -88,17 +141,24 @@ int main(int argc, char *argv[]) {
 					(OPT_READ        ",r",                                               "Read to output file")
 					(OPT_WRITE       ",w",                                               "Write input file")
 					(OPT_ERASE       ",e",                                               "Erase whole chip")
-					(OPT_VERIFY      ",V",                                               "Verify writing process")
+					(OPT_VERIFY      ",V", po::value<std::string>()->implicit_value("read"), "Verify writing process: 'read' - read back written data, 'crc' - compare CRC calculated by programmer")
 					(OPT_UNPROTECT   ",u",                                               "Unprotect the chip before doing any operation on it")
 					(OPT_FLASH_DESC  ",g", po::value<std::string>(),                     "Custom chip geometry in format <block_size>:<block_count>:<sector_size>:<sector_count>:<unprotect-mask-hex> (example: 65536:4:4096:64:8c)")
 					(OPT_REGISTRY    ",R", po::value<std::string>(),                     "Path to flash registry")
 					(OPT_BAUD,             po::value<int>(),                             "Serial port baudrate")
+					(OPT_BAUD_MAX,         po::value<int>(),                             "Maximal baudrate negotiated with the programmer (0 - keep initial baudrate)")
+					(OPT_SPI_CLOCK,        po::value<uint32_t>(),                        "SPI clock in Hz (calibrated by default if the programmer supports it)")
+					(OPT_SPI_MODE,         po::value<int>(),                             "SPI mode (0 - 3)")
 					(OPT_READ_BLOCK,       po::value<off_t>(),                           "Read block at index")
 					(OPT_READ_SECTOR,      po::value<off_t>(),                           "Read Sector at index")
 					(OPT_ERASE_BLOCK,      po::value<off_t>(),                           "Erase block at index")
 					(OPT_ERASE_SECTOR,     po::value<off_t>(),                           "Erase sector at index")
 					(OPT_WRITE_BLOCK,      po::value<off_t>(),                           "Write block from input file")
 					(OPT_WRITE_SECTOR,     po::value<off_t>(),                           "Write sector from input file")
+					(OPT_STATS,                                                          "Print protocol statistics at exit")
+					(OPT_CAPTURE,          po::value<std::string>(),                     "Record serial traffic to trace file")
+					(OPT_REPLAY,           po::value<std::string>(),                     "Play back trace file instead of using serial port")
+					(OPT_REPLAY_FAST,                                                    "Play back trace as fast as possible instead of original timing")
 					(OPT_OMIT_REDUNDANT_OPS,                                             "Prevent from redundant erase/write cycles");
 					;
 
@@ -110,11 +170,11 @@ int main(int argc, char *argv[]) {
 					_usage(opDesc);
 				}
 
-				if (! vm.count(OPT_SERIAL)) {
+				if (! vm.count(OPT_SERIAL) && ! vm.count(OPT_REPLAY)) {
 					OUT("Serial port was not provided!");
 					_usage(opDesc);
 
-				} else {
+				} else if (vm.count(OPT_SERIAL)) {
 					serialPath = vm[OPT_SERIAL].as<std::string>();
 				}
 
@@ -169,6 +229,26 @@ int main(int argc, char *argv[]) {
 					serialBaud = vm[OPT_BAUD].as<int>();
 				}
 
+				if (vm.count(OPT_BAUD_MAX)) {
+					serialBaudMax = vm[OPT_BAUD_MAX].as<int>();
+				}
+
+				if (vm.count(OPT_SPI_CLOCK)) {
+					spiConfig.clock(vm[OPT_SPI_CLOCK].as<uint32_t>());
+				}
+
+				if (vm.count(OPT_SPI_MODE)) {
+					int mode = vm[OPT_SPI_MODE].as<int>();
+
+					if (mode < 0 || mode > 3) {
+						OUT("Invalid SPI mode! (%d)", mode);
+
+						_usage(opDesc);
+					}
+
+					spiConfig.mode(mode);
+				}
+
 				if (vm.count(OPT_OUTPUT)) {
 					auto output = vm[OPT_OUTPUT].as<std::string>();
 					if (output == "-") {
@@ -239,6 +319,20 @@ int main(int argc, char *argv[]) {
 				}
 
 				if (vm.count(OPT_VERIFY)) {
+					auto mode = vm[OPT_VERIFY].as<std::string>();
+
+					if (mode == "read") {
+						params.verifyMode = flashutil::EntryPoint::VerifyMode::READ;
+
+					} else if (mode == "crc") {
+						params.verifyMode = flashutil::EntryPoint::VerifyMode::CRC;
+
+					} else {
+						OUT("Invalid verify mode! (%s)", mode.c_str());
+
+						_usage(opDesc);
+					}
+
 					params.verify = true;
 				}
 
@@ -404,14 +498,50 @@ int main(int argc, char *argv[]) {
 					}
 				}
 
-				if (serialPath.empty()) {
+				if (vm.count(OPT_REPLAY)) {
+					auto timing = vm.count(OPT_REPLAY_FAST) ? ReplaySerial::Timing::FAST : ReplaySerial::Timing::ORIGINAL;
+
+					replayFile.open(vm[OPT_REPLAY].as<std::string>(), std::ios::in | std::ios::binary);
+					if (! replayFile.is_open()) {
+						ERROR("Unable to open trace file! (%s)", vm[OPT_REPLAY].as<std::string>().c_str());
+						break;
+					}
+
+					port = std::make_unique<ReplaySerial>(replayFile, timing);
+
+				} else if (serialPath.empty()) {
 					_usage(opDesc);
 
 				} else {
-					serial = std::make_unique<HwSerial>(serialPath, serialBaud);
-					spi    = std::make_unique<SerialSpi>(*serial.get());
+					port = std::make_unique<HwSerial>(serialPath, serialBaud, HwSerial::IoMode::BACKGROUND);
 				}
 
+				if (vm.count(OPT_CAPTURE)) {
+					captureFile.open(vm[OPT_CAPTURE].as<std::string>(), std::ios::out | std::ios::trunc | std::ios::binary);
+					if (! captureFile.is_open()) {
+						ERROR("Unable to open trace file! (%s)", vm[OPT_CAPTURE].as<std::string>().c_str());
+						break;
+					}
+
+					serial = std::make_unique<CaptureSerial>(*port.get(), captureFile);
+
+				} else {
+					serial = std::move(port);
+				}
+
+				{
+					auto serialSpi = std::make_unique<SerialSpi>(*serial.get());
+
+					serialSpi->setMaxBaudRate(serialBaudMax);
+
+					spi = std::move(serialSpi);
+				}
+
+				// Applied when the programmer is attached
+				spi->setConfig(spiConfig);
+
+				printStatistics = vm.count(OPT_STATS) != 0;
+
 				flashutil::EntryPoint::call(*spi.get(), flashRegistry, flashGeometry, operations);
 			}
 
@@ -420,6 +550,10 @@ int main(int argc, char *argv[]) {
 		} catch (const std::exception &ex) {
 			OUT("!! ERROR !! Cought exception: '%s'", ex.what());
 		}
+
+		if (printStatistics && spi) {
+			_printStatistics(spi->getStatistics());
+		}
 	} while (0);
 
 	return ret;
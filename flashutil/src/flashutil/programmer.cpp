@@ -7,6 +7,9 @@
 #include <algorithm>
 #include <stdexcept>
 #include <cstring>
+#include <ctime>
+
+#include "common/crc32.h"
 
 #include "flashutil/programmer.h"
 #include "flashutil/exception.h"
@@ -20,6 +23,14 @@
 #define WRITE_BYTE_TIMEOUT_MS      100
 #define WRITE_PAGE_TIMEOUT_MS      200
 
+// crc32_get() accepts up to 64kB long buffers
+#define CRC32_READ_CHUNK_SIZE 0x8000
+
+// SPI clock calibration reads JEDEC ID and beginning of the flash at halved clocks
+#define CALIBRATION_MIN_CLOCK   1000000
+#define CALIBRATION_REGION_SIZE     256
+#define CALIBRATION_ROUNDS            2
+
 
 Programmer::Programmer(Spi &spiDev, const FlashRegistry *registry) : _spi(spiDev) {
 	this->_flashRegistry = registry;
@@ -40,6 +51,19 @@ void Programmer::begin(const Flash *defaultGeometry) {
 	this->_spi.attach();
 	this->_spiAttached = true;
 
+	{
+		const auto &caps = this->_spi.getCapabilities();
+
+		DEBUG("Programmer frame size: %zd, pipeline depth: %zd, SPI clock: %u Hz, I/O widths: %02x",
+			caps.frameSize(), caps.pipelineDepth(), caps.maxClock(), caps.ioWidths()
+		);
+
+		// Explicitly configured clock is used as is
+		if (caps.supports(Spi::Capabilities::Operation::CONFIG) && this->_spi.getConfig().clock() == 0) {
+			this->calibrateClock();
+		}
+	}
+
 	{
 		std::vector<uint8_t> id;
 
@@ -82,6 +106,11 @@ void Programmer::end() {
 }
 
 
+const Spi::Capabilities &Programmer::getCapabilities() const {
+	return this->_spi.getCapabilities();
+}
+
+
 const Flash &Programmer::getFlashInfo() const {
 	return this->_flashInfo;
 }
@@ -97,7 +126,6 @@ FlashStatus Programmer::getFlashStatus() {
 
 
 FlashStatus Programmer::setFlashStatus(const FlashStatus &status) {
-	this->cmdWriteEnable();
 	this->cmdWriteStatus(status);
 
 	return this->waitForWIPClearance(WRITE_STATUS_TIMEOUT_MS);
@@ -111,6 +139,85 @@ static void _verifyCommon(const Flash &info) {
 }
 
 
+/*
+ * Looks for the fastest SPI clock at which the flash reads back the same
+ * data as at the slowest one.
+ */
+void Programmer::calibrateClock() {
+	std::vector<uint32_t> clocks;
+
+	for (uint32_t clock = this->_spi.getCapabilities().maxClock(); clock >= CALIBRATION_MIN_CLOCK; clock /= 2) {
+		clocks.push_back(clock);
+	}
+
+	if (clocks.size() < 2) {
+		return;
+	}
+
+	{
+		Spi::Config config = this->_spi.getConfig();
+
+		std::vector<uint8_t> reference;
+
+		this->_spi.setConfig(config.clock(clocks.back()));
+
+		reference = this->readCalibrationPattern();
+
+		if (std::all_of(reference.begin(), reference.end(), [](uint8_t v) { return v == 0x00 || v == 0xff; })) {
+			DEBUG("Flash does not respond, SPI clock is not calibrated");
+			return;
+		}
+
+		for (auto clock : clocks) {
+			bool consistent = true;
+
+			this->_spi.setConfig(config.clock(clock));
+
+			for (int i = 0; i < CALIBRATION_ROUNDS && consistent; i++) {
+				consistent = (this->readCalibrationPattern() == reference);
+			}
+
+			if (consistent) {
+				INFO("SPI clock calibrated to %u Hz", this->_spi.getConfig().clock());
+				return;
+			}
+
+			DEBUG("Flash reads are inconsistent at SPI clock %u Hz", clock);
+		}
+
+		WARN("Flash reads are inconsistent at all SPI clocks!");
+	}
+}
+
+
+std::vector<uint8_t> Programmer::readCalibrationPattern() {
+	std::vector<uint8_t> ret;
+
+	this->cmdGetInfo(ret);
+	this->cmdFlashReadBegin(0);
+
+	{
+		Spi::Messages msgs;
+
+		msgs.add().recv()
+			.bytes(CALIBRATION_REGION_SIZE);
+
+		_spi.transfer(msgs);
+
+		auto &data = msgs.at(0).recv().data();
+
+		ret.insert(ret.end(), data.begin(), data.end());
+	}
+
+	return ret;
+}
+
+
+bool Programmer::supports(Spi::Capabilities::Operation op) const {
+	return this->_spi.getCapabilities().supports(op);
+}
+
+
 void Programmer::verifyFlashInfoAreaByAddress(uint32_t address, size_t size, size_t alignment) {
 	_verifyCommon(this->_flashInfo);
 
@@ -139,6 +246,20 @@ void Programmer::verifyFlashInfoSectorNo(int sectorNo) {
 FlashStatus Programmer::waitForWIPClearance(int timeoutMs) {
 	FlashStatus ret;
 
+	if (this->supports(Spi::Capabilities::Operation::POLL)) {
+		uint8_t status;
+
+		if (this->_spi.poll(0x05, 0x01, 0x00, timeoutMs, status)) { // RDSR until WIP is cleared
+			ret = FlashStatus(status);
+
+			if (ret.isWriteInProgress()) {
+				throw std::runtime_error("Waiting for WIP flag clearance has timed out!");
+			}
+
+			return ret;
+		}
+	}
+
 	ret.setBusy(true);
 
 	while (ret.isWriteInProgress() && (timeoutMs > 0)) {
@@ -175,7 +296,6 @@ void Programmer::eraseChip() {
 
 	_verifyCommon(this->_flashInfo);
 
-	this->cmdWriteEnable();
 	this->cmdEraseChip();
 
 	this->waitForWIPClearance(ERASE_CHIP_TIMEOUT_MS);
@@ -187,7 +307,6 @@ void Programmer::eraseBlockByAddress(uint32_t address) {
 
 	this->verifyFlashInfoAreaByAddress(address, this->_flashInfo.getBlockSize(), this->_flashInfo.getBlockSize());
 
-	this->cmdWriteEnable();
 	this->cmdEraseBlock(address);
 
 	this->waitForWIPClearance(ERASE_BLOCK_TIMEOUT_MS);
@@ -204,7 +323,6 @@ void Programmer::eraseSectorByAddress(uint32_t address) {
 
 	this->verifyFlashInfoAreaByAddress(address, this->_flashInfo.getSectorSize(), this->_flashInfo.getSectorSize());
 
-	this->cmdWriteEnable();
 	this->cmdEraseSector(address);
 
 	this->waitForWIPClearance(ERASE_SECTOR_TIMEOUT_MS);
@@ -221,7 +339,18 @@ void Programmer::writePage(uint32_t address, const std::vector<uint8_t> &page) {
 
 	this->verifyFlashInfoAreaByAddress(address, page.size(), this->_flashInfo.getPageSize());
 
-	this->cmdWriteEnable();
+	if (this->supports(Spi::Capabilities::Operation::FLASH_WRITE_PAGE)) {
+		uint8_t status;
+
+		if (this->_spi.flashWritePage(address, page.data(), page.size(), status)) {
+			if (FlashStatus(status).isWriteInProgress()) {
+				throw std::runtime_error("Waiting for WIP flag clearance has timed out!");
+			}
+
+			return;
+		}
+	}
+
 	this->cmdWritePage(address, page);
 
 	this->waitForWIPClearance(ERASE_SECTOR_TIMEOUT_MS);
@@ -233,6 +362,14 @@ std::vector<uint8_t> Programmer::read(uint32_t address, size_t size) {
 
 	TRACE("call, address %08x, size: %zd", address, size);
 
+	if (this->supports(Spi::Capabilities::Operation::FLASH_READ)) {
+		std::vector<uint8_t> ret(size);
+
+		if (this->_spi.flashRead(address, ret.data(), ret.size())) {
+			return ret;
+		}
+	}
+
 	this->cmdFlashReadBegin(address);
 
 	{
@@ -252,11 +389,130 @@ std::vector<uint8_t> Programmer::read(uint32_t address, size_t size) {
 }
 
 
+uint32_t Programmer::crc32(uint32_t address, size_t size) {
+	uint32_t ret = CRC32_START;
+
+	this->verifyFlashInfoAreaByAddress(address, size, 1);
+
+	TRACE("call, address %08x, size: %zd", address, size);
+
+	if (this->supports(Spi::Capabilities::Operation::FLASH_CRC32)) {
+		if (this->_spi.flashCrc32(address, size, ret)) {
+			return ret;
+		}
+	}
+
+	while (size > 0) {
+		size_t toRead = std::min(size, (size_t) CRC32_READ_CHUNK_SIZE);
+
+		{
+			auto buffer = this->read(address, toRead);
+
+			ret = crc32_get(buffer.data(), buffer.size(), ret);
+		}
+
+		address += toRead;
+		size    -= toRead;
+	}
+
+	return ret;
+}
+
+
+bool Programmer::isErased(uint32_t address, size_t size) {
+	this->verifyFlashInfoAreaByAddress(address, size, 1);
+
+	TRACE("call, address %08x, size: %zd", address, size);
+
+	if (this->supports(Spi::Capabilities::Operation::FLASH_BLANK_CHECK)) {
+		size_t offset;
+
+		if (this->_spi.flashBlankCheck(address, size, offset)) {
+			if (offset < size) {
+				DEBUG("Byte at %08x is not erased", (uint32_t)(address + offset));
+			}
+
+			return offset >= size;
+		}
+	}
+
+	// Bulk read keeps the programmer busy, so the area is checked in bigger
+	// chunks. Plain transfers are done per sector to stop at the first dirty one.
+	size_t chunkSize = this->supports(Spi::Capabilities::Operation::FLASH_READ) ? this->_flashInfo.getBlockSize() : this->_flashInfo.getSectorSize();
+
+	while (size > 0) {
+		size_t toRead = std::min(size, std::max<size_t>(chunkSize, 1));
+
+		auto buffer = this->read(address, toRead);
+
+		if (! std::all_of(buffer.begin(), buffer.end(), [](uint8_t v) { return v == 0xff; })) {
+			return false;
+		}
+
+		address += toRead;
+		size    -= toRead;
+	}
+
+	return true;
+}
+
+
+/*
+ * Returns a flag for every page (the last one may be incomplete) of data,
+ * the flag is set if flash page contains other data.
+ */
+std::vector<bool> Programmer::comparePages(uint32_t address, const std::vector<uint8_t> &data, size_t pageSize) {
+	std::vector<bool> ret;
+
+	size_t fullPages = data.size() / pageSize;
+	size_t tailSize  = data.size() % pageSize;
+
+	this->verifyFlashInfoAreaByAddress(address, data.size(), 1);
+
+	TRACE("call, address %08x, size: %zd, page size: %zd", address, data.size(), pageSize);
+
+	if (fullPages > 0 && this->supports(Spi::Capabilities::Operation::FLASH_COMPARE)) {
+		std::vector<uint32_t> crcs;
+
+		for (size_t i = 0; i < fullPages; i++) {
+			crcs.push_back(crc32_get(data.data() + i * pageSize, pageSize, CRC32_START));
+		}
+
+		if (this->_spi.flashCompare(address, pageSize, crcs, ret)) {
+			if (tailSize > 0) {
+				auto page = this->read(address + fullPages * pageSize, tailSize);
+
+				ret.push_back(! std::equal(page.begin(), page.end(), data.begin() + fullPages * pageSize));
+			}
+
+			return ret;
+		}
+	}
+
+	// Whole area is fetched by a single read, so it is pipelined by the programmer
+	{
+		auto flash = this->read(address, data.size());
+
+		ret.clear();
+
+		for (size_t offset = 0; offset < data.size(); offset += pageSize) {
+			size_t size = std::min(pageSize, data.size() - offset);
+
+			ret.push_back(! std::equal(flash.begin() + offset, flash.begin() + offset + size, data.begin() + offset));
+		}
+	}
+
+	return ret;
+}
+
+
 void Programmer::cmdEraseChip() {
 	Spi::Messages msgs;
 
 	TRACE(("call"));
 
+	this->cmdWriteEnable(msgs);
+
 	{
 		auto &msg = msgs.add();
 
@@ -273,6 +529,8 @@ void Programmer::cmdEraseBlock(uint32_t address) {
 
 	TRACE(("call"));
 
+	this->cmdWriteEnable(msgs);
+
 	{
 		auto &msg = msgs.add();
 
@@ -293,6 +551,8 @@ void Programmer::cmdEraseSector(uint32_t address) {
 
 	TRACE(("call"));
 
+	this->cmdWriteEnable(msgs);
+
 	{
 		auto &msg = msgs.add();
 
@@ -360,9 +620,11 @@ void Programmer::cmdGetStatus(FlashStatus &status) {
 }
 
 
-void Programmer::cmdWriteEnable() {
-	Spi::Messages msgs;
-
+/*
+ * Queues WREN in front of write command, so both are sent in a single transfer
+ * which programmers supporting SPI_BATCH execute in one round trip.
+ */
+void Programmer::cmdWriteEnable(Spi::Messages &msgs) {
 	TRACE(("call"));
 
 	{
@@ -371,8 +633,6 @@ void Programmer::cmdWriteEnable() {
 		msg.send()
 			.byte(0x06); // WREN
 	}
-
-	_spi.transfer(msgs);
 }
 
 
@@ -381,6 +641,8 @@ void Programmer::cmdWritePage(uint32_t address, const std::vector<uint8_t> &page
 
 	TRACE(("call"));
 
+	this->cmdWriteEnable(msgs);
+
 	{
 		auto &msg = msgs.add();
 
@@ -401,6 +663,8 @@ void Programmer::cmdWritePage(uint32_t address, const std::vector<uint8_t> &page
 void Programmer::cmdWriteStatus(const FlashStatus &status) {
 	Spi::Messages msgs;
 
+	this->cmdWriteEnable(msgs);
+
 	{
 		auto &msg = msgs.add();
 
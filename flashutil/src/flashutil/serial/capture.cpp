@@ -0,0 +1,92 @@
+#include <chrono>
+
+#include "flashutil/serial/capture.h"
+#include "flashutil/serial/trace.h"
+
+
+struct CaptureSerial::Impl {
+	Serial       &serial;
+	std::ostream &output;
+
+	std::chrono::steady_clock::time_point lastRecord;
+
+	Impl(Serial &serial, std::ostream &output) : serial(serial), output(output) {
+		this->lastRecord = std::chrono::steady_clock::now();
+
+		SerialTrace::writeHeader(this->output, this->serial.getBaudRate());
+	}
+
+	void record(SerialTrace::Type type, std::chrono::steady_clock::time_point time, const void *data, std::size_t dataSize) {
+		uint64_t deltaUs = 0;
+
+		if (time > this->lastRecord) {
+			deltaUs = std::chrono::duration_cast<std::chrono::microseconds>(time - this->lastRecord).count();
+
+			this->lastRecord = time;
+		}
+
+		SerialTrace::writeRecord(this->output, type, deltaUs, (const uint8_t *) data, dataSize);
+	}
+
+	std::size_t readSome(void *buffer, std::size_t minSize, std::size_t bufferSize, int timeoutMs) {
+		std::size_t ret;
+
+		try {
+			ret = this->serial.readSome(buffer, minSize, bufferSize, timeoutMs);
+
+		} catch (...) {
+			this->record(SerialTrace::Type::TIMEOUT, std::chrono::steady_clock::now(), nullptr, 0);
+
+			throw;
+		}
+
+		this->record(SerialTrace::Type::READ, std::chrono::steady_clock::now(), buffer, ret);
+
+		return ret;
+	}
+};
+
+
+CaptureSerial::CaptureSerial(Serial &serial, std::ostream &output) {
+	this->self.reset(new Impl(serial, output));
+}
+
+
+CaptureSerial::~CaptureSerial() {
+	self->output.flush();
+}
+
+
+void CaptureSerial::write(void *buffer, std::size_t bufferSize, int timeoutMs) {
+	auto time = std::chrono::steady_clock::now();
+
+	self->serial.write(buffer, bufferSize, timeoutMs);
+
+	self->record(SerialTrace::Type::WRITE, time, buffer, bufferSize);
+}
+
+
+void CaptureSerial::read(void *buffer, std::size_t bufferSize, int timeoutMs) {
+	self->readSome(buffer, bufferSize, bufferSize, timeoutMs);
+}
+
+
+std::size_t CaptureSerial::readSome(void *buffer, std::size_t minSize, std::size_t bufferSize, int timeoutMs) {
+	return self->readSome(buffer, minSize, bufferSize, timeoutMs);
+}
+
+
+int CaptureSerial::getBaudRate() {
+	return self->serial.getBaudRate();
+}
+
+
+void CaptureSerial::setBaudRate(int baud) {
+	uint8_t data[] = {
+		(uint8_t) baud, (uint8_t) (baud >> 8), (uint8_t) (baud >> 16), (uint8_t) (baud >> 24)
+	};
+
+	self->serial.setBaudRate(baud);
+
+	self->record(SerialTrace::Type::BAUD, std::chrono::steady_clock::now(), data, sizeof(data));
+}
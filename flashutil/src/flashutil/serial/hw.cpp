@@ -1,4 +1,12 @@
 #include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <deque>
+#include <vector>
+#include <chrono>
 
 #include <cstdio>
 #include <cstdlib>
@@ -9,11 +17,16 @@
 #include <boost/bind.hpp>
 
 #include "flashutil/serial/hw.h"
+#include "flashutil/ringBuffer.h"
 
 #include "flashutil/exception.h"
 #include "flashutil/debug.h"
 
 
+// Received data not read by the user yet, used in background I/O mode
+#define RX_RING_SIZE (64 * 1024)
+
+
 enum class Result {
 	IN_PROGRESS,
 	SUCCESS,
@@ -28,10 +41,13 @@ struct HwSerial::Impl {
 
 	boost::asio::deadline_timer timeoutTimer;
 	Result                      readResult;
+	size_t                      readSize;
 
 	void onCompleted(const boost::system::error_code &errorCode, const size_t bytesTransferred) {
 		TRACE("Read: %zd bytes (%s)", bytesTransferred, errorCode.message().c_str());
 
+		this->readSize = bytesTransferred;
+
 		if (errorCode) {
 			if (errorCode != boost::asio::error::operation_aborted) {
 				this->timeoutTimer.cancel();
@@ -54,14 +70,225 @@ struct HwSerial::Impl {
 		}
 	}
 
-	Impl(const std::string &serialPort) : service(), serial(service, serialPort), timeoutTimer(service) {
+	// Background I/O mode
+	IoMode                                         ioMode;
+	std::unique_ptr<boost::asio::io_service::work> work;
+	std::thread                                    ioThread;
+	std::atomic<bool>                              ioFailed;
+
+	RingBuffer              rxRing;
+	std::atomic<bool>       rxStalled;
+	std::mutex              rxMutex;
+	std::condition_variable rxCondition;
+
+	// Accessed by I/O thread only
+	std::deque<std::vector<uint8_t>> txQueue;
+	boost::asio::deadline_timer      txDrainTimer;
+
+	int baud;
+
+	Impl(const std::string &serialPort, IoMode mode) : service(), serial(service, serialPort), timeoutTimer(service), rxRing(RX_RING_SIZE), txDrainTimer(service) {
+		this->baud       = 0;
 		this->readResult = Result::SUCCESS;
+		this->readSize   = 0;
+		this->ioMode     = mode;
+		this->ioFailed   = false;
+		this->rxStalled  = false;
+	}
+
+	~Impl() {
+		this->stopBackgroundIo();
+	}
+
+	void startBackgroundIo() {
+		this->work.reset(new boost::asio::io_service::work(this->service));
+
+		this->service.post([this]() {
+			this->startRead();
+		});
+
+		this->ioThread = std::thread([this]() {
+			this->service.run();
+		});
+	}
+
+	void stopBackgroundIo() {
+		if (! this->ioThread.joinable()) {
+			return;
+		}
+
+		this->work.reset();
+
+		// Pending operations are aborted, the loop finishes when their handlers are called
+		this->service.post([this]() {
+			this->serial.cancel();
+		});
+
+		this->ioThread.join();
+	}
+
+	void startRead() {
+		std::size_t size;
+		uint8_t    *area = this->rxRing.getWriteArea(size);
+
+		if (size == 0) {
+			// The reader resumes receiving when it frees some space. Free space
+			// is checked again, the reader may have missed the flag.
+			this->rxStalled = true;
+
+			if (this->rxRing.getFree() == 0 || ! this->rxStalled.exchange(false)) {
+				return;
+			}
+
+			area = this->rxRing.getWriteArea(size);
+		}
+
+		this->serial.async_read_some(boost::asio::buffer(area, size), [this](const boost::system::error_code &errorCode, std::size_t bytesTransferred) {
+			if (errorCode) {
+				if (errorCode != boost::asio::error::operation_aborted) {
+					this->ioFailed = true;
+				}
+
+			} else {
+				this->rxRing.commit(bytesTransferred);
+			}
+
+			this->notifyReader();
+
+			if (! errorCode) {
+				this->startRead();
+			}
+		});
+	}
+
+	void startWrite() {
+		boost::asio::async_write(this->serial, boost::asio::buffer(this->txQueue.front()), [this](const boost::system::error_code &errorCode, std::size_t) {
+			if (errorCode) {
+				if (errorCode != boost::asio::error::operation_aborted) {
+					this->ioFailed = true;
+
+					this->notifyReader();
+				}
+
+				this->txQueue.clear();
+				return;
+			}
+
+			this->txQueue.pop_front();
+
+			if (! this->txQueue.empty()) {
+				this->startWrite();
+			}
+		});
+	}
+
+	/*
+	 * Waits until output queue is empty, then calls the callback. Executed
+	 * by I/O thread.
+	 */
+	void onTxDrained(std::function<void()> callback) {
+		if (this->txQueue.empty()) {
+			callback();
+			return;
+		}
+
+		this->txDrainTimer.expires_from_now(boost::posix_time::milliseconds(1));
+		this->txDrainTimer.async_wait([this, callback](const boost::system::error_code &) {
+			this->onTxDrained(callback);
+		});
+	}
+
+	void applyBaudRate(int baud) {
+#if defined(__unix__)
+		// Bytes queued in the driver are sent with the old rate
+		tcdrain(this->serial.lowest_layer().native_handle());
+#endif
+
+		this->serial.set_option(boost::asio::serial_port::baud_rate(baud));
+
+#if defined(__unix__)
+		tcflush(this->serial.lowest_layer().native_handle(), TCIFLUSH);
+#endif
+
+		this->baud = baud;
+	}
+
+	void notifyReader() {
+		// Reader checks the ring buffer under the lock, so the notification cannot be missed
+		{
+			std::lock_guard<std::mutex> lock(this->rxMutex);
+		}
+
+		this->rxCondition.notify_one();
+	}
+
+	void backgroundWrite(const void *buffer, std::size_t bufferSize) {
+		if (this->ioFailed) {
+			throw_Exception("Cannot write data to the output!");
+		}
+
+		{
+			auto data = std::make_shared<std::vector<uint8_t>>((const uint8_t *) buffer, (const uint8_t *) buffer + bufferSize);
+
+			this->service.post([this, data]() {
+				this->txQueue.push_back(std::move(*data));
+
+				if (this->txQueue.size() == 1) {
+					this->startWrite();
+				}
+			});
+		}
+	}
+
+	std::size_t backgroundRead(uint8_t *buffer, std::size_t minSize, std::size_t bufferSize, int timeoutMs) {
+		std::size_t ret      = 0;
+		auto        deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+		auto ready = [this]() {
+			return this->rxRing.available() > 0 || this->ioFailed;
+		};
+
+		while (true) {
+			ret += this->rxRing.read(buffer + ret, bufferSize - ret);
+
+			if (this->rxStalled.exchange(false)) {
+				this->service.post([this]() {
+					this->startRead();
+				});
+			}
+
+			if (ret >= minSize) {
+				break;
+			}
+
+			if (this->ioFailed) {
+				throw_Exception("Error occurred while reading data from serial port!");
+			}
+
+			{
+				std::unique_lock<std::mutex> lock(this->rxMutex);
+
+				if (timeoutMs == 0) {
+					this->rxCondition.wait(lock, ready);
+
+				} else if (! this->rxCondition.wait_until(lock, deadline, ready)) {
+					WARN("RESULT_TIMEOUT");
+
+					// Late response would be taken as the answer to the next request
+					this->rxRing.clear();
+
+					throw_Exception("Timeout occurred while waiting on data");
+				}
+			}
+		}
+
+		return ret;
 	}
 };
 
 
-HwSerial::HwSerial(const std::string &serialPath, int baud) {
-	this->self.reset(new Impl(serialPath));
+HwSerial::HwSerial(const std::string &serialPath, int baud, IoMode ioMode) {
+	this->self.reset(new Impl(serialPath, ioMode));
 
 	INFO("Device %s has been successfully opened!", serialPath.c_str());
 
@@ -73,6 +300,8 @@ HwSerial::HwSerial(const std::string &serialPath, int baud) {
 		s.set_option(boost::asio::serial_port::flow_control(boost::asio::serial_port::flow_control::none));
 		s.set_option(boost::asio::serial_port::parity(boost::asio::serial_port::parity::none));
 		s.set_option(boost::asio::serial_port::stop_bits(boost::asio::serial_port::stop_bits::one));
+
+		self->baud = baud;
 	}
 
 #if defined(__unix__)
@@ -100,6 +329,10 @@ HwSerial::HwSerial(const std::string &serialPath, int baud) {
 #endif
 
 	this->_flush();
+
+	if (ioMode == IoMode::BACKGROUND) {
+		self->startBackgroundIo();
+	}
 }
 
 
@@ -109,9 +342,56 @@ HwSerial::~HwSerial() {
 
 
 void HwSerial::write(void *buffer, std::size_t bufferSize, int timeoutMs) {
-	if (self->serial.write_some(boost::asio::buffer(buffer, bufferSize)) != bufferSize) {
-		throw_Exception("Cannot write data to the output!");
+	if (self->ioMode == IoMode::BACKGROUND) {
+		self->backgroundWrite(buffer, bufferSize);
+
+		return;
+	}
+
+	boost::system::error_code errorCode;
+
+	// Descriptor is non-blocking after the first asynchronous read, big frames may be written in parts
+	boost::asio::write(self->serial, boost::asio::buffer(buffer, bufferSize), errorCode);
+
+	if (errorCode) {
+		throw_Exception("Cannot write data to the output! " + errorCode.message());
+	}
+}
+
+
+int HwSerial::getBaudRate() {
+	return self->baud;
+}
+
+
+void HwSerial::setBaudRate(int baud) {
+	INFO("Switching serial port to %d baud", baud);
+
+	if (self->ioMode == IoMode::BACKGROUND) {
+		std::promise<void> applied;
+
+		self->service.post([this, baud, &applied]() {
+			self->onTxDrained([this, baud, &applied]() {
+				try {
+					self->applyBaudRate(baud);
+
+					applied.set_value();
+
+				} catch (...) {
+					applied.set_exception(std::current_exception());
+				}
+			});
+		});
+
+		applied.get_future().get();
+
+		// Data received with the old rate
+		self->rxRing.clear();
+
+		return;
 	}
+
+	self->applyBaudRate(baud);
 }
 
 
@@ -125,6 +405,15 @@ void HwSerial::_flush() {
 
 
 void HwSerial::read(void *buffer, std::size_t bufferSize, int timeoutMs) {
+	this->readSome(buffer, bufferSize, bufferSize, timeoutMs);
+}
+
+
+std::size_t HwSerial::readSome(void *buffer, std::size_t minSize, std::size_t bufferSize, int timeoutMs) {
+	if (self->ioMode == IoMode::BACKGROUND) {
+		return self->backgroundRead((uint8_t *) buffer, minSize, bufferSize, timeoutMs);
+	}
+
 	self->service.restart();
 
 	if (timeoutMs != 0) {
@@ -143,10 +432,13 @@ void HwSerial::read(void *buffer, std::size_t bufferSize, int timeoutMs) {
 	);
 
 	self->readResult = Result::IN_PROGRESS;
+	self->readSize   = 0;
 
+	// Completes as soon as minSize bytes are received, all available bytes fitting into the buffer are taken
 	boost::asio::async_read(
 		self->serial,
 		boost::asio::buffer(buffer, bufferSize),
+		boost::asio::transfer_at_least(minSize),
 		boost::bind(
 			&Impl::onCompleted,
 			self.get(),
@@ -190,4 +482,6 @@ void HwSerial::read(void *buffer, std::size_t bufferSize, int timeoutMs) {
 			}
 			break;
 	}
+
+	return self->readSize;
 }
@@ -0,0 +1,192 @@
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <algorithm>
+
+#include "flashutil/serial/replay.h"
+#include "flashutil/serial/trace.h"
+
+#include "flashutil/exception.h"
+#include "flashutil/debug.h"
+
+
+struct ReplaySerial::Impl {
+	std::istream &input;
+	Timing        timing;
+	int           baud;
+
+	SerialTrace::Record record;
+	bool                recordValid;
+
+	// Offset of the first byte of the current record not consumed yet
+	std::size_t recordOffset;
+
+	// Time of the last write in the trace and during the replay
+	uint64_t                              lastWriteUs;
+	std::chrono::steady_clock::time_point lastWrite;
+
+	Impl(std::istream &input, Timing timing) : input(input) {
+		this->timing       = timing;
+		this->baud         = SerialTrace::readHeader(this->input);
+		this->recordValid  = false;
+		this->recordOffset = 0;
+		this->lastWriteUs  = 0;
+		this->lastWrite    = std::chrono::steady_clock::now();
+
+		this->record.timeUs = 0;
+	}
+
+	/*
+	 * Returns record which has not been consumed yet, nullptr at the end of
+	 * the trace.
+	 */
+	SerialTrace::Record *current() {
+		if (this->recordValid && this->recordOffset == this->record.data.size()) {
+			this->recordValid = false;
+		}
+
+		if (! this->recordValid) {
+			do {
+				if (! SerialTrace::readRecord(this->input, this->record)) {
+					return nullptr;
+				}
+
+				// Empty chunks have no effect, failed reads and baud switches are kept
+			} while (this->record.data.empty() && this->record.type != SerialTrace::Type::TIMEOUT);
+
+			this->recordValid  = true;
+			this->recordOffset = 0;
+		}
+
+		return &this->record;
+	}
+
+	void consume(std::size_t size) {
+		this->recordOffset += size;
+
+		if (this->record.data.empty()) {
+			this->recordValid = false;
+		}
+	}
+
+	SerialTrace::Record &expect(SerialTrace::Type type, const char *operation) {
+		SerialTrace::Record *r = this->current();
+
+		if (r == nullptr) {
+			throw_Exception(std::string("Trace mismatch! Unexpected ") + operation + " at the end of the trace");
+		}
+
+		if (r->type != type) {
+			throw_Exception(std::string("Trace mismatch! Unexpected ") + operation + " at " + std::to_string(r->timeUs) + "us");
+		}
+
+		return *r;
+	}
+
+	// Waits until the record would have been received after the last write
+	void waitFor(const SerialTrace::Record &r) {
+		if (this->timing == Timing::ORIGINAL && r.timeUs > this->lastWriteUs) {
+			std::this_thread::sleep_until(this->lastWrite + std::chrono::microseconds(r.timeUs - this->lastWriteUs));
+		}
+	}
+
+	void write(const uint8_t *buffer, std::size_t bufferSize) {
+		auto now = std::chrono::steady_clock::now();
+
+		for (std::size_t done = 0; done < bufferSize;) {
+			SerialTrace::Record &r = this->expect(SerialTrace::Type::WRITE, "write");
+
+			std::size_t size = std::min(bufferSize - done, r.data.size() - this->recordOffset);
+
+			if (memcmp(buffer + done, r.data.data() + this->recordOffset, size) != 0) {
+				throw_Exception("Trace mismatch! Written data differs at " + std::to_string(r.timeUs) + "us");
+			}
+
+			if (this->recordOffset == 0) {
+				this->lastWriteUs = r.timeUs;
+				this->lastWrite   = now;
+			}
+
+			this->consume(size);
+
+			done += size;
+		}
+	}
+
+	std::size_t readSome(uint8_t *buffer, std::size_t minSize, std::size_t bufferSize) {
+		std::size_t done = 0;
+
+		// Bytes of following records are not available until minSize is reached
+		while (done < minSize || (done < bufferSize && this->recordValid && this->recordOffset < this->record.data.size())) {
+			SerialTrace::Record *current = this->current();
+
+			// Failed read is reproduced as timeout
+			if (current != nullptr && current->type == SerialTrace::Type::TIMEOUT) {
+				this->waitFor(*current);
+				this->consume(0);
+
+				throw_Exception("Timeout occurred while waiting on data");
+			}
+
+			SerialTrace::Record &r = this->expect(SerialTrace::Type::READ, "read");
+
+			std::size_t size = std::min(bufferSize - done, r.data.size() - this->recordOffset);
+
+			if (this->recordOffset == 0) {
+				this->waitFor(r);
+			}
+
+			memcpy(buffer + done, r.data.data() + this->recordOffset, size);
+
+			this->consume(size);
+
+			done += size;
+		}
+
+		return done;
+	}
+};
+
+
+ReplaySerial::ReplaySerial(std::istream &input, Timing timing) {
+	this->self.reset(new Impl(input, timing));
+}
+
+
+ReplaySerial::~ReplaySerial() {
+}
+
+
+void ReplaySerial::write(void *buffer, std::size_t bufferSize, int timeoutMs) {
+	self->write((const uint8_t *) buffer, bufferSize);
+}
+
+
+void ReplaySerial::read(void *buffer, std::size_t bufferSize, int timeoutMs) {
+	this->readSome(buffer, bufferSize, bufferSize, timeoutMs);
+}
+
+
+std::size_t ReplaySerial::readSome(void *buffer, std::size_t minSize, std::size_t bufferSize, int timeoutMs) {
+	return self->readSome((uint8_t *) buffer, minSize, bufferSize);
+}
+
+
+int ReplaySerial::getBaudRate() {
+	return self->baud;
+}
+
+
+void ReplaySerial::setBaudRate(int baud) {
+	SerialTrace::Record &r = self->expect(SerialTrace::Type::BAUD, "baud rate switch");
+
+	int traced = r.data.size() == 4 ? (r.data[0] | (r.data[1] << 8) | (r.data[2] << 16) | (r.data[3] << 24)) : 0;
+
+	if (traced != baud) {
+		throw_Exception("Trace mismatch! Baud rate " + std::to_string(baud) + " instead of " + std::to_string(traced));
+	}
+
+	self->consume(r.data.size());
+
+	self->baud = baud;
+}
@@ -0,0 +1,109 @@
+#include <cstring>
+
+#include "flashutil/serial/trace.h"
+#include "flashutil/exception.h"
+
+
+static const char MAGIC[4] = { 'F', 'L', 'T', 'R' };
+
+
+static void _writeVarint(std::ostream &stream, uint64_t value) {
+	do {
+		uint8_t byte = value & 0x7f;
+
+		value >>= 7;
+
+		if (value) {
+			byte |= 0x80;
+		}
+
+		stream.put(byte);
+	} while (value);
+}
+
+
+static bool _readVarint(std::istream &stream, uint64_t &value) {
+	value = 0;
+
+	for (unsigned shift = 0; shift < 64; shift += 7) {
+		int byte = stream.get();
+
+		if (byte == std::char_traits<char>::eof()) {
+			return false;
+		}
+
+		value |= (uint64_t) (byte & 0x7f) << shift;
+
+		if ((byte & 0x80) == 0) {
+			return true;
+		}
+	}
+
+	throw_Exception("Invalid trace record!");
+}
+
+
+void SerialTrace::writeHeader(std::ostream &stream, int baud) {
+	uint8_t header[] = {
+		VERSION, (uint8_t) baud, (uint8_t) (baud >> 8), (uint8_t) (baud >> 16), (uint8_t) (baud >> 24)
+	};
+
+	stream.write(MAGIC, sizeof(MAGIC));
+	stream.write((const char *) header, sizeof(header));
+}
+
+
+void SerialTrace::writeRecord(std::ostream &stream, Type type, uint64_t timeDeltaUs, const uint8_t *data, std::size_t dataSize) {
+	stream.put((char) type);
+
+	_writeVarint(stream, timeDeltaUs);
+	_writeVarint(stream, dataSize);
+
+	stream.write((const char *) data, dataSize);
+}
+
+
+int SerialTrace::readHeader(std::istream &stream) {
+	char    magic[sizeof(MAGIC)];
+	uint8_t header[5];
+
+	stream.read(magic, sizeof(magic));
+	stream.read((char *) header, sizeof(header));
+
+	if (! stream || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+		throw_Exception("Invalid trace header!");
+	}
+
+	if (header[0] != VERSION) {
+		throw_Exception("Unsupported trace version " + std::to_string(header[0]));
+	}
+
+	return header[1] | (header[2] << 8) | (header[3] << 16) | (header[4] << 24);
+}
+
+
+bool SerialTrace::readRecord(std::istream &stream, Record &record) {
+	int      type = stream.get();
+	uint64_t timeDeltaUs;
+	uint64_t size;
+
+	if (type == std::char_traits<char>::eof()) {
+		return false;
+	}
+
+	if (! _readVarint(stream, timeDeltaUs) || ! _readVarint(stream, size)) {
+		throw_Exception("Truncated trace record!");
+	}
+
+	record.type    = (Type) type;
+	record.timeUs += timeDeltaUs;
+	record.data.resize(size);
+
+	stream.read((char *) record.data.data(), size);
+
+	if ((uint64_t) stream.gcount() != size) {
+		throw_Exception("Truncated trace record!");
+	}
+
+	return true;
+}
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "flashutil/spi.h"
 
 
@@ -159,3 +161,62 @@ Spi::Message &Spi::Messages::at(std::size_t pos) {
 std::size_t Spi::Messages::count() const {
 	return this->_msgs.size();
 }
+
+
+void Spi::Statistics::Histogram::add(uint64_t value) {
+	std::size_t index = 0;
+
+	while (index < BUCKETS - 1 && (value >> index) != 0) {
+		index++;
+	}
+
+	this->_buckets[index]++;
+
+	this->_count++;
+	this->_sum += value;
+	this->_min  = std::min(this->_min, value);
+	this->_max  = std::max(this->_max, value);
+}
+
+
+uint64_t Spi::Statistics::Histogram::percentile(double fraction) const {
+	uint64_t limit = (uint64_t) (fraction * this->_count + 0.5);
+	uint64_t sum   = 0;
+
+	for (std::size_t i = 0; i < BUCKETS; i++) {
+		sum += this->_buckets[i];
+
+		if (sum >= limit && sum > 0) {
+			uint64_t upper = i == 0 ? 0 : (((uint64_t) 1 << i) - 1);
+
+			return std::min(upper, this->_max);
+		}
+	}
+
+	return this->_max;
+}
+
+
+Spi::Statistics::Histogram &Spi::Statistics::Histogram::reset() {
+	std::fill(this->_buckets, this->_buckets + BUCKETS, 0);
+
+	this->_count = 0;
+	this->_sum   = 0;
+	this->_min   = UINT64_MAX;
+	this->_max   = 0;
+
+	return *this;
+}
+
+
+Spi::Statistics &Spi::Statistics::reset() {
+	this->write.reset();
+	this->wait.reset();
+	this->decode.reset();
+
+	this->statusPolls = 0;
+
+	this->_commands.clear();
+
+	return *this;
+}
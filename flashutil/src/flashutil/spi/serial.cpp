@@ -1,7 +1,11 @@
 #include <cstring>
+#include <deque>
+#include <chrono>
+#include <algorithm>
 #include <functional>
 
 #include "common/crc8.h"
+#include "common/rle.h"
 #include "common/protocol.h"
 #include "common/protocol/packet.h"
 #include "common/protocol/request.h"
@@ -15,8 +19,35 @@
 
 #define TIMEOUT_MS 1000
 
+// Status reads done by the programmer before page program is reported as timed out.
+#define WRITE_PAGE_POLL_LIMIT 0xffff
+
+// Status reads done in a single SPI_POLL request, keeps its response well within TIMEOUT_MS.
+#define SPI_POLL_LIMIT 0x1000
+
+// Programmer reads whole region before answering, scanning 16MB chip takes a while.
+#define FLASH_SCAN_TIMEOUT_MS (5 * 60 * 1000)
+
 #define TRANSFER_DATA_BLOCK_SIZE ((size_t) 251)
 
+// Frame sizes up to which CRC8 and CRC16 checksums are strong enough, larger frames use wider checksum if supported.
+#define CHECKSUM_CRC8_FRAME_LIMIT  128
+#define CHECKSUM_CRC16_FRAME_LIMIT 4096
+
+// Retransmissions of a single request before the error is reported.
+#define RETRANSMIT_LIMIT 3
+
+// Silence on the link after which no more stale response bytes are expected.
+#define RETRANSMIT_QUIET_MS 20
+
+// Timeout of GET_INFO polling the programmer after a rate not working on the link.
+#define SERIAL_BAUD_FALLBACK_POLL_MS 100
+
+// Serial rates tried during baud upgrade, the fastest first.
+static const int SERIAL_BAUD_RATES[] = {
+	2000000, 1000000, 921600, 500000, 460800, 250000, 230400, 115200
+};
+
 
 struct SerialProxy : public Serial {
 	public:
@@ -31,61 +62,329 @@ struct SerialProxy : public Serial {
 			this->_serial.read(buffer, bufferSize, timeoutMs);
 		}
 
+		virtual std::size_t readSome(void *buffer, std::size_t minSize, std::size_t bufferSize, int timeoutMs) override {
+			return this->_serial.readSome(buffer, minSize, bufferSize, timeoutMs);
+		}
+
+		virtual int getBaudRate() override {
+			return this->_serial.getBaudRate();
+		}
+
+		virtual void setBaudRate(int baud) override {
+			this->_serial.setBaudRate(baud);
+		}
+
 	private:
 		Serial &_serial;
 };
 
 
+static const char *_getCmdName(uint8_t cmd) {
+	switch (cmd) {
+		case PROTO_CMD_GET_INFO:          return "GET_INFO";
+		case PROTO_CMD_SPI_TRANSFER:      return "SPI_TRANSFER";
+		case PROTO_CMD_FLASH_READ:        return "FLASH_READ";
+		case PROTO_CMD_FLASH_WRITE_PAGE:  return "FLASH_WRITE_PAGE";
+		case PROTO_CMD_SPI_POLL:          return "SPI_POLL";
+		case PROTO_CMD_FLASH_CRC32:       return "FLASH_CRC32";
+		case PROTO_CMD_FLASH_BLANK_CHECK: return "FLASH_BLANK_CHECK";
+		case PROTO_CMD_FLASH_COMPARE:     return "FLASH_COMPARE";
+		case PROTO_CMD_SPI_BATCH:         return "SPI_BATCH";
+		case PROTO_CMD_SPI_CONFIG:        return "SPI_CONFIG";
+		case PROTO_CMD_SERIAL_BAUD:       return "SERIAL_BAUD";
+		default:
+			return "UNKNOWN";
+	}
+}
+
+
+static const char *_getErrorName(uint8_t code) {
+	switch (code) {
+		case PROTO_ERROR_INVALID_CMD:     return "INVALID_CMD";
+		case PROTO_ERROR_INVALID_LENGTH:  return "INVALID_LENGTH";
+		case PROTO_ERROR_INVALID_CRC:     return "INVALID_CRC";
+		case PROTO_ERROR_INVALID_PAYLOAD: return "INVALID_PAYLOAD";
+		case PROTO_ERROR_INVALID_MESSAGE: return "INVALID_MESSAGE";
+		case PROTO_ERROR_DUPLICATE:       return "DUPLICATE";
+		case PROTO_ERROR_OUT_OF_SEQUENCE: return "OUT_OF_SEQUENCE";
+		default:
+			return "UNKNOWN";
+	}
+}
+
+
+/*
+ * NAKs of requests broken or lost on the link, the request succeeds if it is
+ * sent again. Other errors are reported by every execution of the request.
+ */
+static bool _isTransientError(uint8_t code) {
+	return code == PROTO_ERROR_INVALID_CRC || code == PROTO_ERROR_INVALID_LENGTH || code == PROTO_ERROR_OUT_OF_SEQUENCE;
+}
+
+
+/*
+ * Thrown when the response of a retransmitted request is lost and the
+ * programmer cannot repeat it (PROTO_ERROR_DUPLICATE), the whole CS
+ * transaction has to be sent again.
+ */
+class ResponseLostException : public Exception {
+	public:
+		using Exception::Exception;
+};
+
+
+static uint64_t _getElapsedUs(std::chrono::steady_clock::time_point since) {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+
+static void _decodeResponse(ProtoRes &response, uint8_t cmd, uint8_t *payload, uint16_t payloadSize) {
+	proto_res_init  (&response, payload, payloadSize, cmd);
+	proto_res_decode(&response, payload, payloadSize);
+	proto_res_assign(&response, payload, payloadSize);
+}
+
+
 struct SerialSpi::Impl {
+	struct PendingCmd {
+		uint8_t id;
+		uint8_t cmd;
+
+		std::function<void(const ProtoRes &)> responseDataCallback;
+		std::function<bool()>                 completedCallback;
+
+		std::chrono::steady_clock::time_point submitted;
+		Statistics::Command                  *statistics;
+
+		// Encoded request kept for retransmission, empty if the programmer does not support it
+		std::vector<uint8_t>                        frame;
+		std::function<void(ProtoReq &, ProtoRes &)> resumePrepareCallback;
+
+		// Retransmissions since the last received frame, late responses are expected once it was retransmitted
+		unsigned retries        = 0;
+		bool     retransmitted  = false;
+
+		// Response frames passed to responseDataCallback and frames to be ignored after retransmission
+		size_t   framesReceived = 0;
+		size_t   framesToSkip   = 0;
+
+		// Response received while an older request was being retransmitted
+		bool                 responseKept = false;
+		std::vector<uint8_t> keptPayload;
+	};
+
 	std::unique_ptr<Serial> serial;
 	Config                  config;
 	uint8_t                 id;
 	Capabilities            capabilities;
+	Statistics              statistics;
 
 	std::vector<uint8_t> packetBuffer;
+	std::vector<uint8_t> responseBuffer;
+
+	// Bytes received from the serial port which have not been decoded yet
+	std::vector<uint8_t> readBuffer;
+	size_t               readBegin;
+	size_t               readEnd;
+
+	// Decoder of response frames, shared by draining and receiving, so a frame may be finished by either of them
+	ProtoPktDes          decoder;
+
 	size_t               txSize;
 	size_t               rxSize;
 
-	Impl(Serial &serial) : packetBuffer(32) {
+	// Requests sent to the programmer which have not been answered yet.
+	std::deque<PendingCmd> pending;
+	size_t                 windowSize;
+	uint16_t               cmds;
+	uint8_t                features;
+	uint8_t                checksums;
+
+	// Checksum of full size frames, it limits payload of every request
+	uint8_t                checksum;
+
+	int                    maxBaudRate;
+
+	// Messages of CS transaction left open by previous transfers, sent again when it is restarted
+	std::vector<Message>   openTransaction;
+
+	Impl(Serial &serial) : packetBuffer(32), responseBuffer(32), readBuffer(32) {
 		this->serial.reset(new SerialProxy(serial));
 
+		this->maxBaudRate = 0;
+
 		this->init(true);
 	}
 
 	void init(bool attached) {
-		this->id = 0;
+		this->id         = 0;
+		this->windowSize = 1;
+		this->cmds       = PROTO_CMD_MASK(PROTO_CMD_GET_INFO) | PROTO_CMD_MASK(PROTO_CMD_SPI_TRANSFER);
+		this->features   = 0;
+		this->checksums  = PROTO_CHECKSUM_MASK(PROTO_CHECKSUM_CRC8);
+		this->checksum   = PROTO_CHECKSUM_CRC8;
+
+		this->capabilities.reset();
+
+		this->dropPending();
+	}
+
+	/*
+	 * Forgets requests waiting for responses together with received bytes
+	 * which have not been decoded yet.
+	 */
+	void dropPending() {
+		this->pending.clear();
+
+		this->readBegin = 0;
+		this->readEnd   = 0;
+
+		proto_pkt_dec_setup(&this->decoder, this->responseBuffer.data(), this->responseBuffer.size());
 	}
 
+	/*
+	 * Sends messages. If a response is lost beyond recovery, CS transactions
+	 * which are not finished are started again. Messages receiving data are
+	 * reads, so they can be repeated.
+	 */
 	void transfer(Messages &msgs) {
-		for (size_t i = 0; i < msgs.count(); i++) {
-			auto &msg = msgs.at(i);
+		// Responses are handled asynchronously, each message keeps its own receive offset.
+		std::vector<size_t> rxWritten(msgs.count(), 0);
+
+		std::vector<Message> previous = std::move(this->openTransaction);
+		std::vector<size_t>  previousWritten(previous.size(), 0);
+
+		this->openTransaction.clear();
+
+		// Messages before it belong to CS transactions which are already finished
+		size_t   finished = 0;
+		unsigned restarts = 0;
+
+		while (true) {
+			try {
+				if (restarts > 0 && finished == 0) {
+					for (size_t i = 0; i < previous.size(); i++) {
+						this->submitTransfer(previous.at(i), previousWritten[i], []() {});
+					}
+				}
 
+				for (size_t i = finished; i < msgs.count();) {
+					size_t batchSize = this->getBatchSize(msgs, i);
+
+					if (batchSize > 1) {
+						this->submitBatch(msgs, i, batchSize, [&msgs, &finished, i, batchSize]() {
+							for (size_t j = i + batchSize; j > i; j--) {
+								if (msgs.at(j - 1).flags().chipDeselect()) {
+									finished = j;
+									break;
+								}
+							}
+						});
+
+						i += batchSize;
+
+					} else {
+						this->submitTransfer(msgs.at(i), rxWritten[i], [&msgs, &finished, i]() {
+							if (msgs.at(i).flags().chipDeselect()) {
+								finished = i + 1;
+							}
+						});
+
+						i++;
+					}
+				}
+
+				this->flush(TIMEOUT_MS);
+
+				break;
+
+			} catch (const ResponseLostException &e) {
+				if (++restarts > RETRANSMIT_LIMIT) {
+					throw;
+				}
+
+				DEBUG("%s, repeating from message %zd", e.what(), finished);
+
+				// Interrupted transaction may keep CS selected
+				this->chipSelect(false);
+
+				std::fill(rxWritten.begin() + finished, rxWritten.end(), 0);
+				std::fill(previousWritten.begin(), previousWritten.end(), 0);
+			}
+		}
+
+		// Transaction may continue with the next transfer
+		size_t open = msgs.count();
+
+		while (open > 0 && ! msgs.at(open - 1).flags().chipDeselect()) {
+			open--;
+		}
+
+		if (open > 0) {
+			previous.clear();
+		}
+
+		for (size_t i = open; i < msgs.count(); i++) {
+			previous.push_back(msgs.at(i));
+		}
+
+		this->openTransaction = std::move(previous);
+	}
+
+
+	/*
+	 * Sends message using as many SPI_TRANSFER requests as needed,
+	 * completedCallback is called with the response of the last one.
+	 */
+	void submitTransfer(Message &msg, size_t &rxWritten, std::function<void()> completedCallback) {
+		{
 			size_t rxSize = msg.recv().getBytes();
 			size_t txSize = msg.send().getBytes();
 			size_t rxSkip = msg.recv().getSkips();
 
 			size_t txWritten = 0;
-			size_t rxWritten = 0;
 
 			DEBUG("rxSize: %zd, txSize: %zd, skipSize: %zd", rxSize, txSize, rxSkip);
 
 			while (rxSize > 0 || txSize > 0 || rxSkip > 0) {
-				executeCmd(
+				// Size of RX data if the response is RLE encoded, 0 otherwise
+				auto rleSize = std::make_shared<size_t>(0);
+				auto last    = std::make_shared<bool>(false);
+
+				// TX data of the request, RLE encoded if it is sent that way
+				std::vector<uint8_t> txEncoded;
+				size_t               txRaw;
+
+				submitCmd(
 					PROTO_CMD_SPI_TRANSFER,
 
-					[&rxSize, &txSize, &rxSkip, &msg](ProtoReq &request, ProtoRes &response) {
+					[this, &rxSize, &txSize, &rxSkip, &msg, &txWritten, &txEncoded, &txRaw, rleSize, last](ProtoReq &request, ProtoRes &response) {
 						ProtoReqTransfer &t = request.request.transfer;
 
 						t.txBufferSize = std::min((size_t) t.txBufferSize, txSize);
 						txSize -= t.txBufferSize;
+						txRaw   = t.txBufferSize;
 
 						if (txSize == 0) {
+							size_t rxLimit = response.response.transfer.rxBufferSize;
+
 							t.rxSkipSize = rxSkip;
 							rxSkip = 0;
 
-							t.rxBufferSize = std::min((size_t) response.response.transfer.rxBufferSize, rxSize);
+							// RX data is encoded only when it is not received together with further TX data
+							if ((this->features & PROTO_FEATURE_RLE) && rxLimit > t.txBufferSize) {
+								rxLimit = rle_getMaxDecodedSize(rxLimit - t.txBufferSize);
+							}
+
+							t.rxBufferSize = std::min(rxLimit, rxSize);
 							rxSize -= t.rxBufferSize;
 
+							if ((this->features & PROTO_FEATURE_RLE) && t.rxBufferSize > 0) {
+								t.flags |= PROTO_SPI_TRANSFER_FLAG_RLE;
+
+								*rleSize = t.rxBufferSize;
+							}
+
 						} else {
 							size_t remain = std::min(rxSkip, (size_t) t.txBufferSize);
 
@@ -100,6 +399,20 @@ struct SerialSpi::Impl {
 							}
 						}
 
+						// Data which is only sent can be RLE encoded
+						if ((this->features & PROTO_FEATURE_TX_RLE) && t.txBufferSize > 0 && t.rxBufferSize == 0 && t.rxSkipSize == 0) {
+							txEncoded.resize(RLE_MAX_SIZE(txRaw));
+							txEncoded.resize(rle_encode(txEncoded.data(), msg.send().data() + txWritten, txRaw));
+
+							if (txEncoded.size() < txRaw) {
+								t.flags        |= PROTO_SPI_TRANSFER_FLAG_TX_RLE;
+								t.txBufferSize  = txEncoded.size();
+
+							} else {
+								txEncoded.clear();
+							}
+						}
+
 						// Apply flags
 						if (! msg.flags().chipDeselect()) {
 							t.flags |= PROTO_SPI_TRANSFER_FLAG_KEEP_CS;
@@ -107,23 +420,44 @@ struct SerialSpi::Impl {
 
 						if (rxSize > 0 || txSize > 0 || rxSkip > 0) {
 							t.flags |= PROTO_SPI_TRANSFER_FLAG_KEEP_CS;
+
+						} else {
+							*last = true;
 						}
 					},
 
-					[&txWritten, &msg](ProtoReq &request) {
+					[&txWritten, &msg, &txEncoded, &txRaw](ProtoReq &request) {
 						ProtoReqTransfer &t = request.request.transfer;
 
-						memcpy(t.txBuffer, msg.send().data() + txWritten, t.txBufferSize);
+						if (! txEncoded.empty()) {
+							memcpy(t.txBuffer, txEncoded.data(), t.txBufferSize);
 
-						txWritten += t.txBufferSize;
+						} else {
+							memcpy(t.txBuffer, msg.send().data() + txWritten, t.txBufferSize);
+						}
+
+						txWritten += txRaw;
 					},
 
-					[&rxWritten, &msg](const ProtoRes &response) {
+					[&rxWritten, &msg, rleSize, last, completedCallback](const ProtoRes &response) {
 						const ProtoResTransfer &t = response.response.transfer;
 
-						std::copy(t.rxBuffer, t.rxBuffer + t.rxBufferSize, msg.recv().data().begin() + rxWritten);
+						if (*rleSize > 0) {
+							if (rle_decode(msg.recv().data().data() + rxWritten, *rleSize, t.rxBuffer, t.rxBufferSize) != (int32_t) *rleSize) {
+								throw_Exception("Protocol error! Invalid RLE encoded data!");
+							}
+
+							rxWritten += *rleSize;
+
+						} else {
+							std::copy(t.rxBuffer, t.rxBuffer + t.rxBufferSize, msg.recv().data().begin() + rxWritten);
+
+							rxWritten += t.rxBufferSize;
+						}
 
-						rxWritten += t.rxBufferSize;
+						if (*last) {
+							completedCallback();
+						}
 					},
 
 					TIMEOUT_MS
@@ -133,6 +467,138 @@ struct SerialSpi::Impl {
 	}
 
 
+	/*
+	 * Returns number of messages starting at first which fit into a single
+	 * SPI_BATCH request, 0 if the programmer does not support it.
+	 */
+	size_t getBatchSize(Messages &msgs, size_t first) {
+		size_t ret  = 0;
+		size_t size = 0;
+
+		ProtoPkt packet;
+
+		if ((this->cmds & PROTO_CMD_MASK(PROTO_CMD_SPI_BATCH)) == 0) {
+			return 0;
+		}
+
+		this->initPacket(packet, PROTO_CMD_SPI_BATCH, 0);
+
+		for (size_t i = first; i < msgs.count(); i++) {
+			auto &msg = msgs.at(i);
+
+			// Long messages are sent by SPI_TRANSFER requests split into chunks
+			if (msg.send().getBytes() > packet.payloadSize || msg.recv().getBytes() > packet.payloadSize || msg.recv().getSkips() > packet.payloadSize) {
+				break;
+			}
+
+			{
+				ProtoReq request = _getBatchTransfer(msg);
+
+				// Request and RX data have to fit into programmer memory together
+				size += proto_req_getPayloadSize(&request) + msg.recv().getBytes();
+			}
+
+			if (size > packet.payloadSize) {
+				break;
+			}
+
+			ret++;
+		}
+
+		return ret;
+	}
+
+	/*
+	 * Sends count messages starting at first in a single SPI_BATCH request,
+	 * completedCallback is called with its response.
+	 */
+	void submitBatch(Messages &msgs, size_t first, size_t count, std::function<void()> completedCallback) {
+		DEBUG("Batch of %zd messages", count);
+
+		submitCmd(
+			PROTO_CMD_SPI_BATCH,
+
+			[&msgs, first, count](ProtoReq &request, ProtoRes &response) {
+				uint16_t size = 0;
+
+				for (size_t i = first; i < first + count; i++) {
+					ProtoReq t = _getBatchTransfer(msgs.at(i));
+
+					size += proto_req_getPayloadSize(&t);
+				}
+
+				request.request.spiBatch.transfersSize = size;
+			},
+
+			[&msgs, first, count](ProtoReq &request) {
+				uint8_t *mem = request.request.spiBatch.transfers;
+
+				for (size_t i = first; i < first + count; i++) {
+					auto    &msg  = msgs.at(i);
+					ProtoReq t    = _getBatchTransfer(msg);
+					uint16_t size = proto_req_getPayloadSize(&t);
+
+					proto_req_assign(&t, mem, size);
+
+					if (t.request.transfer.txBufferSize) {
+						memcpy(t.request.transfer.txBuffer, msg.send().data(), t.request.transfer.txBufferSize);
+					}
+
+					mem += proto_req_encode(&t, mem, size);
+				}
+			},
+
+			[&msgs, first, count, completedCallback](const ProtoRes &response) {
+				const ProtoResSpiBatch &b  = response.response.spiBatch;
+				const uint8_t          *rx = b.rxBuffer;
+
+				size_t rxSize = 0;
+
+				for (size_t i = first; i < first + count; i++) {
+					rxSize += msgs.at(i).recv().getBytes();
+				}
+
+				if (b.rxBufferSize != rxSize) {
+					throw_Exception("Protocol error! Invalid size of batch response!");
+				}
+
+				for (size_t i = first; i < first + count; i++) {
+					auto &data = msgs.at(i).recv().data();
+
+					std::copy(rx, rx + data.size(), data.begin());
+
+					rx += data.size();
+				}
+
+				completedCallback();
+			},
+
+			TIMEOUT_MS
+		);
+	}
+
+	/*
+	 * Sub-transfer of SPI_BATCH request carrying whole message.
+	 */
+	static ProtoReq _getBatchTransfer(Message &msg) {
+		ProtoReq ret;
+
+		ret.cmd = PROTO_CMD_SPI_TRANSFER;
+
+		{
+			ProtoReqTransfer &t = ret.request.transfer;
+
+			t.txBuffer     = nullptr;
+			t.txBufferSize = msg.send().getBytes();
+			t.rxSkipSize   = msg.recv().getSkips();
+			t.rxBufferSize = msg.recv().getBytes();
+			t.flags        = msg.flags().chipDeselect() ? 0 : PROTO_SPI_TRANSFER_FLAG_KEEP_CS;
+		}
+
+		return ret;
+	}
+
+
 	void chipSelect(bool select) {
 		ProtoRes response;
 
@@ -146,6 +612,10 @@ struct SerialSpi::Impl {
 			t.txBufferSize = 0;
 
 		}, {}, {}, TIMEOUT_MS);
+
+		if (! select) {
+			this->openTransaction.clear();
+		}
 	}
 
 
@@ -155,123 +625,1043 @@ struct SerialSpi::Impl {
 
 
 	void setConfig(const Config &config) {
+		if (config.mode() > PROTO_SPI_MODE_MAX) {
+			throw_Exception("Invalid SPI mode " + std::to_string(config.mode()));
+		}
+
 		this->config = config;
+
+		if ((this->cmds & PROTO_CMD_MASK(PROTO_CMD_SPI_CONFIG)) == 0) {
+			return;
+		}
+
+		this->executeCmd(
+			PROTO_CMD_SPI_CONFIG,
+
+			[&config](ProtoReq &request, ProtoRes &response) {
+				ProtoReqSpiConfig &r = request.request.spiConfig;
+
+				r.clock = config.clock();
+				r.mode  = config.mode();
+			},
+
+			{},
+
+			[this](const ProtoRes &response) {
+				const ProtoResSpiConfig &r = response.response.spiConfig;
+
+				DEBUG("SPI clock: %u Hz, mode: %hhu", r.clock, r.mode);
+
+				this->config.clock(r.clock);
+				this->config.mode (r.mode);
+			},
+
+			TIMEOUT_MS
+		);
 	}
 
 	const Capabilities &getCapabilities() const {
 		return this->capabilities;
 	}
 
-	void executeCmd(
-		uint8_t cmd,
-		std::function<void(ProtoReq &, ProtoRes &)> requestPrepareCallback,
-		std::function<void(ProtoReq &)>             requestFillCallback,
-		std::function<void(const ProtoRes &)>       responseDataCallback,
-		int timeout
-	) {
-		uint8_t *packetBuffer     = this->packetBuffer.data();
-		uint16_t packetBufferSize = this->packetBuffer.size();
-		uint16_t packetBufferWritten;
-
-		ProtoPkt packet;
-		ProtoRes response;
+	const Statistics &getStatistics() const {
+		return this->statistics;
+	}
 
-		proto_pkt_init(&packet, packetBuffer, packetBufferSize, cmd, ++this->id);
+	bool flashRead(uint32_t address, uint8_t *buffer, size_t size) {
+		size_t received = 0;
 
-		{
-			ProtoReq request;
+		if ((this->cmds & PROTO_CMD_MASK(PROTO_CMD_FLASH_READ)) == 0) {
+			return false;
+		}
 
-			proto_req_init(&request,  packet.payload, packet.payloadSize, packet.code);
-			proto_res_init(&response, packet.payload, packet.payloadSize, packet.code);
+		this->submitCmd(
+			PROTO_CMD_FLASH_READ,
 
-			if (requestPrepareCallback) {
-				requestPrepareCallback(request, response);
-			}
+			[this, address, size](ProtoReq &request, ProtoRes &response) {
+				ProtoReqFlashRead &r = request.request.flashRead;
 
-			proto_pkt_prepare(&packet, packetBuffer, packetBufferSize, proto_req_getPayloadSize(&request));
+				r.address = address;
+				r.length  = size;
 
-			proto_req_assign(&request, packet.payload, packet.payloadSize);
-			{
-				if (requestFillCallback) {
-					requestFillCallback(request);
+				if (this->features & PROTO_FEATURE_RLE) {
+					r.flags |= PROTO_FLASH_READ_FLAG_RLE;
 				}
-			}
-			proto_req_encode(&request, packet.payload, packet.payloadSize);
-		}
+			},
 
-		packetBufferWritten = proto_pkt_encode(&packet, packetBuffer, packetBufferSize);
+			{},
 
-		HEX(DEBUG_LEVEL_TRACE, "Packet buffer", packetBuffer, packetBufferWritten);
+			[this, buffer, size, &received](const ProtoRes &response) {
+				const ProtoResFlashRead &r = response.response.flashRead;
 
-		this->serial->write(packetBuffer, packetBufferWritten, TIMEOUT_MS);
+				if (this->features & PROTO_FEATURE_RLE) {
+					// Frame never decodes to more than uint16_t
+					int32_t decoded = rle_decode(buffer + received, std::min<size_t>(size - received, UINT16_MAX), r.data, r.dataSize);
 
-		{
-			ProtoPktDes decoder;
+					if (decoded == RLE_ERROR) {
+						throw_Exception("Protocol error! Invalid RLE encoded data!");
+					}
 
-			proto_pkt_dec_setup(&decoder, packetBuffer, packetBufferSize);
+					received += decoded;
 
-			{
-				uint8_t decRet;
+				} else {
+					if (received + r.dataSize > size) {
+						throw_Exception("Protocol error! Programmer sent too much data!");
+					}
 
-				do {
-					uint8_t byte;
+					std::copy(r.data, r.data + r.dataSize, buffer + received);
 
-					this->serial->read(&byte, 1, TIMEOUT_MS);
+					received += r.dataSize;
+				}
+			},
 
-					decRet = proto_pkt_dec_putByte(&decoder, byte, &packet);
+			TIMEOUT_MS,
 
-					if (decRet != PROTO_PKT_DES_RET_IDLE) {
-						if (PROTO_PKT_DES_RET_GET_ERROR_CODE(decRet) != PROTO_NO_ERROR) {
-							throw_Exception("Protocol error! " + PROTO_PKT_DES_RET_GET_ERROR_CODE(decRet));
-						}
+			[size, &received]() {
+				return received >= size;
+			},
 
-						if (packet.id != this->id) {
-							throw_Exception("Protocol error! ID does not match!");
-						}
+			// Retransmitted request reads only data which has not been received yet
+			[this, address, size, &received](ProtoReq &request, ProtoRes &response) {
+				ProtoReqFlashRead &r = request.request.flashRead;
 
-						proto_res_init  (&response, packet.payload, packet.payloadSize, cmd);
-						proto_res_decode(&response, packet.payload, packet.payloadSize);
-						proto_res_assign(&response, packet.payload, packet.payloadSize);
+				r.address = address + received;
+				r.length  = size - received;
 
-						if (responseDataCallback) {
-							responseDataCallback(response);
-						}
-					}
-				} while (decRet == PROTO_PKT_DES_RET_IDLE);
+				if (this->features & PROTO_FEATURE_RLE) {
+					r.flags |= PROTO_FLASH_READ_FLAG_RLE;
+				}
 			}
-		}
+		);
+
+		this->flush(TIMEOUT_MS);
+
+		return true;
 	}
 
-	void attach() {
-		executeCmd(PROTO_CMD_GET_INFO, {}, {}, [this](const ProtoRes &response) {
-			DEBUG("version %hhu.%hhu, payload size: %hu", response.response.getInfo.version.major, response.response.getInfo.version.minor, response.response.getInfo.packetSize);
+	bool flashWritePage(uint32_t address, const uint8_t *data, size_t size, uint8_t &status) {
+		if ((this->cmds & PROTO_CMD_MASK(PROTO_CMD_FLASH_WRITE_PAGE)) == 0) {
+			return false;
+		}
 
-			this->packetBuffer = std::vector<uint8_t>(response.response.getInfo.packetSize);
-		}, TIMEOUT_MS);
+		std::vector<uint8_t> encoded;
+		uint8_t              flags = 0;
 
-		// Be sure CS pin is released.
-		this->chipSelect(false);
-	}
+		// Padded and erased pages are sent in a few bytes.
+		if (this->features & PROTO_FEATURE_TX_RLE) {
+			encoded.resize(RLE_MAX_SIZE(size));
+			encoded.resize(rle_encode(encoded.data(), data, size));
 
+			if (encoded.size() < size) {
+				data  = encoded.data();
+				size  = encoded.size();
+				flags = PROTO_FLASH_WRITE_PAGE_FLAG_RLE;
+			}
+		}
 
-	void detach() {
-		// Be sure CS pin is released.
-		this->chipSelect(false);
-	}
-};
+		// Whole page has to fit into single frame.
+		{
+			ProtoPkt packet;
+			ProtoReq request;
 
+			this->initPacket(packet, PROTO_CMD_FLASH_WRITE_PAGE, 0);
+			proto_req_init(&request, packet.payload, packet.payloadSize, packet.code);
 
-SerialSpi::SerialSpi(Serial &serial) {
-	this->self.reset(new SerialSpi::Impl(serial));
-}
+			if (request.request.flashWritePage.dataSize < size) {
+				return false;
+			}
+		}
 
+		this->executeCmd(
+			PROTO_CMD_FLASH_WRITE_PAGE,
 
-SerialSpi::~SerialSpi() {
+			[address, size, flags](ProtoReq &request, ProtoRes &response) {
+				ProtoReqFlashWritePage &w = request.request.flashWritePage;
 
-}
+				w.address   = address;
+				w.pollLimit = WRITE_PAGE_POLL_LIMIT;
+				w.flags     = flags;
+				w.dataSize  = size;
+			},
 
+			[data, size](ProtoReq &request) {
+				memcpy(request.request.flashWritePage.data, data, size);
+			},
 
-void SerialSpi::chipSelect(bool select) {
+			[this, &status](const ProtoRes &response) {
+				const ProtoResFlashWritePage &w = response.response.flashWritePage;
+
+				DEBUG("status: %02x, polls: %hu", w.status, w.polls);
+
+				this->statistics.statusPolls += w.polls;
+
+				status = w.status;
+			},
+
+			TIMEOUT_MS
+		);
+
+		return true;
+	}
+
+	bool poll(uint8_t opcode, uint8_t mask, uint8_t value, int timeoutMs, uint8_t &status) {
+		if ((this->cmds & PROTO_CMD_MASK(PROTO_CMD_SPI_POLL)) == 0) {
+			return false;
+		}
+
+		{
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+			do {
+				this->executeCmd(
+					PROTO_CMD_SPI_POLL,
+
+					[opcode, mask, value](ProtoReq &request, ProtoRes &response) {
+						ProtoReqSpiPoll &p = request.request.spiPoll;
+
+						p.opcode    = opcode;
+						p.mask      = mask;
+						p.value     = value;
+						p.pollLimit = SPI_POLL_LIMIT;
+					},
+
+					{},
+
+					[this, &status](const ProtoRes &response) {
+						const ProtoResSpiPoll &p = response.response.spiPoll;
+
+						DEBUG("status: %02x, polls: %hu", p.status, p.polls);
+
+						this->statistics.statusPolls += p.polls;
+
+						status = p.status;
+					},
+
+					TIMEOUT_MS
+				);
+			} while (((status & mask) != value) && (std::chrono::steady_clock::now() < deadline));
+		}
+
+		return true;
+	}
+
+	bool flashCrc32(uint32_t address, size_t size, uint32_t &crc) {
+		if ((this->cmds & PROTO_CMD_MASK(PROTO_CMD_FLASH_CRC32)) == 0) {
+			return false;
+		}
+
+		this->executeCmd(
+			PROTO_CMD_FLASH_CRC32,
+
+			[address, size](ProtoReq &request, ProtoRes &response) {
+				ProtoReqFlashCrc32 &r = request.request.flashCrc32;
+
+				r.address = address;
+				r.length  = size;
+			},
+
+			{},
+
+			[&crc](const ProtoRes &response) {
+				crc = response.response.flashCrc32.crc;
+			},
+
+			FLASH_SCAN_TIMEOUT_MS
+		);
+
+		return true;
+	}
+
+	bool flashBlankCheck(uint32_t address, size_t size, size_t &offset) {
+		if ((this->cmds & PROTO_CMD_MASK(PROTO_CMD_FLASH_BLANK_CHECK)) == 0) {
+			return false;
+		}
+
+		this->executeCmd(
+			PROTO_CMD_FLASH_BLANK_CHECK,
+
+			[address, size](ProtoReq &request, ProtoRes &response) {
+				ProtoReqFlashBlankCheck &r = request.request.flashBlankCheck;
+
+				r.address = address;
+				r.length  = size;
+			},
+
+			{},
+
+			[size, &offset](const ProtoRes &response) {
+				const ProtoResFlashBlankCheck &r = response.response.flashBlankCheck;
+
+				if (r.offset == PROTO_FLASH_BLANK) {
+					offset = size;
+
+				} else {
+					offset = r.offset;
+				}
+			},
+
+			FLASH_SCAN_TIMEOUT_MS
+		);
+
+		return true;
+	}
+
+	bool flashCompare(uint32_t address, size_t pageSize, const std::vector<uint32_t> &crcs, std::vector<bool> &differs) {
+		size_t maxPages;
+
+		if ((this->cmds & PROTO_CMD_MASK(PROTO_CMD_FLASH_COMPARE)) == 0) {
+			return false;
+		}
+
+		if (pageSize > UINT16_MAX) {
+			return false;
+		}
+
+		{
+			ProtoPkt packet;
+			ProtoReq request;
+
+			this->initPacket(packet, PROTO_CMD_FLASH_COMPARE, 0);
+			proto_req_init(&request, packet.payload, packet.payloadSize, packet.code);
+
+			maxPages = request.request.flashCompare.pageCount;
+
+			if (maxPages == 0) {
+				return false;
+			}
+		}
+
+		differs.assign(crcs.size(), false);
+
+		// Requests are pipelined, every one of them covers as many pages as fits into the frame.
+		for (size_t first = 0; first < crcs.size(); first += maxPages) {
+			size_t count = std::min(maxPages, crcs.size() - first);
+
+			this->submitCmd(
+				PROTO_CMD_FLASH_COMPARE,
+
+				[address, pageSize, first, count](ProtoReq &request, ProtoRes &response) {
+					ProtoReqFlashCompare &c = request.request.flashCompare;
+
+					c.address   = address + first * pageSize;
+					c.pageSize  = pageSize;
+					c.pageCount = count;
+				},
+
+				[&crcs, first, count](ProtoReq &request) {
+					ProtoReqFlashCompare &c = request.request.flashCompare;
+
+					for (size_t i = 0; i < count; i++) {
+						uint32_t crc = crcs[first + i];
+
+						c.crcs[4 * i + 0] = crc >> 24;
+						c.crcs[4 * i + 1] = crc >> 16;
+						c.crcs[4 * i + 2] = crc >>  8;
+						c.crcs[4 * i + 3] = crc >>  0;
+					}
+				},
+
+				[&differs, first, count](const ProtoRes &response) {
+					const ProtoResFlashCompare &c = response.response.flashCompare;
+
+					if (c.bitmapSize != (count + 7) / 8) {
+						throw_Exception("Protocol error! Invalid size of compare bitmap!");
+					}
+
+					for (size_t i = 0; i < count; i++) {
+						differs[first + i] = (c.bitmap[i / 8] & (1 << (i % 8))) != 0;
+					}
+				},
+
+				FLASH_SCAN_TIMEOUT_MS
+			);
+		}
+
+		this->flush(FLASH_SCAN_TIMEOUT_MS);
+
+		return true;
+	}
+
+	/*
+	 * Encodes and sends request without waiting for its response. If the
+	 * programmer's window is full, the oldest response is received first.
+	 *
+	 * Commands answered with more than one frame have to provide
+	 * completedCallback, which is called after every received frame. They
+	 * may provide resumePrepareCallback too, it prepares the request sent
+	 * instead of the original one on retransmission, so the frames which
+	 * were already received are not requested again.
+	 */
+	void submitCmd(
+		uint8_t cmd,
+		std::function<void(ProtoReq &, ProtoRes &)> requestPrepareCallback,
+		std::function<void(ProtoReq &)>             requestFillCallback,
+		std::function<void(const ProtoRes &)>       responseDataCallback,
+		int timeout,
+		std::function<bool()>                       completedCallback     = {},
+		std::function<void(ProtoReq &, ProtoRes &)> resumePrepareCallback = {}
+	) {
+		uint8_t *packetBuffer = this->packetBuffer.data();
+		uint16_t packetBufferWritten;
+
+		ProtoPkt packet;
+
+		while (this->pending.size() >= this->windowSize) {
+			this->receiveResponse(timeout);
+		}
+
+		packetBufferWritten = this->encodeRequest(packet, cmd, ++this->id, requestPrepareCallback, requestFillCallback);
+
+		{
+			Statistics::Command &cmdStatistics = this->statistics.command(_getCmdName(cmd));
+			auto                 submitted     = std::chrono::steady_clock::now();
+
+			this->serial->write(packetBuffer, packetBufferWritten, timeout);
+
+			this->statistics.write.add(_getElapsedUs(submitted));
+
+			cmdStatistics.framesSent++;
+			cmdStatistics.txPayload += packet.payloadSize;
+			cmdStatistics.txWire    += packetBufferWritten;
+
+			PendingCmd pendingCmd;
+
+			pendingCmd.id                   = this->id;
+			pendingCmd.cmd                  = cmd;
+			pendingCmd.responseDataCallback = responseDataCallback;
+			pendingCmd.completedCallback    = completedCallback;
+			pendingCmd.submitted            = submitted;
+			pendingCmd.statistics           = &cmdStatistics;
+
+			if (this->isRetransmittable(cmd)) {
+				pendingCmd.frame.assign(packetBuffer, packetBuffer + packetBufferWritten);
+				pendingCmd.resumePrepareCallback = resumePrepareCallback;
+			}
+
+			this->pending.push_back(std::move(pendingCmd));
+		}
+	}
+
+	/*
+	 * Encodes request frame into packetBuffer, returns its size.
+	 */
+	uint16_t encodeRequest(
+		ProtoPkt &packet,
+		uint8_t   cmd,
+		uint8_t   id,
+		std::function<void(ProtoReq &, ProtoRes &)> requestPrepareCallback,
+		std::function<void(ProtoReq &)>             requestFillCallback
+	) {
+		uint8_t *packetBuffer     = this->packetBuffer.data();
+		uint16_t packetBufferSize = this->packetBuffer.size();
+		uint16_t ret;
+
+		this->initPacket(packet, cmd, id);
+
+		{
+			ProtoReq request;
+			ProtoRes response = {};
+
+			proto_req_init(&request,  packet.payload, packet.payloadSize, packet.code);
+			proto_res_init(&response, packet.payload, packet.payloadSize, packet.code);
+
+			if (requestPrepareCallback) {
+				requestPrepareCallback(request, response);
+			}
+
+			proto_pkt_prepare(&packet, packetBuffer, packetBufferSize, proto_req_getPayloadSize(&request));
+
+			proto_req_assign(&request, packet.payload, packet.payloadSize);
+			{
+				if (requestFillCallback) {
+					requestFillCallback(request);
+				}
+			}
+			proto_req_encode(&request, packet.payload, packet.payloadSize);
+
+			// The programmer answers with checksum of the request, it has to be strong enough for both frames
+			packet.checksum = this->getChecksum(PROTO_FRAME_MIN_SIZE + std::max(packet.payloadSize, _getResponseLimit(request, response)));
+		}
+
+		ret = proto_pkt_encode(&packet, packetBuffer, packetBufferSize);
+
+		HEX(DEBUG_LEVEL_TRACE, "Packet buffer", packetBuffer, ret);
+
+		return ret;
+	}
+
+	/*
+	 * Narrowest supported checksum which is strong enough for frames of
+	 * frameSize bytes, the widest supported one for bigger frames.
+	 */
+	uint8_t getChecksum(size_t frameSize) const {
+		if (frameSize <= CHECKSUM_CRC8_FRAME_LIMIT) {
+			return PROTO_CHECKSUM_CRC8;
+		}
+
+		if (frameSize <= CHECKSUM_CRC16_FRAME_LIMIT && (this->checksums & PROTO_CHECKSUM_MASK(PROTO_CHECKSUM_CRC16))) {
+			return PROTO_CHECKSUM_CRC16;
+		}
+
+		if (this->checksums & PROTO_CHECKSUM_MASK(PROTO_CHECKSUM_CRC32)) {
+			return PROTO_CHECKSUM_CRC32;
+		}
+
+		if (this->checksums & PROTO_CHECKSUM_MASK(PROTO_CHECKSUM_CRC16)) {
+			return PROTO_CHECKSUM_CRC16;
+		}
+
+		return PROTO_CHECKSUM_CRC8;
+	}
+
+	/*
+	 * Largest payload the request may be answered with. Data received by
+	 * SPI_TRANSFER is known in advance, other responses carrying data may
+	 * fill whole frame.
+	 */
+	static uint16_t _getResponseLimit(const ProtoReq &request, ProtoRes &response) {
+		if (request.cmd == PROTO_CMD_SPI_TRANSFER) {
+			const ProtoReqTransfer &t = request.request.transfer;
+
+			if (t.flags & PROTO_SPI_TRANSFER_FLAG_RLE) {
+				return std::min<size_t>(RLE_MAX_SIZE(t.rxBufferSize), proto_res_getPayloadSize(&response));
+			}
+
+			return t.rxBufferSize;
+		}
+
+		return proto_res_getPayloadSize(&response);
+	}
+
+	/*
+	 * Initializes request frame in packetBuffer protected with checksum of
+	 * full size frames, encodeRequest may pick a narrower one.
+	 */
+	void initPacket(ProtoPkt &packet, uint8_t cmd, uint8_t id) {
+		proto_pkt_init       (&packet, this->packetBuffer.data(), this->packetBuffer.size(), cmd, id);
+		proto_pkt_setChecksum(&packet, this->packetBuffer.data(), this->packetBuffer.size(), this->checksum);
+	}
+
+	/*
+	 * Requests which may be sent again with their original ID. Link checks
+	 * done during baud rate switch are never repeated.
+	 */
+	bool isRetransmittable(uint8_t cmd) const {
+		return (this->features & PROTO_FEATURE_RETRANSMIT) && cmd != PROTO_CMD_GET_INFO && cmd != PROTO_CMD_SERIAL_BAUD;
+	}
+
+	/*
+	 * Recovers from lost or broken response of the oldest pending request.
+	 * Frames which are still on the way are drained, then pending requests
+	 * are sent again with their original IDs. The programmer answers the
+	 * already executed ones without executing them again (see
+	 * PROTO_FEATURE_RETRANSMIT). Draining is skipped after a NAK, frames
+	 * following it are decoded as usual. Returns false if the request cannot
+	 * be retransmitted.
+	 */
+	bool retransmit(PendingCmd &cmd, const char *reason, bool drain) {
+		if (cmd.frame.empty() || cmd.retries >= RETRANSMIT_LIMIT) {
+			return false;
+		}
+
+		DEBUG("%s, retransmitting %zd requests from %s (ID %hhu)", reason, this->pending.size(), _getCmdName(cmd.cmd), cmd.id);
+
+		if (drain) {
+			this->drain();
+		}
+
+		cmd.retries++;
+
+		for (auto &p : this->pending) {
+			if (p.responseKept) {
+				continue;
+			}
+
+			if (p.resumePrepareCallback && p.framesReceived > 0) {
+				ProtoPkt packet;
+				uint16_t written = this->encodeRequest(packet, p.cmd, p.id, p.resumePrepareCallback, {});
+
+				p.frame.assign(this->packetBuffer.data(), this->packetBuffer.data() + written);
+				p.framesToSkip = 0;
+
+			} else {
+				// Multi-frame response is sent from the beginning again
+				p.framesToSkip = p.framesReceived;
+			}
+
+			p.retransmitted = true;
+
+			this->serial->write(p.frame.data(), p.frame.size(), TIMEOUT_MS);
+
+			p.statistics->retries++;
+			p.statistics->framesSent++;
+			p.statistics->txWire += p.frame.size();
+		}
+
+		return true;
+	}
+
+	/*
+	 * Decodes frames until the link is quiet. Single-frame responses of
+	 * pending requests other than the oldest one are kept, so the requests
+	 * do not need to be retransmitted, other frames are discarded. Long
+	 * streams (FLASH_READ) are drained as long as their frames keep coming.
+	 */
+	void drain() {
+		ProtoPktDes &decoder = this->decoder;
+
+		// Bytes which do not form any frame are not drained forever
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TIMEOUT_MS);
+
+		while (true) {
+			ProtoPkt packet;
+			uint16_t consumed;
+			uint8_t  decRet;
+
+			if (this->readBegin == this->readEnd) {
+				this->readBegin = 0;
+				this->readEnd   = 0;
+
+				if (std::chrono::steady_clock::now() >= deadline) {
+					break;
+				}
+
+				try {
+					this->readEnd = this->serial->readSome(this->readBuffer.data(), 1, this->readBuffer.size(), RETRANSMIT_QUIET_MS);
+
+				} catch (...) {
+					// Link is quiet
+					break;
+				}
+			}
+
+			decRet = proto_pkt_dec_putBytes(
+				&decoder, this->readBuffer.data() + this->readBegin, std::min<size_t>(this->readEnd - this->readBegin, UINT16_MAX), &consumed, &packet
+			);
+
+			this->readBegin += consumed;
+
+			if (decRet == PROTO_PKT_DES_RET_IDLE) {
+				continue;
+			}
+
+			deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TIMEOUT_MS);
+
+			if (PROTO_PKT_DES_RET_GET_ERROR_CODE(decRet) != PROTO_NO_ERROR || packet.code != PROTO_NO_ERROR) {
+				continue;
+			}
+
+			for (size_t i = 1; i < this->pending.size(); i++) {
+				PendingCmd &p = this->pending[i];
+
+				if (p.id == packet.id && ! p.completedCallback && ! p.responseKept) {
+					DEBUG("Kept response, ID: %hhu", packet.id);
+
+					p.responseKept = true;
+					p.keptPayload.assign(packet.payload, packet.payload + packet.payloadSize);
+
+					p.statistics->framesReceived++;
+					p.statistics->rxPayload += packet.payloadSize;
+				}
+			}
+		}
+
+		// Rest of a frame interrupted by silence is lost
+		proto_pkt_dec_reset(&decoder);
+	}
+
+	/*
+	 * Passes decoded response to the callback of the request.
+	 */
+	void handleResponse(PendingCmd &cmd, const ProtoRes &response) {
+		try {
+			if (cmd.responseDataCallback) {
+				cmd.responseDataCallback(response);
+			}
+
+		} catch (...) {
+			this->dropPending();
+
+			throw;
+		}
+	}
+
+	/*
+	 * Checks if frame with given ID which does not belong to the oldest
+	 * pending request can be ignored. It is a late response to a request
+	 * which was retransmitted or has already been answered.
+	 */
+	bool isStale(const PendingCmd &cmd, uint8_t id) const {
+		uint8_t ahead = id - cmd.id;
+
+		if ((this->features & PROTO_FEATURE_RETRANSMIT) == 0) {
+			return false;
+		}
+
+		// Response of a later request means the oldest one's response is lost, unless it was already retransmitted
+		return ahead >= this->pending.size() || cmd.retransmitted;
+	}
+
+	/*
+	 * Receives response frame of the oldest pending request.
+	 */
+	void receiveResponse(int timeout) {
+		PendingCmd  &cmd     = this->pending.front();
+		ProtoPktDes &decoder = this->decoder;
+		ProtoPkt     packet;
+
+		if (cmd.responseKept) {
+			ProtoRes response;
+
+			_decodeResponse(response, cmd.cmd, cmd.keptPayload.data(), cmd.keptPayload.size());
+
+			this->handleResponse(cmd, response);
+
+			cmd.statistics->latency.add(_getElapsedUs(cmd.submitted));
+
+			this->pending.pop_front();
+			return;
+		}
+
+		// Bytes of the frame and time spent decoding them
+		uint64_t frameWire     = 0;
+		uint64_t frameDecodeUs = 0;
+
+		{
+			uint8_t decRet;
+
+			do {
+				uint16_t consumed;
+
+				// Everything available is read at once, bytes of following frames are kept for next responses
+				if (this->readBegin == this->readEnd) {
+					size_t minSize = std::min<size_t>(proto_pkt_dec_getPendingSize(&decoder), this->readBuffer.size());
+
+					this->readBegin = 0;
+					this->readEnd   = 0;
+
+					auto waitBegin = std::chrono::steady_clock::now();
+
+					try {
+						this->readEnd = this->serial->readSome(this->readBuffer.data(), minSize, this->readBuffer.size(), timeout);
+
+					} catch (const std::exception &e) {
+						cmd.statistics->errors++;
+
+						if (! this->retransmit(cmd, e.what(), true)) {
+							this->dropPending();
+
+							throw;
+						}
+
+						frameWire     = 0;
+						frameDecodeUs = 0;
+						decRet        = PROTO_PKT_DES_RET_IDLE;
+						continue;
+					}
+
+					this->statistics.wait.add(_getElapsedUs(waitBegin));
+				}
+
+				auto decodeBegin = std::chrono::steady_clock::now();
+
+				decRet = proto_pkt_dec_putBytes(
+					&decoder, this->readBuffer.data() + this->readBegin, std::min<size_t>(this->readEnd - this->readBegin, UINT16_MAX), &consumed, &packet
+				);
+
+				frameDecodeUs += _getElapsedUs(decodeBegin);
+
+				this->readBegin += consumed;
+				frameWire       += consumed;
+
+				if (decRet != PROTO_PKT_DES_RET_IDLE) {
+					std::string error;
+					bool        nak = false;
+
+					if (PROTO_PKT_DES_RET_GET_ERROR_CODE(decRet) != PROTO_NO_ERROR) {
+						error = "Protocol error! " + std::to_string(PROTO_PKT_DES_RET_GET_ERROR_CODE(decRet));
+
+					} else if (_isTransientError(packet.code)) {
+						// NAKs of requests following the broken one, they are already retransmitted
+						if (packet.id != cmd.id && cmd.retransmitted) {
+							DEBUG("Ignored NAK %s, ID: %hhu", _getErrorName(packet.code), packet.id);
+
+							frameWire = 0;
+							decRet    = PROTO_PKT_DES_RET_IDLE;
+							continue;
+						}
+
+						// ID of a broken request may be damaged, the oldest one is retransmitted anyway
+						error = std::string("Programmer error! ") + _getErrorName(packet.code);
+						nak   = true;
+
+					} else if (packet.id != cmd.id) {
+						if (this->isStale(cmd, packet.id)) {
+							DEBUG("Ignored stale response, ID: %hhu", packet.id);
+
+							frameWire = 0;
+							decRet    = PROTO_PKT_DES_RET_IDLE;
+							continue;
+						}
+
+						error = "Protocol error! ID does not match!";
+
+					} else if (packet.code == PROTO_ERROR_DUPLICATE) {
+						cmd.statistics->errors++;
+
+						this->dropPending();
+
+						throw ResponseLostException(__FILE__, __LINE__, "Protocol error! Response of retransmitted request is lost!");
+
+					} else if (packet.code != PROTO_NO_ERROR) {
+						cmd.statistics->errors++;
+
+						this->dropPending();
+
+						throw_Exception(std::string("Programmer error! ") + _getErrorName(packet.code));
+					}
+
+					if (! error.empty()) {
+						cmd.statistics->errors++;
+
+						if (! this->retransmit(cmd, error.c_str(), ! nak)) {
+							this->dropPending();
+
+							throw_Exception(error);
+						}
+
+						frameWire     = 0;
+						frameDecodeUs = 0;
+						decRet        = PROTO_PKT_DES_RET_IDLE;
+						continue;
+					}
+
+					// Frames which were already received before retransmission
+					if (cmd.framesToSkip > 0) {
+						cmd.framesToSkip--;
+
+						frameWire = 0;
+						decRet    = PROTO_PKT_DES_RET_IDLE;
+						continue;
+					}
+
+					cmd.framesReceived++;
+					cmd.retries = 0;
+					cmd.statistics->framesReceived++;
+					cmd.statistics->rxPayload += packet.payloadSize;
+					cmd.statistics->rxWire    += frameWire;
+
+					{
+						ProtoRes response;
+
+						decodeBegin = std::chrono::steady_clock::now();
+
+						_decodeResponse(response, cmd.cmd, packet.payload, packet.payloadSize);
+
+						this->statistics.decode.add(frameDecodeUs + _getElapsedUs(decodeBegin));
+
+						this->handleResponse(cmd, response);
+					}
+				}
+			} while (decRet == PROTO_PKT_DES_RET_IDLE);
+		}
+
+		if (! cmd.completedCallback || cmd.completedCallback()) {
+			cmd.statistics->latency.add(_getElapsedUs(cmd.submitted));
+
+			this->pending.pop_front();
+		}
+	}
+
+	/*
+	 * Waits for responses to all pending requests.
+	 */
+	void flush(int timeout) {
+		while (! this->pending.empty()) {
+			this->receiveResponse(timeout);
+		}
+	}
+
+	void executeCmd(
+		uint8_t cmd,
+		std::function<void(ProtoReq &, ProtoRes &)> requestPrepareCallback,
+		std::function<void(ProtoReq &)>             requestFillCallback,
+		std::function<void(const ProtoRes &)>       responseDataCallback,
+		int timeout
+	) {
+		this->submitCmd(cmd, requestPrepareCallback, requestFillCallback, responseDataCallback, timeout);
+
+		this->flush(timeout);
+	}
+
+	/*
+	 * Asks the programmer to switch to rate and checks the link with GET_INFO.
+	 * Returns false when the programmer refused the rate or the link does not
+	 * work with it, in the latter case the previous rate is restored.
+	 */
+	bool switchBaudRate(int baud) {
+		int  previousBaud = this->serial->getBaudRate();
+		bool accepted     = false;
+
+		this->executeCmd(
+			PROTO_CMD_SERIAL_BAUD,
+
+			[baud](ProtoReq &request, ProtoRes &response) {
+				request.request.serialBaud.baud = baud;
+			},
+
+			{},
+
+			[baud, &accepted](const ProtoRes &response) {
+				accepted = response.response.serialBaud.baud == (uint32_t) baud;
+			},
+
+			TIMEOUT_MS
+		);
+
+		if (! accepted) {
+			DEBUG("Programmer refused %d baud", baud);
+
+			return false;
+		}
+
+		this->serial->setBaudRate(baud);
+
+		// The programmer promises to revert within twice the timeout, one more is the margin
+		auto fallbackDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(3 * PROTO_SERIAL_BAUD_TIMEOUT_MS);
+
+		try {
+			// Any valid request confirms the new rate
+			this->executeCmd(PROTO_CMD_GET_INFO, {}, {}, {}, PROTO_SERIAL_BAUD_TIMEOUT_MS);
+
+			return true;
+
+		} catch (const std::exception &e) {
+			WARN("Link does not work with %d baud: %s", baud, e.what());
+		}
+
+		this->dropPending();
+
+		this->serial->setBaudRate(previousBaud);
+
+		// Programmer returns to the previous rate by itself, the link works again as soon as it does
+		while (true) {
+			try {
+				this->executeCmd(PROTO_CMD_GET_INFO, {}, {}, {}, SERIAL_BAUD_FALLBACK_POLL_MS);
+
+				return false;
+
+			} catch (const std::exception &e) {
+				this->dropPending();
+
+				if (std::chrono::steady_clock::now() >= fallbackDeadline) {
+					throw;
+				}
+
+				DEBUG("Programmer does not use %d baud yet: %s", previousBaud, e.what());
+			}
+		}
+	}
+
+	/*
+	 * Switches the link to the fastest rate up to maxBaudRate which both
+	 * sides are able to use.
+	 */
+	void upgradeBaudRate() {
+		int currentBaud = this->serial->getBaudRate();
+
+		if (this->maxBaudRate <= 0 || currentBaud <= 0 || (this->cmds & PROTO_CMD_MASK(PROTO_CMD_SERIAL_BAUD)) == 0) {
+			return;
+		}
+
+		for (int baud : SERIAL_BAUD_RATES) {
+			if (baud <= currentBaud) {
+				break;
+			}
+
+			if (baud > this->maxBaudRate) {
+				continue;
+			}
+
+			if (this->switchBaudRate(baud)) {
+				INFO("Serial link switched to %d baud", baud);
+
+				return;
+			}
+		}
+	}
+
+	void attach() {
+		this->init(true);
+
+		executeCmd(PROTO_CMD_GET_INFO, {}, {}, [this](const ProtoRes &response) {
+			const ProtoResGetInfo &info = response.response.getInfo;
+
+			DEBUG("version %hhu.%hhu, payload size: %hu, window: %hhu, commands: %04x, features: %02x, checksums: %02x, spi clock: %u, io widths: %02x",
+				info.version.major, info.version.minor, info.packetSize, info.windowSize, info.cmds, info.features, info.checksums,
+				info.spiClock, info.ioWidths
+			);
+
+			this->packetBuffer   = std::vector<uint8_t>(info.packetSize);
+			this->responseBuffer = std::vector<uint8_t>(info.packetSize);
+			this->readBuffer     = std::vector<uint8_t>(info.packetSize);
+			this->readBegin      = 0;
+			this->readEnd        = 0;
+			this->windowSize     = std::max<size_t>(info.windowSize, 1);
+			this->cmds           = info.cmds;
+			this->features       = info.features;
+
+			proto_pkt_dec_setup(&this->decoder, this->responseBuffer.data(), this->responseBuffer.size());
+
+			this->capabilities.reset()
+				.frameSize(info.packetSize)
+				.pipelineDepth(this->windowSize)
+				.maxClock(info.spiClock)
+				.ioWidths(info.ioWidths)
+				.supports(Capabilities::Operation::FLASH_READ,        info.cmds & PROTO_CMD_MASK(PROTO_CMD_FLASH_READ))
+				.supports(Capabilities::Operation::FLASH_WRITE_PAGE,  info.cmds & PROTO_CMD_MASK(PROTO_CMD_FLASH_WRITE_PAGE))
+				.supports(Capabilities::Operation::POLL,              info.cmds & PROTO_CMD_MASK(PROTO_CMD_SPI_POLL))
+				.supports(Capabilities::Operation::FLASH_CRC32,       info.cmds & PROTO_CMD_MASK(PROTO_CMD_FLASH_CRC32))
+				.supports(Capabilities::Operation::FLASH_BLANK_CHECK, info.cmds & PROTO_CMD_MASK(PROTO_CMD_FLASH_BLANK_CHECK))
+				.supports(Capabilities::Operation::FLASH_COMPARE,     info.cmds & PROTO_CMD_MASK(PROTO_CMD_FLASH_COMPARE))
+				.supports(Capabilities::Operation::BATCH,             info.cmds & PROTO_CMD_MASK(PROTO_CMD_SPI_BATCH))
+				.supports(Capabilities::Operation::CONFIG,            info.cmds & PROTO_CMD_MASK(PROTO_CMD_SPI_CONFIG));
+
+			// Following frames use the narrowest checksum which is strong enough for their size (see encodeRequest)
+			this->checksums = info.checksums | PROTO_CHECKSUM_MASK(PROTO_CHECKSUM_CRC8);
+			this->checksum  = this->getChecksum(info.packetSize);
+		}, TIMEOUT_MS);
+
+		this->upgradeBaudRate();
+
+		// Explicitly requested configuration is restored, otherwise the programmer keeps its default one
+		if (this->config.clock() != 0 || this->config.mode() != 0) {
+			this->setConfig(Config(this->config));
+		}
+
+		// Be sure CS pin is released.
+		this->chipSelect(false);
+	}
+
+
+	void detach() {
+		// Be sure CS pin is released.
+		this->chipSelect(false);
+	}
+};
+
+
+SerialSpi::SerialSpi(Serial &serial) {
+	this->self.reset(new SerialSpi::Impl(serial));
+}
+
+
+SerialSpi::~SerialSpi() {
+
+}
+
+
+void SerialSpi::chipSelect(bool select) {
 	this->self->chipSelect(select);
 }
 
@@ -296,6 +1686,16 @@ const Spi::Capabilities &SerialSpi::getCapabilities() const {
 }
 
 
+const Spi::Statistics &SerialSpi::getStatistics() const {
+	return self->getStatistics();
+}
+
+
+void SerialSpi::setMaxBaudRate(int baud) {
+	self->maxBaudRate = baud;
+}
+
+
 void SerialSpi::attach() {
 	self->attach();
 }
@@ -304,3 +1704,33 @@ void SerialSpi::attach() {
 void SerialSpi::detach() {
 	self->detach();
 }
+
+
+bool SerialSpi::flashRead(uint32_t address, uint8_t *buffer, std::size_t size) {
+	return self->flashRead(address, buffer, size);
+}
+
+
+bool SerialSpi::flashWritePage(uint32_t address, const uint8_t *data, std::size_t size, uint8_t &status) {
+	return self->flashWritePage(address, data, size, status);
+}
+
+
+bool SerialSpi::poll(uint8_t opcode, uint8_t mask, uint8_t value, int timeoutMs, uint8_t &status) {
+	return self->poll(opcode, mask, value, timeoutMs, status);
+}
+
+
+bool SerialSpi::flashCrc32(uint32_t address, std::size_t size, uint32_t &crc) {
+	return self->flashCrc32(address, size, crc);
+}
+
+
+bool SerialSpi::flashBlankCheck(uint32_t address, std::size_t size, std::size_t &offset) {
+	return self->flashBlankCheck(address, size, offset);
+}
+
+
+bool SerialSpi::flashCompare(uint32_t address, std::size_t pageSize, const std::vector<uint32_t> &crcs, std::vector<bool> &differs) {
+	return self->flashCompare(address, pageSize, crcs, differs);
+}
@@ -0,0 +1,24 @@
+#include <cstring>
+
+#include <gtest/gtest.h>
+
+#include "common/crc16.h"
+
+
+TEST(common_crc16, check_value) {
+	const char *data = "123456789";
+
+	ASSERT_EQ(crc16_get((const uint8_t *) data, strlen(data), CRC16_START), 0x2189);
+}
+
+
+TEST(common_crc16, continuation) {
+	const char *data = "123456789";
+
+	uint16_t crc = CRC16_START;
+
+	crc = crc16_get((const uint8_t *) data,     4, crc);
+	crc = crc16_get((const uint8_t *) data + 4, 5, crc);
+
+	ASSERT_EQ(crc, 0x2189);
+}
@@ -0,0 +1,49 @@
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common/crc32.h"
+
+
+TEST(common_crc32, check_value) {
+	const char *data = "123456789";
+
+	ASSERT_EQ(crc32_get((const uint8_t *) data, strlen(data), CRC32_START), 0xcbf43926);
+}
+
+
+TEST(common_crc32, continuation) {
+	const char *data = "123456789";
+
+	uint32_t crc = CRC32_START;
+
+	crc = crc32_get((const uint8_t *) data,     4, crc);
+	crc = crc32_get((const uint8_t *) data + 4, 5, crc);
+
+	ASSERT_EQ(crc, 0xcbf43926);
+}
+
+
+TEST(common_crc32, long_buffer) {
+	std::vector<uint8_t> buffer(1000);
+
+	for (size_t i = 0; i < buffer.size(); i++) {
+		buffer[i] = i * 31 + 7;
+	}
+
+	// Bitwise reference, all lengths cover calculation 8 bytes at a time and remaining bytes
+	for (size_t size = 0; size < buffer.size(); size += 13) {
+		uint32_t crc = (uint32_t) ~CRC32_START;
+
+		for (size_t i = 0; i < size; i++) {
+			crc ^= buffer[i];
+
+			for (int bit = 0; bit < 8; bit++) {
+				crc = (crc & 1) ? (crc >> 1) ^ CRC32_POLY : (crc >> 1);
+			}
+		}
+
+		ASSERT_EQ(crc32_get(buffer.data(), size, CRC32_START), ~crc) << size;
+	}
+}
@@ -0,0 +1,66 @@
+#include <cstdlib>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common/crc8.h"
+#include "common/protocol.h"
+
+
+static uint8_t _crc8Reference(const uint8_t *buffer, size_t bufferSize, uint8_t polynomial, uint8_t start) {
+	uint8_t remainder = start;
+
+	for (size_t i = 0; i < bufferSize; i++) {
+		remainder ^= buffer[i];
+
+		for (int bit = 0; bit < 8; bit++) {
+			remainder = (remainder & 0x01) ? (remainder >> 1) ^ polynomial : (remainder >> 1);
+		}
+	}
+
+	return remainder;
+}
+
+
+TEST(common_crc8, getForByte_table) {
+	for (unsigned start = 0; start < 256; start++) {
+		for (unsigned byte = 0; byte < 256; byte++) {
+			uint8_t b = byte;
+
+			ASSERT_EQ(crc8_getForByte(b, PROTO_CRC8_POLY, start), _crc8Reference(&b, 1, PROTO_CRC8_POLY, start));
+		}
+	}
+}
+
+
+TEST(common_crc8, getForByte_otherPolynomial) {
+	for (unsigned byte = 0; byte < 256; byte++) {
+		uint8_t b = byte;
+
+		ASSERT_EQ(crc8_getForByte(b, 0x8c, 0x12), _crc8Reference(&b, 1, 0x8c, 0x12));
+	}
+}
+
+
+TEST(common_crc8, get) {
+	std::vector<uint8_t> buffer(1024);
+
+	srand(0);
+	for (auto &b : buffer) {
+		b = rand();
+	}
+
+	// All lengths around slice boundaries and misaligned starts
+	for (size_t offset = 0; offset < 8; offset++) {
+		for (size_t size = 0; size < 67; size++) {
+			ASSERT_EQ(crc8_get(buffer.data() + offset, size, PROTO_CRC8_POLY, PROTO_CRC8_START),
+				_crc8Reference(buffer.data() + offset, size, PROTO_CRC8_POLY, PROTO_CRC8_START)) << size;
+		}
+	}
+
+	ASSERT_EQ(crc8_get(buffer.data(), buffer.size(), PROTO_CRC8_POLY, 0x5a),
+		_crc8Reference(buffer.data(), buffer.size(), PROTO_CRC8_POLY, 0x5a));
+
+	ASSERT_EQ(crc8_get(buffer.data(), buffer.size(), 0x8c, 0x00),
+		_crc8Reference(buffer.data(), buffer.size(), 0x8c, 0x00));
+}
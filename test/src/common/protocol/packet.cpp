@@ -177,6 +177,57 @@ TEST(common_protocol, packet_long_payload) {
 }
 
 
+TEST(common_protocol, packet_max_payload) {
+	// Bigger than VLEN range
+	std::vector<uint8_t> txBuffer(0xffff, 0);
+	size_t               txBufferWritten;
+
+	{
+		ProtoPkt pkt;
+
+		proto_pkt_init       (&pkt, txBuffer.data(), txBuffer.size(), PROTO_CMD_SPI_TRANSFER, 0x12);
+		proto_pkt_setChecksum(&pkt, txBuffer.data(), txBuffer.size(), PROTO_CHECKSUM_CRC32);
+
+		ASSERT_EQ(pkt.payloadSize, PROTO_INT_VAL_MAX);
+
+		ASSERT_FALSE(proto_pkt_prepare(&pkt, txBuffer.data(), txBuffer.size(), PROTO_INT_VAL_MAX + 1));
+		ASSERT_TRUE (proto_pkt_prepare(&pkt, txBuffer.data(), txBuffer.size(), PROTO_INT_VAL_MAX));
+
+		for (uint16_t i = 0; i < pkt.payloadSize; i++) {
+			pkt.payload[i] = i;
+		}
+
+		txBufferWritten = proto_pkt_encode(&pkt, txBuffer.data(), txBuffer.size());
+
+		// SYNC/CTRL, ID, 2B VLEN, CRC32
+		ASSERT_EQ(txBufferWritten, 4 + PROTO_INT_VAL_MAX + 4);
+	}
+
+	{
+		std::vector<uint8_t> rxBuffer(txBufferWritten, 0);
+
+		ProtoPktDes ctx;
+		ProtoPkt    pkt;
+		uint8_t     ret = PROTO_PKT_DES_RET_IDLE;
+
+		proto_pkt_dec_setup(&ctx, rxBuffer.data(), rxBuffer.size());
+
+		for (size_t i = 0; i < txBufferWritten; i++) {
+			ret = proto_pkt_dec_putByte(&ctx, txBuffer[i], &pkt);
+		}
+
+		ASSERT_EQ(PROTO_PKT_DES_RET_GET_ERROR_CODE(ret), PROTO_NO_ERROR);
+		ASSERT_NE(ret, PROTO_PKT_DES_RET_IDLE);
+
+		ASSERT_EQ(pkt.payloadSize, PROTO_INT_VAL_MAX);
+
+		for (uint16_t i = 0; i < pkt.payloadSize; i++) {
+			ASSERT_EQ(pkt.payload[i], (uint8_t) i);
+		}
+	}
+}
+
+
 TEST(common_protocol, packet_error_payload_too_long) {
 	std::vector<uint8_t> txBuffer(MEM_SIZE, 0);
 	size_t               txBufferWritten;
@@ -267,3 +318,209 @@ TEST(common_protocol, packet_error_invalid_crc) {
 		}
 	}
 }
+
+
+static void _encodeFrame(std::vector<uint8_t> &stream, uint8_t checksum, uint8_t id, const std::string &payload) {
+	std::vector<uint8_t> buffer(MEM_SIZE, 0);
+
+	ProtoPkt pkt;
+
+	proto_pkt_init       (&pkt, buffer.data(), buffer.size(), PROTO_CMD_SPI_TRANSFER, id);
+	proto_pkt_setChecksum(&pkt, buffer.data(), buffer.size(), checksum);
+
+	ASSERT_TRUE(proto_pkt_prepare(&pkt, buffer.data(), buffer.size(), payload.length()));
+
+	memcpy(pkt.payload, payload.data(), payload.length());
+
+	stream.insert(stream.end(), buffer.begin(), buffer.begin() + proto_pkt_encode(&pkt, buffer.data(), buffer.size()));
+}
+
+
+TEST(common_protocol, packet_dec_putBytes) {
+	std::vector<uint8_t> stream;
+
+	// Garbage before the first frame is skipped
+	stream.push_back(0x00);
+
+	_encodeFrame(stream, PROTO_CHECKSUM_CRC8,  0x12, STRING_PAYLOAD_LONG);
+	_encodeFrame(stream, PROTO_CHECKSUM_CRC32, 0x13, STRING_PAYLOAD_SHORT);
+	_encodeFrame(stream, PROTO_CHECKSUM_CRC16, 0x14, "");
+
+	for (uint16_t chunkSize : { 1, 3, 7, 64, 0xffff }) {
+		std::vector<uint8_t> rxBuffer(MEM_SIZE);
+		std::vector<uint8_t> ids;
+		std::vector<size_t>  payloadSizes;
+
+		ProtoPktDes ctx;
+		size_t      offset = 0;
+
+		proto_pkt_dec_setup(&ctx, rxBuffer.data(), rxBuffer.size());
+
+		while (offset < stream.size()) {
+			ProtoPkt pkt;
+			uint16_t consumed;
+			uint16_t size = std::min<size_t>(chunkSize, stream.size() - offset);
+
+			auto ret = proto_pkt_dec_putBytes(&ctx, stream.data() + offset, size, &consumed, &pkt);
+
+			ASSERT_GT(consumed, 0);
+			ASSERT_LE(consumed, size);
+
+			if (ret != PROTO_PKT_DES_RET_IDLE) {
+				ASSERT_EQ(PROTO_PKT_DES_RET_GET_ERROR_CODE(ret), PROTO_NO_ERROR);
+
+				// Frame is completed by its last byte
+				ASSERT_EQ(proto_pkt_dec_getPendingSize(&ctx), 1);
+
+				ids.push_back(pkt.id);
+				payloadSizes.push_back(pkt.payloadSize);
+
+				if (pkt.id == 0x12) {
+					ASSERT_EQ(std::string((char *) pkt.payload, pkt.payloadSize), STRING_PAYLOAD_LONG);
+
+				} else if (pkt.id == 0x13) {
+					ASSERT_EQ(std::string((char *) pkt.payload, pkt.payloadSize), STRING_PAYLOAD_SHORT);
+				}
+
+			} else {
+				ASSERT_EQ(consumed, size);
+			}
+
+			offset += consumed;
+		}
+
+		ASSERT_EQ(ids,          std::vector<uint8_t>({ 0x12, 0x13, 0x14 }));
+		ASSERT_EQ(payloadSizes, std::vector<size_t>({ strlen(STRING_PAYLOAD_LONG), strlen(STRING_PAYLOAD_SHORT), 0 }));
+	}
+}
+
+
+TEST(common_protocol, packet_dec_getPendingSize) {
+	std::vector<uint8_t> stream;
+	std::vector<uint8_t> rxBuffer(MEM_SIZE);
+
+	ProtoPktDes ctx;
+	ProtoPkt    pkt;
+
+	_encodeFrame(stream, PROTO_CHECKSUM_CRC32, 0x12, STRING_PAYLOAD_LONG);
+
+	proto_pkt_dec_setup(&ctx, rxBuffer.data(), rxBuffer.size());
+
+	// SYNC/CTRL, ID, 2B VLEN
+	for (size_t i = 0; i < 4; i++) {
+		ASSERT_EQ(proto_pkt_dec_getPendingSize(&ctx), 1);
+		ASSERT_EQ(proto_pkt_dec_putByte(&ctx, stream[i], &pkt), PROTO_PKT_DES_RET_IDLE);
+	}
+
+	// Payload and CRC32
+	ASSERT_EQ(proto_pkt_dec_getPendingSize(&ctx), stream.size() - 4);
+
+	for (size_t i = 4; i < stream.size() - 2; i++) {
+		proto_pkt_dec_putByte(&ctx, stream[i], &pkt);
+	}
+
+	ASSERT_EQ(proto_pkt_dec_getPendingSize(&ctx), 2);
+}
+
+
+struct PacketChecksumTestData {
+	uint8_t checksum;
+	uint8_t syncNibble;
+	uint8_t checksumSize;
+};
+
+
+class PacketChecksumTest : public ::testing::TestWithParam<PacketChecksumTestData> {
+};
+
+
+TEST_P(PacketChecksumTest, encode_decode) {
+	const auto &data = GetParam();
+
+	std::vector<uint8_t> txBuffer(MEM_SIZE, 0);
+	size_t               txBufferWritten;
+
+	std::string payload = STRING_PAYLOAD_LONG;
+
+	{
+		ProtoPkt pkt;
+		uint16_t maxPayloadSize;
+
+		proto_pkt_init(&pkt, txBuffer.data(), txBuffer.size(), PROTO_CMD_SPI_TRANSFER, 0x12);
+
+		maxPayloadSize = pkt.payloadSize;
+
+		proto_pkt_setChecksum(&pkt, txBuffer.data(), txBuffer.size(), data.checksum);
+
+		ASSERT_EQ(pkt.checksum,    data.checksum);
+		ASSERT_EQ(pkt.payloadSize, maxPayloadSize - data.checksumSize + 1);
+
+		ASSERT_FALSE(proto_pkt_prepare(&pkt, txBuffer.data(), txBuffer.size(), pkt.payloadSize + 1));
+		ASSERT_TRUE (proto_pkt_prepare(&pkt, txBuffer.data(), txBuffer.size(), payload.length()));
+
+		memcpy(pkt.payload, payload.data(), payload.length());
+
+		txBufferWritten = proto_pkt_encode(&pkt, txBuffer.data(), txBuffer.size());
+
+		// SYNC/CTRL, ID, 2B VLEN
+		ASSERT_EQ(txBufferWritten, 4 + payload.length() + data.checksumSize);
+		ASSERT_EQ(txBuffer[0], data.syncNibble | PROTO_CMD_SPI_TRANSFER);
+	}
+
+	// Valid frame and frames with each byte of checksum broken
+	for (size_t broken = 0; broken <= data.checksumSize; broken++) {
+		std::vector<uint8_t> frame(txBuffer.begin(), txBuffer.begin() + txBufferWritten);
+		std::vector<uint8_t> rxBuffer(MEM_SIZE);
+
+		ProtoPktDes ctx;
+		ProtoPkt    pkt;
+		uint8_t     ret = PROTO_PKT_DES_RET_IDLE;
+		size_t      i;
+
+		if (broken) {
+			frame[frame.size() - broken] ^= 0x01;
+		}
+
+		proto_pkt_dec_setup(&ctx, rxBuffer.data(), rxBuffer.size());
+
+		for (i = 0; i < frame.size() && ret == PROTO_PKT_DES_RET_IDLE; i++) {
+			ret = proto_pkt_dec_putByte(&ctx, frame[i], &pkt);
+		}
+
+		ASSERT_NE(ret, PROTO_PKT_DES_RET_IDLE);
+
+		ASSERT_EQ(pkt.code,     PROTO_CMD_SPI_TRANSFER);
+		ASSERT_EQ(pkt.id,       0x12);
+		ASSERT_EQ(pkt.checksum, data.checksum);
+
+		if (broken) {
+			// Whole checksum is consumed, the following frame is decoded from its SYNC
+			ASSERT_EQ(PROTO_PKT_DES_RET_GET_ERROR_CODE(ret), PROTO_ERROR_INVALID_CRC);
+			ASSERT_EQ(i, frame.size());
+
+			ret = PROTO_PKT_DES_RET_IDLE;
+
+			for (i = 0; i < txBufferWritten && ret == PROTO_PKT_DES_RET_IDLE; i++) {
+				ret = proto_pkt_dec_putByte(&ctx, txBuffer[i], &pkt);
+			}
+
+			ASSERT_EQ(PROTO_PKT_DES_RET_GET_ERROR_CODE(ret), PROTO_NO_ERROR);
+			ASSERT_EQ(i, txBufferWritten);
+
+		} else {
+			ASSERT_EQ(PROTO_PKT_DES_RET_GET_ERROR_CODE(ret), PROTO_NO_ERROR);
+			ASSERT_EQ(i, frame.size());
+
+			ASSERT_EQ(std::string((char *) pkt.payload, pkt.payloadSize), payload);
+		}
+	}
+}
+
+
+INSTANTIATE_TEST_SUITE_P(common_protocol, PacketChecksumTest,
+	testing::Values(
+		PacketChecksumTestData { PROTO_CHECKSUM_CRC8,  PROTO_SYNC_NIBBLE,       1 },
+		PacketChecksumTestData { PROTO_CHECKSUM_CRC16, PROTO_SYNC_NIBBLE_CRC16, 2 },
+		PacketChecksumTestData { PROTO_CHECKSUM_CRC32, PROTO_SYNC_NIBBLE_CRC32, 4 }
+	)
+);
@@ -158,5 +158,236 @@ INSTANTIATE_TEST_SUITE_P(common_protocol_request, RequestTestWithParameter, test
 			ASSERT_EQ(t.txBuffer[0], 0x10);
 			ASSERT_EQ(t.txBuffer[1], 0x20);
 		}
+	),
+
+	RequestTestParameters(
+		PROTO_CMD_FLASH_READ, 0x46,
+
+		[](ProtoReq &req) {
+			auto &r = req.request.flashRead;
+
+			r.address = 0x00123456;
+			r.length  = 0x01000000;
+			r.flags   = PROTO_FLASH_READ_FLAG_RLE;
+		},
+
+		{},
+
+		[](ProtoReq &req) {
+			auto &r = req.request.flashRead;
+
+			ASSERT_EQ(r.address, 0x00123456);
+			ASSERT_EQ(r.length,  0x01000000);
+			ASSERT_EQ(r.flags,   PROTO_FLASH_READ_FLAG_RLE);
+		}
+	),
+
+	RequestTestParameters(
+		PROTO_CMD_FLASH_WRITE_PAGE, 0x47,
+
+		[](ProtoReq &req) {
+			auto &w = req.request.flashWritePage;
+
+			w.address   = 0x00abcdef;
+			w.pollLimit = 0x1234;
+			w.flags     = PROTO_FLASH_WRITE_PAGE_FLAG_RLE;
+			w.dataSize  = 3;
+		},
+
+		[](ProtoReq &req) {
+			auto &w = req.request.flashWritePage;
+
+			w.data[0] = 0x10;
+			w.data[1] = 0x20;
+			w.data[2] = 0x30;
+		},
+
+		[](ProtoReq &req) {
+			auto &w = req.request.flashWritePage;
+
+			ASSERT_EQ(w.address,   0x00abcdef);
+			ASSERT_EQ(w.pollLimit, 0x1234);
+			ASSERT_EQ(w.flags,     PROTO_FLASH_WRITE_PAGE_FLAG_RLE);
+			ASSERT_EQ(w.dataSize,  3);
+
+			ASSERT_EQ(w.data[0], 0x10);
+			ASSERT_EQ(w.data[1], 0x20);
+			ASSERT_EQ(w.data[2], 0x30);
+		}
+	),
+
+	RequestTestParameters(
+		PROTO_CMD_SPI_POLL, 0x48,
+
+		[](ProtoReq &req) {
+			auto &p = req.request.spiPoll;
+
+			p.opcode    = 0x05;
+			p.mask      = 0x01;
+			p.value     = 0x00;
+			p.pollLimit = 0x8001;
+		},
+
+		{},
+
+		[](ProtoReq &req) {
+			auto &p = req.request.spiPoll;
+
+			ASSERT_EQ(p.opcode,    0x05);
+			ASSERT_EQ(p.mask,      0x01);
+			ASSERT_EQ(p.value,     0x00);
+			ASSERT_EQ(p.pollLimit, 0x8001);
+		}
+	),
+
+	RequestTestParameters(
+		PROTO_CMD_SPI_CONFIG, 0x4d,
+
+		[](ProtoReq &req) {
+			auto &c = req.request.spiConfig;
+
+			c.clock = 31250000;
+			c.mode  = PROTO_SPI_MODE_CPOL | PROTO_SPI_MODE_CPHA;
+		},
+
+		{},
+
+		[](ProtoReq &req) {
+			auto &c = req.request.spiConfig;
+
+			ASSERT_EQ(c.clock, 31250000);
+			ASSERT_EQ(c.mode,  PROTO_SPI_MODE_CPOL | PROTO_SPI_MODE_CPHA);
+		}
+	),
+
+	RequestTestParameters(
+		PROTO_CMD_SERIAL_BAUD, 0x4e,
+
+		[](ProtoReq &req) {
+			req.request.serialBaud.baud = 2000000;
+		},
+
+		{},
+
+		[](ProtoReq &req) {
+			ASSERT_EQ(req.request.serialBaud.baud, 2000000);
+		}
+	),
+
+	RequestTestParameters(
+		PROTO_CMD_FLASH_CRC32, 0x49,
+
+		[](ProtoReq &req) {
+			auto &r = req.request.flashCrc32;
+
+			r.address = 0x00fedcba;
+			r.length  = 0x00800000;
+		},
+
+		{},
+
+		[](ProtoReq &req) {
+			auto &r = req.request.flashCrc32;
+
+			ASSERT_EQ(r.address, 0x00fedcba);
+			ASSERT_EQ(r.length,  0x00800000);
+		}
+	),
+
+	RequestTestParameters(
+		PROTO_CMD_FLASH_BLANK_CHECK, 0x4a,
+
+		[](ProtoReq &req) {
+			auto &r = req.request.flashBlankCheck;
+
+			r.address = 0x00010000;
+			r.length  = 0x00001000;
+		},
+
+		{},
+
+		[](ProtoReq &req) {
+			auto &r = req.request.flashBlankCheck;
+
+			ASSERT_EQ(r.address, 0x00010000);
+			ASSERT_EQ(r.length,  0x00001000);
+		}
+	),
+
+	RequestTestParameters(
+		PROTO_CMD_FLASH_COMPARE, 0x4b,
+
+		[](ProtoReq &req) {
+			auto &c = req.request.flashCompare;
+
+			c.address   = 0x00020000;
+			c.pageSize  = 256;
+			c.pageCount = 2;
+		},
+
+		[](ProtoReq &req) {
+			auto &c = req.request.flashCompare;
+
+			for (uint8_t i = 0; i < 8; i++) {
+				c.crcs[i] = 0xa0 + i;
+			}
+		},
+
+		[](ProtoReq &req) {
+			auto &c = req.request.flashCompare;
+
+			ASSERT_EQ(c.address,   0x00020000);
+			ASSERT_EQ(c.pageSize,  256);
+			ASSERT_EQ(c.pageCount, 2);
+
+			for (uint8_t i = 0; i < 8; i++) {
+				ASSERT_EQ(c.crcs[i], 0xa0 + i);
+			}
+		}
+	)
+,
+	RequestTestParameters(
+		PROTO_CMD_SPI_BATCH, 0x4c,
+
+		[](ProtoReq &req) {
+			req.request.spiBatch.transfersSize = 10;
+		},
+
+		[](ProtoReq &req) {
+			const uint8_t transfers[] = {
+				PROTO_SPI_TRANSFER_FLAG_KEEP_CS, 0x02, 0xaa, 0xbb, 0x00, 0x04,
+				0x00,                            0x00, 0x00, 0x10
+			};
+
+			std::copy(transfers, transfers + sizeof(transfers), req.request.spiBatch.transfers);
+		},
+
+		[](ProtoReq &req) {
+			auto &b = req.request.spiBatch;
+
+			ProtoReqTransfer t;
+
+			ASSERT_EQ(b.transfersSize, 10);
+
+			ASSERT_EQ(proto_req_spiBatch_getTransfer(&b, 0, &t), 6);
+			ASSERT_EQ(t.flags,        PROTO_SPI_TRANSFER_FLAG_KEEP_CS);
+			ASSERT_EQ(t.txBufferSize, 2);
+			ASSERT_EQ(t.rxSkipSize,   0);
+			ASSERT_EQ(t.rxBufferSize, 4);
+			ASSERT_EQ(t.txBuffer[0],  0xaa);
+			ASSERT_EQ(t.txBuffer[1],  0xbb);
+
+			ASSERT_EQ(proto_req_spiBatch_getTransfer(&b, 6, &t), 4);
+			ASSERT_EQ(t.flags,        0);
+			ASSERT_EQ(t.txBufferSize, 0);
+			ASSERT_EQ(t.rxBufferSize, 0x10);
+			ASSERT_TRUE(t.txBuffer == NULL);
+
+			// End of buffer and truncated sub-transfers
+			ASSERT_EQ(proto_req_spiBatch_getTransfer(&b, 10, &t), 0);
+
+			b.transfersSize = 5;
+			ASSERT_EQ(proto_req_spiBatch_getTransfer(&b, 0, &t), 0);
+		}
 	)
 ));
@@ -128,6 +128,197 @@ INSTANTIATE_TEST_SUITE_P(common_protocol_response, ResponseTestWithParameter, te
 		{}
 	),
 
+	ResponseTestParameters(
+		PROTO_CMD_GET_INFO, PROTO_NO_ERROR, 0x45,
+
+		[](ProtoRes &res) {
+			auto &t = res.response.getInfo;
+
+			t.version.major = 1;
+			t.version.minor = 2;
+			t.packetSize    = 384;
+			t.windowSize    = 4;
+			t.cmds          = PROTO_CMD_MASK(PROTO_CMD_GET_INFO) | PROTO_CMD_MASK(PROTO_CMD_FLASH_READ);
+			t.features      = PROTO_FEATURE_RLE;
+			t.checksums     = PROTO_CHECKSUM_MASK(PROTO_CHECKSUM_CRC8) | PROTO_CHECKSUM_MASK(PROTO_CHECKSUM_CRC32);
+			t.spiClock      = 62500000;
+			t.ioWidths      = PROTO_IO_WIDTH_SINGLE | PROTO_IO_WIDTH_DUAL;
+		},
+
+		{},
+
+		[](ProtoPkt &pkt, ProtoRes &res) {
+			auto &t = res.response.getInfo;
+
+			ASSERT_EQ(t.version.major,   1);
+			ASSERT_EQ(t.version.minor,   2);
+			ASSERT_EQ(t.packetSize,    384);
+			ASSERT_EQ(t.windowSize,      4);
+			ASSERT_EQ(t.cmds,            PROTO_CMD_MASK(PROTO_CMD_GET_INFO) | PROTO_CMD_MASK(PROTO_CMD_FLASH_READ));
+			ASSERT_EQ(t.features,        PROTO_FEATURE_RLE);
+			ASSERT_EQ(t.checksums,       PROTO_CHECKSUM_MASK(PROTO_CHECKSUM_CRC8) | PROTO_CHECKSUM_MASK(PROTO_CHECKSUM_CRC32));
+			ASSERT_EQ(t.spiClock,        62500000);
+			ASSERT_EQ(t.ioWidths,        PROTO_IO_WIDTH_SINGLE | PROTO_IO_WIDTH_DUAL);
+		}
+	),
+
+	ResponseTestParameters(
+		PROTO_CMD_FLASH_WRITE_PAGE, PROTO_NO_ERROR, 0x46,
+
+		[](ProtoRes &res) {
+		},
+
+		[](ProtoRes &res) {
+			auto &w = res.response.flashWritePage;
+
+			w.status = 0x83;
+			w.polls  = 0x0102;
+		},
+
+		[](ProtoPkt &pkt, ProtoRes &res) {
+			auto &w = res.response.flashWritePage;
+
+			ASSERT_EQ(w.status, 0x83);
+			ASSERT_EQ(w.polls,  0x0102);
+		}
+	),
+
+	ResponseTestParameters(
+		PROTO_CMD_SPI_POLL, PROTO_NO_ERROR, 0x47,
+
+		[](ProtoRes &res) {
+		},
+
+		[](ProtoRes &res) {
+			auto &p = res.response.spiPoll;
+
+			p.status = 0x02;
+			p.polls  = 0xfffe;
+		},
+
+		[](ProtoPkt &pkt, ProtoRes &res) {
+			auto &p = res.response.spiPoll;
+
+			ASSERT_EQ(p.status, 0x02);
+			ASSERT_EQ(p.polls,  0xfffe);
+		}
+	),
+
+	ResponseTestParameters(
+		PROTO_CMD_FLASH_CRC32, PROTO_NO_ERROR, 0x48,
+
+		[](ProtoRes &res) {
+		},
+
+		[](ProtoRes &res) {
+			res.response.flashCrc32.crc = 0xcbf43926;
+		},
+
+		[](ProtoPkt &pkt, ProtoRes &res) {
+			ASSERT_EQ(res.response.flashCrc32.crc, 0xcbf43926);
+		}
+	),
+
+	ResponseTestParameters(
+		PROTO_CMD_FLASH_BLANK_CHECK, PROTO_NO_ERROR, 0x49,
+
+		[](ProtoRes &res) {
+			ASSERT_EQ(res.response.flashBlankCheck.offset, PROTO_FLASH_BLANK);
+		},
+
+		[](ProtoRes &res) {
+			res.response.flashBlankCheck.offset = 0x00123456;
+		},
+
+		[](ProtoPkt &pkt, ProtoRes &res) {
+			ASSERT_EQ(res.response.flashBlankCheck.offset, 0x00123456);
+		}
+	),
+
+	ResponseTestParameters(
+		PROTO_CMD_SPI_CONFIG, PROTO_NO_ERROR, 0x4c,
+
+		[](ProtoRes &res) {
+			ASSERT_EQ(res.response.spiConfig.clock, 0);
+		},
+
+		[](ProtoRes &res) {
+			res.response.spiConfig.clock = 62500000;
+			res.response.spiConfig.mode  = PROTO_SPI_MODE_CPHA;
+		},
+
+		[](ProtoPkt &pkt, ProtoRes &res) {
+			ASSERT_EQ(res.response.spiConfig.clock, 62500000);
+			ASSERT_EQ(res.response.spiConfig.mode,  PROTO_SPI_MODE_CPHA);
+		}
+	),
+
+	ResponseTestParameters(
+		PROTO_CMD_SERIAL_BAUD, PROTO_NO_ERROR, 0x4d,
+
+		[](ProtoRes &res) {
+			ASSERT_EQ(res.response.serialBaud.baud, 0);
+		},
+
+		[](ProtoRes &res) {
+			res.response.serialBaud.baud = 1000000;
+		},
+
+		[](ProtoPkt &pkt, ProtoRes &res) {
+			ASSERT_EQ(res.response.serialBaud.baud, 1000000);
+		}
+	),
+
+	ResponseTestParameters(
+		PROTO_CMD_FLASH_COMPARE, PROTO_NO_ERROR, 0x4a,
+
+		[](ProtoRes &res) {
+			res.response.flashCompare.bitmapSize = 2;
+		},
+
+		[](ProtoRes &res) {
+			auto &c = res.response.flashCompare;
+
+			c.bitmap[0] = 0x81;
+			c.bitmap[1] = 0x02;
+		},
+
+		[](ProtoPkt &pkt, ProtoRes &res) {
+			auto &c = res.response.flashCompare;
+
+			ASSERT_EQ(c.bitmapSize, 2);
+			ASSERT_EQ(c.bitmap[0],  0x81);
+			ASSERT_EQ(c.bitmap[1],  0x02);
+		}
+	),
+
+	ResponseTestParameters(
+		PROTO_CMD_FLASH_READ, PROTO_NO_ERROR, 0x45,
+
+		[](ProtoRes &res) {
+			res.response.flashRead.dataSize = 100;
+		},
+
+		[](ProtoRes &res) {
+			auto &r = res.response.flashRead;
+
+			for (uint16_t i = 0; i < r.dataSize; i++) {
+				r.data[i] = i;
+			}
+		},
+
+		[](ProtoPkt &pkt, ProtoRes &res) {
+			auto &r = res.response.flashRead;
+
+			ASSERT_EQ(r.dataSize, 100);
+			ASSERT_TRUE(r.data != NULL);
+
+			for (uint16_t i = 0; i < r.dataSize; i++) {
+				ASSERT_EQ(r.data[i], i);
+			}
+		}
+	),
+
 	ResponseTestParameters(
 		PROTO_CMD_SPI_TRANSFER, PROTO_NO_ERROR, 0x45,
 
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include "common/rle.h"
+
+
+static std::vector<uint8_t> _encode(const std::vector<uint8_t> &data) {
+	std::vector<uint8_t> ret(RLE_MAX_SIZE(data.size()));
+
+	ret.resize(rle_encode(ret.data(), data.data(), data.size()));
+
+	return ret;
+}
+
+
+static void _assertRoundTrip(const std::vector<uint8_t> &data) {
+	std::vector<uint8_t> encoded = _encode(data);
+	std::vector<uint8_t> decoded(data.size());
+
+	ASSERT_LE(encoded.size(), RLE_MAX_SIZE(data.size()));
+
+	ASSERT_EQ(rle_decode(decoded.data(), decoded.size(), encoded.data(), encoded.size()), (int32_t) data.size());
+	ASSERT_EQ(decoded, data);
+}
+
+
+TEST(common_rle, encode_runs) {
+	// Erased area
+	ASSERT_EQ(_encode(std::vector<uint8_t>(130, 0xff)), std::vector<uint8_t>({ 0xff, 0xff }));
+	ASSERT_EQ(_encode(std::vector<uint8_t>(256, 0xff)), std::vector<uint8_t>({ 0xff, 0xff, 0xfb, 0xff }));
+
+	// Short runs are sent as literals
+	ASSERT_EQ(_encode({ 0x01, 0x01, 0x02 }), std::vector<uint8_t>({ 0x02, 0x01, 0x01, 0x02 }));
+	ASSERT_EQ(_encode({ 0x01, 0x02, 0x02, 0x02 }), std::vector<uint8_t>({ 0x00, 0x01, 0x80, 0x02 }));
+
+	ASSERT_TRUE(_encode({}).empty());
+}
+
+
+TEST(common_rle, round_trip) {
+	std::vector<uint8_t> data(4096);
+
+	srand(1);
+
+	for (auto &b : data) {
+		b = rand();
+	}
+
+	_assertRoundTrip(data);
+
+	// Worst case for literals
+	_assertRoundTrip(std::vector<uint8_t>(data.begin(), data.begin() + 128));
+	_assertRoundTrip(std::vector<uint8_t>(data.begin(), data.begin() + 129));
+
+	for (size_t i = 0; i < data.size(); i++) {
+		if ((i / 100) % 2) {
+			data[i] = (i / 200) % 2 ? 0xff : 0x00;
+		}
+	}
+
+	_assertRoundTrip(data);
+
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = (i % 7) < 3 ? 0xaa : i;
+	}
+
+	_assertRoundTrip(data);
+}
+
+
+TEST(common_rle, encode_in_place) {
+	for (size_t size : { 1, 127, 128, 129, 500, 1000 }) {
+		std::vector<uint8_t> data(size);
+		std::vector<uint8_t> buffer(RLE_MAX_SIZE(size));
+		std::vector<uint8_t> decoded(size);
+		uint16_t             encodedSize;
+
+		for (size_t i = 0; i < size; i++) {
+			data[i] = (i % 50) < 10 ? 0xff : rand();
+		}
+
+		// Data placed at the end of the buffer, encoded from its beginning
+		std::copy(data.begin(), data.end(), buffer.end() - size);
+
+		encodedSize = rle_encode(buffer.data(), buffer.data() + buffer.size() - size, size);
+
+		ASSERT_EQ(rle_decode(decoded.data(), decoded.size(), buffer.data(), encodedSize), (int32_t) size);
+		ASSERT_EQ(decoded, data);
+	}
+}
+
+
+TEST(common_rle, decode_errors) {
+	std::vector<uint8_t> decoded(10);
+
+	// Missing run value
+	ASSERT_EQ(rle_decode(decoded.data(), decoded.size(), std::vector<uint8_t>({ 0x80 }).data(), 1), RLE_ERROR);
+
+	// Truncated literal
+	ASSERT_EQ(rle_decode(decoded.data(), decoded.size(), std::vector<uint8_t>({ 0x02, 0x01 }).data(), 2), RLE_ERROR);
+
+	// Output overflow
+	ASSERT_EQ(rle_decode(decoded.data(), decoded.size(), std::vector<uint8_t>({ 0x88, 0xff }).data(), 2), RLE_ERROR);
+}
+
+
+TEST(common_rle, decoded_size) {
+	ASSERT_EQ(rle_getDecodedSize(_encode(std::vector<uint8_t>(1000, 0xff)).data(), _encode(std::vector<uint8_t>(1000, 0xff)).size()), 1000);
+	ASSERT_EQ(rle_getDecodedSize(std::vector<uint8_t>({ 0x01, 0x10, 0x20, 0x80, 0x00 }).data(), 5), 5);
+	ASSERT_EQ(rle_getDecodedSize(nullptr, 0), 0);
+
+	// Truncated blocks
+	ASSERT_EQ(rle_getDecodedSize(std::vector<uint8_t>({ 0x80 }).data(), 1),       RLE_ERROR);
+	ASSERT_EQ(rle_getDecodedSize(std::vector<uint8_t>({ 0x02, 0x01 }).data(), 2), RLE_ERROR);
+}
+
+
+TEST(common_rle, max_decoded_size) {
+	for (uint16_t encodedSize = 0; encodedSize < 1000; encodedSize++) {
+		uint16_t size = rle_getMaxDecodedSize(encodedSize);
+
+		if (encodedSize > 0) {
+			ASSERT_LE(RLE_MAX_SIZE(size), encodedSize);
+		}
+
+		ASSERT_GT(RLE_MAX_SIZE(size + 1), encodedSize);
+	}
+}
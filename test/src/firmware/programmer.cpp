@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
+#include <functional>
 
+#include "common/crc32.h"
+#include "common/rle.h"
 #include "common/protocol.h"
 #include "flashutil/debug.h"
 #include "firmware/programmer.h"
@@ -49,6 +52,14 @@ static void _responseGetInfoCallback(uint8_t *buffer, uint16_t bufferSize, void
 		ASSERT_EQ(res.response.getInfo.version.major, PROTO_VERSION_MAJOR);
 		ASSERT_EQ(res.response.getInfo.version.minor, PROTO_VERSION_MINOR);
 		ASSERT_GT(res.response.getInfo.packetSize,   0);
+		ASSERT_EQ(res.response.getInfo.windowSize,   2);
+		ASSERT_EQ(res.response.getInfo.checksums,
+			PROTO_CHECKSUM_MASK(PROTO_CHECKSUM_CRC8) | PROTO_CHECKSUM_MASK(PROTO_CHECKSUM_CRC16) | PROTO_CHECKSUM_MASK(PROTO_CHECKSUM_CRC32)
+		);
+		ASSERT_EQ(res.response.getInfo.spiClock,     8000000);
+		ASSERT_EQ(res.response.getInfo.ioWidths,     PROTO_IO_WIDTH_SINGLE | PROTO_IO_WIDTH_QUAD);
+
+		ASSERT_EQ(pkt.checksum, PROTO_CHECKSUM_CRC8);
 	}
 
 	*data |= (1 << 1);
@@ -67,6 +78,9 @@ TEST(firmware_programmer, proto_getInfo) {
 			&prog, buffer.data(), buffer.size(), _requestGetInfoCallback, _responseGetInfoCallback, &callbackData
 		);
 
+		programmer_setWindowSize(&prog, 2);
+		programmer_setSpiInfo(&prog, 8000000, PROTO_IO_WIDTH_SINGLE | PROTO_IO_WIDTH_QUAD);
+
 		{
 			std::vector<uint8_t> reqBuffer(1024, 0);
 			uint16_t             reqWritten;
@@ -99,6 +113,57 @@ TEST(firmware_programmer, proto_getInfo) {
 }
 
 
+static void _responseChecksumCallback(uint8_t *buffer, uint16_t bufferSize, void *callbackData) {
+	std::vector<uint8_t> *checksums = (std::vector<uint8_t> *) callbackData;
+
+	ProtoPkt pkt;
+	ProtoRes res;
+
+	pkt.checksum = 0xff;
+
+	_deserializeResponse(buffer, bufferSize, PROTO_CMD_GET_INFO, pkt, res);
+
+	ASSERT_EQ(pkt.code, PROTO_NO_ERROR);
+
+	checksums->push_back(pkt.checksum);
+}
+
+
+TEST(firmware_programmer, proto_checksum) {
+	std::vector<uint8_t> buffer(64, 0);
+	std::vector<uint8_t> checksums;
+
+	Programmer prog;
+
+	programmer_setup(
+		&prog, buffer.data(), buffer.size(), [](ProtoReq *, ProtoRes *, void *) {}, _responseChecksumCallback, &checksums
+	);
+
+	// Each response is protected with checksum of its request
+	for (uint8_t checksum : { PROTO_CHECKSUM_CRC32, PROTO_CHECKSUM_CRC8, PROTO_CHECKSUM_CRC16 }) {
+		std::vector<uint8_t> reqBuffer(64, 0);
+		uint16_t             reqWritten;
+
+		{
+			ProtoPkt pkt;
+
+			proto_pkt_init       (&pkt, reqBuffer.data(), reqBuffer.size(), PROTO_CMD_GET_INFO, 0x05);
+			proto_pkt_setChecksum(&pkt, reqBuffer.data(), reqBuffer.size(), checksum);
+
+			ASSERT_TRUE(proto_pkt_prepare(&pkt, reqBuffer.data(), reqBuffer.size(), 0));
+
+			reqWritten = proto_pkt_encode(&pkt, reqBuffer.data(), reqBuffer.size());
+		}
+
+		for (int i = 0; i < reqWritten; i++) {
+			programmer_putByte(&prog, reqBuffer[i]);
+		}
+	}
+
+	ASSERT_EQ(checksums, std::vector<uint8_t>({ PROTO_CHECKSUM_CRC32, PROTO_CHECKSUM_CRC8, PROTO_CHECKSUM_CRC16 }));
+}
+
+
 static void _requestTransferCallback(ProtoReq *request, ProtoRes *response, void *callbackData) {
 	uint8_t *data = (uint8_t *) callbackData;
 
@@ -218,3 +283,1309 @@ TEST(firmware_programmer, proto_transfer) {
 		ASSERT_EQ(callbackData, 0x03);
 	}
 }
+
+
+struct FlashReadTestData {
+	uint32_t address;
+	uint32_t length;
+
+	bool    csSelected;
+	uint32_t transfers;
+
+	std::vector<uint8_t> received;
+	uint32_t             frames;
+};
+
+
+static void _requestFlashReadCallback(ProtoReq *request, ProtoRes *response, void *callbackData) {
+	FlashReadTestData *data = (FlashReadTestData *) callbackData;
+
+	// Platforms handle only SPI transfers
+	if (request->cmd != PROTO_CMD_SPI_TRANSFER) {
+		return;
+	}
+
+	{
+		ProtoReqTransfer &req = request->request.transfer;
+		ProtoResTransfer &res = response->response.transfer;
+
+		if (data->transfers++ == 0) {
+			ASSERT_FALSE(data->csSelected);
+			ASSERT_EQ(req.txBufferSize, 4);
+			ASSERT_EQ(req.rxBufferSize, 0);
+
+			ASSERT_EQ(req.txBuffer[0], 0x03);
+			ASSERT_EQ(req.txBuffer[1], (data->address >> 16) & 0xff);
+			ASSERT_EQ(req.txBuffer[2], (data->address >>  8) & 0xff);
+			ASSERT_EQ(req.txBuffer[3], (data->address >>  0) & 0xff);
+
+		} else {
+			ASSERT_TRUE(data->csSelected);
+			ASSERT_EQ(req.txBufferSize, 0);
+
+			for (uint16_t i = 0; i < res.rxBufferSize; i++) {
+				res.rxBuffer[i] = data->address++;
+			}
+		}
+
+		data->csSelected = (req.flags & PROTO_SPI_TRANSFER_FLAG_KEEP_CS) != 0;
+	}
+}
+
+
+static void _responseFlashReadCallback(uint8_t *buffer, uint16_t bufferSize, void *callbackData) {
+	FlashReadTestData *data = (FlashReadTestData *) callbackData;
+
+	{
+		ProtoPkt pkt;
+		ProtoRes res;
+
+		_deserializeResponse(buffer, bufferSize, PROTO_CMD_FLASH_READ, pkt, res);
+
+		ASSERT_EQ(pkt.code, PROTO_NO_ERROR);
+		ASSERT_EQ(pkt.id,   0x07);
+
+		std::copy(res.response.flashRead.data, res.response.flashRead.data + res.response.flashRead.dataSize, std::back_inserter(data->received));
+	}
+
+	data->frames++;
+}
+
+
+TEST(firmware_programmer, proto_flashRead) {
+	std::vector<uint8_t> buffer(64, 0);
+
+	{
+		Programmer        prog;
+		FlashReadTestData data;
+
+		data.address    = 0x123456;
+		data.length     = 1000;
+		data.csSelected = false;
+		data.transfers  = 0;
+		data.frames     = 0;
+
+		programmer_setup(
+			&prog, buffer.data(), buffer.size(), _requestFlashReadCallback, _responseFlashReadCallback, &data
+		);
+
+		{
+			std::vector<uint8_t> reqBuffer(64, 0);
+			uint16_t             reqWritten;
+
+			{
+				ProtoPkt pkt;
+
+				proto_pkt_init(&pkt, reqBuffer.data(), reqBuffer.size(), PROTO_CMD_FLASH_READ, 0x07);
+
+				{
+					ProtoReq req;
+
+					proto_req_init(&req, pkt.payload, pkt.payloadSize, pkt.code);
+
+					req.request.flashRead.address = data.address;
+					req.request.flashRead.length  = data.length;
+
+					ASSERT_TRUE(proto_pkt_prepare(&pkt, reqBuffer.data(), reqBuffer.size(), proto_req_getPayloadSize(&req)));
+
+					proto_req_assign(&req, pkt.payload, pkt.payloadSize);
+					proto_req_encode(&req, pkt.payload, pkt.payloadSize);
+				}
+
+				reqWritten = proto_pkt_encode(&pkt, reqBuffer.data(), reqBuffer.size());
+			}
+
+			for (int i = 0; i < reqWritten; i++) {
+				programmer_putByte(&prog, reqBuffer[i]);
+			}
+		}
+
+		ASSERT_FALSE(data.csSelected);
+		ASSERT_GT(data.frames, 1);
+		ASSERT_EQ(data.received.size(), 1000);
+
+		for (size_t i = 0; i < data.received.size(); i++) {
+			ASSERT_EQ(data.received[i], (uint8_t)(0x56 + i));
+		}
+	}
+}
+
+
+static void _responseFlashCrc32Callback(uint8_t *buffer, uint16_t bufferSize, void *callbackData) {
+	FlashReadTestData *data = (FlashReadTestData *) callbackData;
+
+	{
+		ProtoPkt pkt;
+		ProtoRes res;
+
+		_deserializeResponse(buffer, bufferSize, PROTO_CMD_FLASH_CRC32, pkt, res);
+
+		ASSERT_EQ(pkt.code, PROTO_NO_ERROR);
+		ASSERT_EQ(pkt.id,   0x07);
+
+		for (int i = 0; i < 4; i++) {
+			data->received.push_back(res.response.flashCrc32.crc >> (24 - 8 * i));
+		}
+	}
+
+	data->frames++;
+}
+
+
+TEST(firmware_programmer, proto_flashCrc32) {
+	std::vector<uint8_t> buffer(64, 0);
+
+	{
+		Programmer        prog;
+		FlashReadTestData data;
+
+		data.address    = 0x000010;
+		data.length     = 1000;
+		data.csSelected = false;
+		data.transfers  = 0;
+		data.frames     = 0;
+
+		programmer_setup(
+			&prog, buffer.data(), buffer.size(), _requestFlashReadCallback, _responseFlashCrc32Callback, &data
+		);
+
+		{
+			std::vector<uint8_t> reqBuffer(64, 0);
+			uint16_t             reqWritten;
+
+			{
+				ProtoPkt pkt;
+
+				proto_pkt_init(&pkt, reqBuffer.data(), reqBuffer.size(), PROTO_CMD_FLASH_CRC32, 0x07);
+
+				{
+					ProtoReq req;
+
+					proto_req_init(&req, pkt.payload, pkt.payloadSize, pkt.code);
+
+					req.request.flashCrc32.address = data.address;
+					req.request.flashCrc32.length  = data.length;
+
+					ASSERT_TRUE(proto_pkt_prepare(&pkt, reqBuffer.data(), reqBuffer.size(), proto_req_getPayloadSize(&req)));
+
+					proto_req_assign(&req, pkt.payload, pkt.payloadSize);
+					proto_req_encode(&req, pkt.payload, pkt.payloadSize);
+				}
+
+				reqWritten = proto_pkt_encode(&pkt, reqBuffer.data(), reqBuffer.size());
+			}
+
+			for (int i = 0; i < reqWritten; i++) {
+				programmer_putByte(&prog, reqBuffer[i]);
+			}
+		}
+
+		ASSERT_FALSE(data.csSelected);
+		ASSERT_EQ(data.frames, 1);
+		ASSERT_EQ(data.received.size(), 4);
+
+		{
+			std::vector<uint8_t> flash(1000);
+			uint32_t             crc;
+
+			for (size_t i = 0; i < flash.size(); i++) {
+				flash[i] = 0x10 + i;
+			}
+
+			crc = crc32_get(flash.data(), flash.size(), CRC32_START);
+
+			ASSERT_EQ(data.received, std::vector<uint8_t>({
+				(uint8_t)(crc >> 24), (uint8_t)(crc >> 16), (uint8_t)(crc >> 8), (uint8_t)(crc >> 0)
+			}));
+		}
+	}
+}
+
+
+struct BlankCheckTestData {
+	std::vector<uint8_t> flash;
+	uint32_t             address;
+	uint32_t             bytesRead;
+	bool                 csSelected;
+
+	uint32_t offset;
+	uint32_t responses;
+};
+
+
+static void _requestBlankCheckCallback(ProtoReq *request, ProtoRes *response, void *callbackData) {
+	BlankCheckTestData *data = (BlankCheckTestData *) callbackData;
+
+	if (request->cmd != PROTO_CMD_SPI_TRANSFER) {
+		return;
+	}
+
+	{
+		ProtoReqTransfer &req = request->request.transfer;
+		ProtoResTransfer &res = response->response.transfer;
+
+		if (req.txBufferSize == 4) {
+			ASSERT_EQ(req.txBuffer[0], 0x03);
+
+			data->address = (req.txBuffer[1] << 16) | (req.txBuffer[2] << 8) | req.txBuffer[3];
+		}
+
+		for (uint16_t i = 0; i < req.rxBufferSize; i++) {
+			res.rxBuffer[i] = data->flash[data->address++];
+
+			data->bytesRead++;
+		}
+
+		data->csSelected = (req.flags & PROTO_SPI_TRANSFER_FLAG_KEEP_CS) != 0;
+	}
+}
+
+
+static void _responseBlankCheckCallback(uint8_t *buffer, uint16_t bufferSize, void *callbackData) {
+	BlankCheckTestData *data = (BlankCheckTestData *) callbackData;
+
+	{
+		ProtoPkt pkt;
+		ProtoRes res;
+
+		_deserializeResponse(buffer, bufferSize, PROTO_CMD_FLASH_BLANK_CHECK, pkt, res);
+
+		ASSERT_EQ(pkt.code, PROTO_NO_ERROR);
+
+		data->offset = res.response.flashBlankCheck.offset;
+	}
+
+	data->responses++;
+}
+
+
+static void _blankCheck(BlankCheckTestData &data, uint32_t address, uint32_t length) {
+	std::vector<uint8_t> buffer(32, 0);
+	Programmer           prog;
+
+	data.bytesRead  = 0;
+	data.responses  = 0;
+	data.csSelected = false;
+
+	programmer_setup(
+		&prog, buffer.data(), buffer.size(), _requestBlankCheckCallback, _responseBlankCheckCallback, &data
+	);
+
+	{
+		std::vector<uint8_t> reqBuffer(32, 0);
+		uint16_t             reqWritten;
+
+		{
+			ProtoPkt pkt;
+
+			proto_pkt_init(&pkt, reqBuffer.data(), reqBuffer.size(), PROTO_CMD_FLASH_BLANK_CHECK, 0x09);
+
+			{
+				ProtoReq req;
+
+				proto_req_init(&req, pkt.payload, pkt.payloadSize, pkt.code);
+
+				req.request.flashBlankCheck.address = address;
+				req.request.flashBlankCheck.length  = length;
+
+				ASSERT_TRUE(proto_pkt_prepare(&pkt, reqBuffer.data(), reqBuffer.size(), proto_req_getPayloadSize(&req)));
+
+				proto_req_assign(&req, pkt.payload, pkt.payloadSize);
+				proto_req_encode(&req, pkt.payload, pkt.payloadSize);
+			}
+
+			reqWritten = proto_pkt_encode(&pkt, reqBuffer.data(), reqBuffer.size());
+		}
+
+		for (int i = 0; i < reqWritten; i++) {
+			programmer_putByte(&prog, reqBuffer[i]);
+		}
+	}
+
+	ASSERT_EQ(data.responses, 1);
+	ASSERT_FALSE(data.csSelected);
+}
+
+
+TEST(firmware_programmer, proto_flashBlankCheck) {
+	BlankCheckTestData data;
+
+	data.flash = std::vector<uint8_t>(1024, 0xff);
+	data.flash[700] = 0x7f;
+
+	// Erased area
+	_blankCheck(data, 0, 700);
+
+	ASSERT_EQ(data.offset,    PROTO_FLASH_BLANK);
+	ASSERT_EQ(data.bytesRead, 700);
+
+	// Scan stops at first non erased byte
+	_blankCheck(data, 100, 900);
+
+	ASSERT_EQ(data.offset, 600);
+	ASSERT_LT(data.bytesRead, 900);
+
+	// Empty area
+	_blankCheck(data, 700, 0);
+
+	ASSERT_EQ(data.offset,    PROTO_FLASH_BLANK);
+	ASSERT_EQ(data.bytesRead, 0);
+}
+
+
+struct SpiPollTestData {
+	std::vector<std::vector<uint8_t>> transfers;
+	std::vector<uint8_t>              flags;
+
+	uint8_t  cmd;
+	uint8_t  busyPolls;
+	uint8_t  expectedStatus;
+	uint16_t expectedPolls;
+	uint32_t responses;
+};
+
+
+/*
+ * Records transfers, answers status reads with busy flag set for first
+ * busyPolls reads.
+ */
+static void _requestSpiPollCallback(ProtoReq *request, ProtoRes *response, void *callbackData) {
+	SpiPollTestData *data = (SpiPollTestData *) callbackData;
+
+	if (request->cmd != PROTO_CMD_SPI_TRANSFER) {
+		return;
+	}
+
+	{
+		ProtoReqTransfer &req = request->request.transfer;
+		ProtoResTransfer &res = response->response.transfer;
+
+		data->transfers.emplace_back(req.txBuffer, req.txBuffer + req.txBufferSize);
+		data->flags.push_back(req.flags);
+
+		if (req.rxBufferSize > 0) {
+			ASSERT_EQ(req.txBufferSize, 0);
+			ASSERT_EQ(req.rxBufferSize, 1);
+
+			if (data->busyPolls > 0) {
+				data->busyPolls--;
+
+				res.rxBuffer[0] = 0x03;
+
+			} else {
+				res.rxBuffer[0] = 0x00;
+			}
+		}
+	}
+}
+
+
+static void _responseSpiPollCallback(uint8_t *buffer, uint16_t bufferSize, void *callbackData) {
+	SpiPollTestData *data = (SpiPollTestData *) callbackData;
+
+	{
+		ProtoPkt pkt;
+		ProtoRes res;
+
+		_deserializeResponse(buffer, bufferSize, data->cmd, pkt, res);
+
+		ASSERT_EQ(pkt.code, PROTO_NO_ERROR);
+		ASSERT_EQ(pkt.id,   0x08);
+
+		if (data->cmd == PROTO_CMD_SPI_POLL) {
+			ASSERT_EQ(res.response.spiPoll.status, data->expectedStatus);
+			ASSERT_EQ(res.response.spiPoll.polls,  data->expectedPolls);
+
+		} else {
+			ASSERT_EQ(res.response.flashWritePage.status, data->expectedStatus);
+			ASSERT_EQ(res.response.flashWritePage.polls,  data->expectedPolls);
+		}
+	}
+
+	data->responses++;
+}
+
+
+static void _sendRequest(Programmer *prog, uint8_t cmd, std::function<void(ProtoReq &)> prepare, std::function<void(ProtoReq &)> fill, uint8_t id = 0x08) {
+	std::vector<uint8_t> reqBuffer(64, 0);
+	uint16_t             reqWritten;
+
+	{
+		ProtoPkt pkt;
+
+		proto_pkt_init(&pkt, reqBuffer.data(), reqBuffer.size(), cmd, id);
+
+		{
+			ProtoReq req;
+
+			proto_req_init(&req, pkt.payload, pkt.payloadSize, pkt.code);
+
+			prepare(req);
+
+			ASSERT_TRUE(proto_pkt_prepare(&pkt, reqBuffer.data(), reqBuffer.size(), proto_req_getPayloadSize(&req)));
+
+			proto_req_assign(&req, pkt.payload, pkt.payloadSize);
+			if (fill) {
+				fill(req);
+			}
+			proto_req_encode(&req, pkt.payload, pkt.payloadSize);
+		}
+
+		reqWritten = proto_pkt_encode(&pkt, reqBuffer.data(), reqBuffer.size());
+	}
+
+	for (int i = 0; i < reqWritten; i++) {
+		programmer_putByte(prog, reqBuffer[i]);
+	}
+}
+
+
+static void _assertPollTransfers(const SpiPollTestData &data, size_t first, uint8_t opcode, uint16_t polls) {
+	ASSERT_EQ(data.transfers.size(), first + 1 + polls + 1);
+
+	ASSERT_EQ(data.transfers[first], std::vector<uint8_t>({ opcode }));
+	ASSERT_NE(data.flags[first] & PROTO_SPI_TRANSFER_FLAG_KEEP_CS, 0);
+
+	for (size_t i = first + 1; i < first + 1 + polls; i++) {
+		ASSERT_TRUE(data.transfers[i].empty());
+		ASSERT_NE(data.flags[i] & PROTO_SPI_TRANSFER_FLAG_KEEP_CS, 0);
+	}
+
+	ASSERT_TRUE(data.transfers.back().empty());
+	ASSERT_EQ(data.flags.back() & PROTO_SPI_TRANSFER_FLAG_KEEP_CS, 0);
+}
+
+
+TEST(firmware_programmer, proto_flashWritePage) {
+	std::vector<uint8_t> buffer(64, 0);
+
+	{
+		Programmer      prog;
+		SpiPollTestData data;
+
+		data.cmd            = PROTO_CMD_FLASH_WRITE_PAGE;
+		data.busyPolls      = 3;
+		data.expectedStatus = 0x00;
+		data.expectedPolls  = 4;
+		data.responses      = 0;
+
+		programmer_setup(
+			&prog, buffer.data(), buffer.size(), _requestSpiPollCallback, _responseSpiPollCallback, &data
+		);
+
+		_sendRequest(
+			&prog, PROTO_CMD_FLASH_WRITE_PAGE,
+
+			[](ProtoReq &req) {
+				req.request.flashWritePage.address   = 0x010203;
+				req.request.flashWritePage.pollLimit = 100;
+				req.request.flashWritePage.dataSize  = 4;
+			},
+
+			[](ProtoReq &req) {
+				for (uint8_t i = 0; i < 4; i++) {
+					req.request.flashWritePage.data[i] = 0xa0 + i;
+				}
+			}
+		);
+
+		ASSERT_EQ(data.responses, 1);
+
+		ASSERT_EQ(data.transfers[0], std::vector<uint8_t>({ 0x06 }));
+		ASSERT_EQ(data.flags[0] & PROTO_SPI_TRANSFER_FLAG_KEEP_CS, 0);
+		ASSERT_EQ(data.transfers[1], std::vector<uint8_t>({ 0x02, 0x01, 0x02, 0x03 }));
+		ASSERT_NE(data.flags[1] & PROTO_SPI_TRANSFER_FLAG_KEEP_CS, 0);
+		ASSERT_EQ(data.transfers[2], std::vector<uint8_t>({ 0xa0, 0xa1, 0xa2, 0xa3 }));
+		ASSERT_EQ(data.flags[2] & PROTO_SPI_TRANSFER_FLAG_KEEP_CS, 0);
+
+		_assertPollTransfers(data, 3, 0x05, 4);
+	}
+
+	// RLE encoded page data, runs are expanded in chunks
+	{
+		Programmer      prog;
+		SpiPollTestData data;
+
+		data.cmd            = PROTO_CMD_FLASH_WRITE_PAGE;
+		data.busyPolls      = 0;
+		data.expectedStatus = 0x00;
+		data.expectedPolls  = 1;
+		data.responses      = 0;
+
+		programmer_setup(
+			&prog, buffer.data(), buffer.size(), _requestSpiPollCallback, _responseSpiPollCallback, &data
+		);
+
+		_sendRequest(
+			&prog, PROTO_CMD_FLASH_WRITE_PAGE,
+
+			[](ProtoReq &req) {
+				req.request.flashWritePage.address   = 0x000100;
+				req.request.flashWritePage.pollLimit = 100;
+				req.request.flashWritePage.flags     = PROTO_FLASH_WRITE_PAGE_FLAG_RLE;
+				req.request.flashWritePage.dataSize  = 5;
+			},
+
+			[](ProtoReq &req) {
+				std::vector<uint8_t> encoded({ 0x01, 0xa0, 0xa1, RLE_RUN_FLAG | (32 - RLE_RUN_MIN), 0xff });
+
+				std::copy(encoded.begin(), encoded.end(), req.request.flashWritePage.data);
+			}
+		);
+
+		ASSERT_EQ(data.responses, 1);
+
+		ASSERT_EQ(data.transfers[1], std::vector<uint8_t>({ 0x02, 0x00, 0x01, 0x00 }));
+
+		{
+			std::vector<uint8_t> expected({ 0xa0, 0xa1 });
+			std::vector<uint8_t> sent;
+
+			expected.resize(2 + 32, 0xff);
+
+			for (size_t i = 2; i < 5; i++) {
+				sent.insert(sent.end(), data.transfers[i].begin(), data.transfers[i].end());
+
+				ASSERT_NE(data.flags[i] & PROTO_SPI_TRANSFER_FLAG_KEEP_CS, 0);
+			}
+
+			ASSERT_EQ(sent, expected);
+		}
+
+		ASSERT_TRUE(data.transfers[5].empty());
+		ASSERT_EQ(data.flags[5] & PROTO_SPI_TRANSFER_FLAG_KEEP_CS, 0);
+
+		_assertPollTransfers(data, 6, 0x05, 1);
+	}
+}
+
+
+TEST(firmware_programmer, proto_spiPoll) {
+	std::vector<uint8_t> buffer(64, 0);
+
+	// Condition met
+	{
+		Programmer      prog;
+		SpiPollTestData data;
+
+		data.cmd            = PROTO_CMD_SPI_POLL;
+		data.busyPolls      = 5;
+		data.expectedStatus = 0x00;
+		data.expectedPolls  = 6;
+		data.responses      = 0;
+
+		programmer_setup(
+			&prog, buffer.data(), buffer.size(), _requestSpiPollCallback, _responseSpiPollCallback, &data
+		);
+
+		_sendRequest(
+			&prog, PROTO_CMD_SPI_POLL,
+
+			[](ProtoReq &req) {
+				req.request.spiPoll.opcode    = 0x35;
+				req.request.spiPoll.mask      = 0x01;
+				req.request.spiPoll.value     = 0x00;
+				req.request.spiPoll.pollLimit = 100;
+			},
+
+			{}
+		);
+
+		ASSERT_EQ(data.responses, 1);
+
+		_assertPollTransfers(data, 0, 0x35, 6);
+	}
+
+	// Poll limit reached
+	{
+		Programmer      prog;
+		SpiPollTestData data;
+
+		data.cmd            = PROTO_CMD_SPI_POLL;
+		data.busyPolls      = 50;
+		data.expectedStatus = 0x03;
+		data.expectedPolls  = 10;
+		data.responses      = 0;
+
+		programmer_setup(
+			&prog, buffer.data(), buffer.size(), _requestSpiPollCallback, _responseSpiPollCallback, &data
+		);
+
+		_sendRequest(
+			&prog, PROTO_CMD_SPI_POLL,
+
+			[](ProtoReq &req) {
+				req.request.spiPoll.opcode    = 0x05;
+				req.request.spiPoll.mask      = 0x01;
+				req.request.spiPoll.value     = 0x00;
+				req.request.spiPoll.pollLimit = 10;
+			},
+
+			{}
+		);
+
+		ASSERT_EQ(data.responses, 1);
+
+		_assertPollTransfers(data, 0, 0x05, 10);
+	}
+}
+
+
+struct FlashCompareTestData : BlankCheckTestData {
+	std::vector<uint8_t> bitmap;
+};
+
+
+static void _responseFlashCompareCallback(uint8_t *buffer, uint16_t bufferSize, void *callbackData) {
+	FlashCompareTestData *data = static_cast<FlashCompareTestData *>((BlankCheckTestData *) callbackData);
+
+	{
+		ProtoPkt pkt;
+		ProtoRes res;
+
+		_deserializeResponse(buffer, bufferSize, PROTO_CMD_FLASH_COMPARE, pkt, res);
+
+		ASSERT_EQ(pkt.code, PROTO_NO_ERROR);
+		ASSERT_EQ(pkt.id,   0x08);
+
+		data->bitmap.assign(
+			res.response.flashCompare.bitmap, res.response.flashCompare.bitmap + res.response.flashCompare.bitmapSize
+		);
+	}
+
+	data->responses++;
+}
+
+
+TEST(firmware_programmer, proto_flashCompare) {
+	const uint16_t pageSize  = 40;
+	const uint16_t pageCount = 10;
+
+	std::vector<uint8_t> buffer(64, 0);
+	std::vector<uint8_t> expected(pageSize * pageCount);
+
+	Programmer           prog;
+	FlashCompareTestData data;
+
+	for (size_t i = 0; i < expected.size(); i++) {
+		expected[i] = i * 7;
+	}
+
+	data.flash = expected;
+	data.flash[3 * pageSize + 17] ^= 0x01;
+	data.flash[9 * pageSize]      ^= 0x80;
+
+	data.bytesRead  = 0;
+	data.responses  = 0;
+	data.csSelected = false;
+
+	programmer_setup(
+		&prog, buffer.data(), buffer.size(), _requestBlankCheckCallback, _responseFlashCompareCallback, static_cast<BlankCheckTestData *>(&data)
+	);
+
+	_sendRequest(
+		&prog, PROTO_CMD_FLASH_COMPARE,
+
+		[&](ProtoReq &req) {
+			req.request.flashCompare.address   = 0;
+			req.request.flashCompare.pageSize  = pageSize;
+			req.request.flashCompare.pageCount = pageCount;
+		},
+
+		[&](ProtoReq &req) {
+			for (uint16_t page = 0; page < pageCount; page++) {
+				uint32_t crc = crc32_get(expected.data() + page * pageSize, pageSize, CRC32_START);
+				uint8_t *c   = req.request.flashCompare.crcs + 4 * page;
+
+				c[0] = crc >> 24;
+				c[1] = crc >> 16;
+				c[2] = crc >>  8;
+				c[3] = crc >>  0;
+			}
+		}
+	);
+
+	ASSERT_EQ(data.responses, 1);
+	ASSERT_FALSE(data.csSelected);
+	ASSERT_EQ(data.bytesRead, expected.size());
+
+	ASSERT_EQ(data.bitmap, std::vector<uint8_t>({ 0x08, 0x02 }));
+}
+
+
+struct RleTestData : BlankCheckTestData {
+	uint8_t              cmd;
+	std::vector<uint8_t> received;
+	std::vector<size_t>  frameSizes;
+};
+
+
+static void _responseRleCallback(uint8_t *buffer, uint16_t bufferSize, void *callbackData) {
+	RleTestData *data = static_cast<RleTestData *>((BlankCheckTestData *) callbackData);
+
+	{
+		ProtoPkt pkt;
+		ProtoRes res;
+
+		std::vector<uint8_t> decoded(1024);
+		int32_t              decodedSize;
+
+		_deserializeResponse(buffer, bufferSize, data->cmd, pkt, res);
+
+		ASSERT_EQ(pkt.code, PROTO_NO_ERROR);
+		ASSERT_EQ(pkt.id,   0x08);
+
+		if (data->cmd == PROTO_CMD_FLASH_READ) {
+			decodedSize = rle_decode(decoded.data(), decoded.size(), res.response.flashRead.data, res.response.flashRead.dataSize);
+
+		} else {
+			decodedSize = rle_decode(decoded.data(), decoded.size(), res.response.transfer.rxBuffer, res.response.transfer.rxBufferSize);
+		}
+
+		ASSERT_NE(decodedSize, RLE_ERROR);
+
+		data->received.insert(data->received.end(), decoded.begin(), decoded.begin() + decodedSize);
+		data->frameSizes.push_back(pkt.payloadSize);
+	}
+
+	data->responses++;
+}
+
+
+static void _setupRleTest(Programmer &prog, std::vector<uint8_t> &buffer, RleTestData &data, uint8_t cmd) {
+	data.flash = std::vector<uint8_t>(1024, 0xff);
+
+	// Some data at the beginning, fill pattern in the middle
+	for (size_t i = 0; i < 100; i++) {
+		data.flash[i] = i;
+	}
+
+	std::fill(data.flash.begin() + 500, data.flash.begin() + 600, 0x00);
+
+	data.cmd        = cmd;
+	data.bytesRead  = 0;
+	data.responses  = 0;
+	data.csSelected = false;
+
+	programmer_setup(
+		&prog, buffer.data(), buffer.size(), _requestBlankCheckCallback, _responseRleCallback, static_cast<BlankCheckTestData *>(&data)
+	);
+}
+
+
+TEST(firmware_programmer, proto_flashRead_rle) {
+	std::vector<uint8_t> buffer(64, 0);
+
+	Programmer  prog;
+	RleTestData data;
+
+	_setupRleTest(prog, buffer, data, PROTO_CMD_FLASH_READ);
+
+	_sendRequest(
+		&prog, PROTO_CMD_FLASH_READ,
+
+		[](ProtoReq &req) {
+			req.request.flashRead.address = 0;
+			req.request.flashRead.length  = 1024;
+			req.request.flashRead.flags   = PROTO_FLASH_READ_FLAG_RLE;
+		},
+
+		{}
+	);
+
+	ASSERT_FALSE(data.csSelected);
+	ASSERT_EQ(data.received, data.flash);
+
+	// Erased area is sent in a few bytes per frame
+	ASSERT_EQ(data.frameSizes.back(), 2);
+}
+
+
+TEST(firmware_programmer, proto_transfer_rle) {
+	std::vector<uint8_t> buffer(64, 0);
+
+	Programmer  prog;
+	RleTestData data;
+
+	_setupRleTest(prog, buffer, data, PROTO_CMD_SPI_TRANSFER);
+
+	_sendRequest(
+		&prog, PROTO_CMD_SPI_TRANSFER,
+
+		[](ProtoReq &req) {
+			auto &t = req.request.transfer;
+
+			t.flags        = PROTO_SPI_TRANSFER_FLAG_RLE;
+			t.txBufferSize = 4;
+			t.rxSkipSize   = 4;
+			t.rxBufferSize = rle_getMaxDecodedSize(59 - 4);
+		},
+
+		[](ProtoReq &req) {
+			auto &t = req.request.transfer;
+
+			t.txBuffer[0] = 0x03;
+			t.txBuffer[1] = 0x00;
+			t.txBuffer[2] = 0x01;
+			t.txBuffer[3] = 0x00;
+		}
+	);
+
+	ASSERT_EQ(data.responses, 1);
+	ASSERT_FALSE(data.csSelected);
+
+	ASSERT_EQ(data.received, std::vector<uint8_t>(data.flash.begin() + 0x100, data.flash.begin() + 0x100 + rle_getMaxDecodedSize(59 - 4)));
+	ASSERT_EQ(data.frameSizes.back(), 2);
+}
+
+
+static void _responseEmptyCallback(uint8_t *buffer, uint16_t bufferSize, void *callbackData) {
+	SpiPollTestData *data = (SpiPollTestData *) callbackData;
+
+	{
+		ProtoPkt pkt;
+		ProtoRes res;
+
+		_deserializeResponse(buffer, bufferSize, data->cmd, pkt, res);
+
+		ASSERT_EQ(pkt.code,        PROTO_NO_ERROR);
+		ASSERT_EQ(pkt.payloadSize, 0);
+	}
+
+	data->responses++;
+}
+
+
+TEST(firmware_programmer, proto_transfer_txRle) {
+	std::vector<uint8_t> buffer(64, 0);
+
+	Programmer      prog;
+	SpiPollTestData data;
+
+	data.cmd       = PROTO_CMD_SPI_TRANSFER;
+	data.responses = 0;
+
+	programmer_setup(
+		&prog, buffer.data(), buffer.size(), _requestSpiPollCallback, _responseEmptyCallback, &data
+	);
+
+	_sendRequest(
+		&prog, PROTO_CMD_SPI_TRANSFER,
+
+		[](ProtoReq &req) {
+			req.request.transfer.flags        = PROTO_SPI_TRANSFER_FLAG_TX_RLE | PROTO_SPI_TRANSFER_FLAG_KEEP_CS;
+			req.request.transfer.txBufferSize = 4;
+		},
+
+		[](ProtoReq &req) {
+			std::vector<uint8_t> encoded({ RLE_RUN_FLAG | (20 - RLE_RUN_MIN), 0x00, 0x00, 0x55 });
+
+			std::copy(encoded.begin(), encoded.end(), req.request.transfer.txBuffer);
+		}
+	);
+
+	ASSERT_EQ(data.responses, 1);
+
+	// CS is kept, no release transfer is done
+	ASSERT_EQ(data.transfers.size(), 3);
+
+	ASSERT_EQ(data.transfers[0], std::vector<uint8_t>(16, 0x00));
+	ASSERT_EQ(data.transfers[1], std::vector<uint8_t>(4,  0x00));
+	ASSERT_EQ(data.transfers[2], std::vector<uint8_t>({ 0x55 }));
+
+	for (auto flags : data.flags) {
+		ASSERT_NE(flags & PROTO_SPI_TRANSFER_FLAG_KEEP_CS, 0);
+	}
+}
+
+
+struct SpiBatchTestData : SpiPollTestData {
+	std::vector<uint8_t> received;
+};
+
+
+static void _responseSpiBatchCallback(uint8_t *buffer, uint16_t bufferSize, void *callbackData) {
+	SpiBatchTestData *data = static_cast<SpiBatchTestData *>((SpiPollTestData *) callbackData);
+
+	{
+		ProtoPkt pkt;
+		ProtoRes res;
+
+		_deserializeResponse(buffer, bufferSize, PROTO_CMD_SPI_BATCH, pkt, res);
+
+		ASSERT_EQ(pkt.code, PROTO_NO_ERROR);
+		ASSERT_EQ(pkt.id,   0x08);
+
+		data->received.assign(res.response.spiBatch.rxBuffer, res.response.spiBatch.rxBuffer + res.response.spiBatch.rxBufferSize);
+	}
+
+	data->responses++;
+}
+
+
+TEST(firmware_programmer, proto_spiBatch) {
+	std::vector<uint8_t> buffer(64, 0);
+
+	Programmer       prog;
+	SpiBatchTestData data;
+
+	data.cmd       = PROTO_CMD_SPI_BATCH;
+	data.busyPolls = 1;
+	data.responses = 0;
+
+	programmer_setup(
+		&prog, buffer.data(), buffer.size(), _requestSpiPollCallback, _responseSpiBatchCallback, static_cast<SpiPollTestData *>(&data)
+	);
+
+	{
+		// Two status reads, each one is an opcode transfer followed by a read releasing CS
+		std::vector<ProtoReqTransfer> transfers = {
+			{ NULL, 1, 0, 0, PROTO_SPI_TRANSFER_FLAG_KEEP_CS },
+			{ NULL, 0, 1, 0, 0 },
+			{ NULL, 1, 0, 0, PROTO_SPI_TRANSFER_FLAG_KEEP_CS },
+			{ NULL, 0, 1, 0, 0 }
+		};
+
+		auto encode = [&transfers](uint8_t *mem) {
+			uint16_t ret = 0;
+
+			for (auto &t : transfers) {
+				ProtoReq sub;
+				uint16_t size;
+
+				sub.cmd              = PROTO_CMD_SPI_TRANSFER;
+				sub.request.transfer = t;
+
+				size = proto_req_getPayloadSize(&sub);
+
+				if (mem != NULL) {
+					proto_req_assign(&sub, mem + ret, size);
+					if (sub.request.transfer.txBufferSize > 0) {
+						sub.request.transfer.txBuffer[0] = 0x05;
+					}
+					proto_req_encode(&sub, mem + ret, size);
+				}
+
+				ret += size;
+			}
+
+			return ret;
+		};
+
+		_sendRequest(
+			&prog, PROTO_CMD_SPI_BATCH,
+
+			[&](ProtoReq &req) {
+				req.request.spiBatch.transfersSize = encode(NULL);
+			},
+
+			[&](ProtoReq &req) {
+				encode(req.request.spiBatch.transfers);
+			}
+		);
+	}
+
+	ASSERT_EQ(data.responses, 1);
+	ASSERT_EQ(data.received, std::vector<uint8_t>({ 0x03, 0x00 }));
+
+	ASSERT_EQ(data.transfers.size(), 4);
+	ASSERT_EQ(data.flags, std::vector<uint8_t>({ PROTO_SPI_TRANSFER_FLAG_KEEP_CS, 0, PROTO_SPI_TRANSFER_FLAG_KEEP_CS, 0 }));
+
+	ASSERT_EQ(data.transfers[0], std::vector<uint8_t>({ 0x05 }));
+	ASSERT_EQ(data.transfers[2], std::vector<uint8_t>({ 0x05 }));
+}
+
+
+struct SpiConfigTestData {
+	// Clock and mode passed to the platform
+	uint32_t platformClock;
+	uint8_t  platformMode;
+	int      platformCalls;
+
+	ProtoResSpiConfig response;
+	int               responses;
+};
+
+
+static void _requestSpiConfigCallback(ProtoReq *request, ProtoRes *response, void *callbackData) {
+	SpiConfigTestData *data = (SpiConfigTestData *) callbackData;
+
+	ASSERT_EQ(request->cmd, PROTO_CMD_SPI_CONFIG);
+
+	data->platformClock = response->response.spiConfig.clock;
+	data->platformMode  = response->response.spiConfig.mode;
+	data->platformCalls++;
+
+	// Platform generates clocks being multiples of 1MHz only
+	response->response.spiConfig.clock -= response->response.spiConfig.clock % 1000000;
+}
+
+
+static void _responseSpiConfigCallback(uint8_t *buffer, uint16_t bufferSize, void *callbackData) {
+	SpiConfigTestData *data = (SpiConfigTestData *) callbackData;
+
+	ProtoPkt pkt;
+	ProtoRes res;
+
+	_deserializeResponse(buffer, bufferSize, PROTO_CMD_SPI_CONFIG, pkt, res);
+
+	data->response = res.response.spiConfig;
+	data->responses++;
+}
+
+
+TEST(firmware_programmer, proto_spiConfig) {
+	std::vector<uint8_t> buffer(64, 0);
+
+	struct {
+		uint32_t clock;
+		uint8_t  mode;
+
+		uint32_t expectedPlatformClock;
+		uint32_t expectedClock;
+	} cases[] = {
+		{ 12500000, PROTO_SPI_MODE_CPOL | PROTO_SPI_MODE_CPHA, 12500000, 12000000 },
+		// Maximal clock
+		{        0, 0,                                         62500000, 62000000 },
+		// Clamped to maximal clock
+		{ 80000000, PROTO_SPI_MODE_CPHA,                       62500000, 62000000 }
+	};
+
+	for (const auto &c : cases) {
+		Programmer        prog;
+		SpiConfigTestData data = {};
+
+		programmer_setup(
+			&prog, buffer.data(), buffer.size(), _requestSpiConfigCallback, _responseSpiConfigCallback, &data
+		);
+
+		programmer_setSpiInfo(&prog, 62500000, PROTO_IO_WIDTH_SINGLE);
+
+		_sendRequest(
+			&prog, PROTO_CMD_SPI_CONFIG,
+
+			[&c](ProtoReq &req) {
+				req.request.spiConfig.clock = c.clock;
+				req.request.spiConfig.mode  = c.mode;
+			},
+
+			{}
+		);
+
+		ASSERT_EQ(data.responses,      1);
+		ASSERT_EQ(data.platformCalls,  1);
+		ASSERT_EQ(data.platformClock,  c.expectedPlatformClock);
+		ASSERT_EQ(data.platformMode,   c.mode);
+		ASSERT_EQ(data.response.clock, c.expectedClock);
+		ASSERT_EQ(data.response.mode,  c.mode);
+	}
+}
+
+
+struct RetransmissionTestData {
+	// Number of SPI transfers done by the platform
+	int transfers;
+
+	std::vector<std::vector<uint8_t>> responses;
+};
+
+
+static void _requestRetransmissionCallback(ProtoReq *request, ProtoRes *response, void *callbackData) {
+	RetransmissionTestData *data = (RetransmissionTestData *) callbackData;
+
+	if (request->cmd != PROTO_CMD_SPI_TRANSFER) {
+		return;
+	}
+
+	for (uint16_t i = 0; i < response->response.transfer.rxBufferSize; i++) {
+		response->response.transfer.rxBuffer[i] = 0x5a + data->transfers;
+	}
+
+	data->transfers++;
+}
+
+
+static void _responseRetransmissionCallback(uint8_t *buffer, uint16_t bufferSize, void *callbackData) {
+	RetransmissionTestData *data = (RetransmissionTestData *) callbackData;
+
+	data->responses.emplace_back(buffer, buffer + bufferSize);
+}
+
+
+// Checks header of the response frame, payload of NAK is empty
+static void _assertResponse(const std::vector<uint8_t> &response, uint8_t code, uint8_t id) {
+	std::vector<uint8_t> buffer(response.size());
+
+	ProtoPktDes des;
+	ProtoPkt    pkt;
+	uint16_t    consumed;
+
+	proto_pkt_dec_setup(&des, buffer.data(), buffer.size());
+
+	ASSERT_EQ(proto_pkt_dec_putBytes(&des, response.data(), response.size(), &consumed, &pkt), PROTO_PKT_DES_RET_SET_ERROR_CODE(PROTO_NO_ERROR));
+	ASSERT_EQ(consumed, response.size());
+
+	ASSERT_EQ(pkt.code, code);
+	ASSERT_EQ(pkt.id,   id);
+
+	if (code != PROTO_NO_ERROR) {
+		ASSERT_EQ(pkt.payloadSize, 0);
+	}
+}
+
+
+TEST(firmware_programmer, proto_retransmission) {
+	std::vector<uint8_t> buffer(64, 0);
+
+	Programmer             prog;
+	RetransmissionTestData data = {};
+
+	programmer_setup(
+		&prog, buffer.data(), buffer.size(), _requestRetransmissionCallback, _responseRetransmissionCallback, &data
+	);
+
+	programmer_setWindowSize(&prog, 8);
+
+	auto writePage = [](ProtoReq &req) {
+		req.request.flashWritePage.pollLimit = 1;
+		req.request.flashWritePage.dataSize  = 4;
+	};
+
+	auto transfer = [](ProtoReq &req) {
+		req.request.transfer.txBufferSize = 1;
+		req.request.transfer.rxBufferSize = 8;
+		req.request.transfer.rxSkipSize   = 1;
+	};
+
+	auto flashRead = [](ProtoReq &req) {
+		req.request.flashRead.length = 8;
+	};
+
+	// Requests are not checked until a session is started
+	_sendRequest(&prog, PROTO_CMD_FLASH_WRITE_PAGE, writePage, {}, 0x30);
+	_sendRequest(&prog, PROTO_CMD_FLASH_WRITE_PAGE, writePage, {}, 0x30);
+
+	ASSERT_EQ(data.responses.size(), 2);
+	ASSERT_EQ(data.transfers,        2 * 6);
+
+	_sendRequest(&prog, PROTO_CMD_GET_INFO, [](ProtoReq &) {}, {}, 0x10);
+
+	ASSERT_EQ(data.responses.size(), 3);
+	{
+		std::vector<uint8_t> response(data.responses.back());
+
+		ProtoPkt pkt;
+		ProtoRes res;
+
+		_deserializeResponse(response.data(), response.size(), PROTO_CMD_GET_INFO, pkt, res);
+
+		ASSERT_NE(res.response.getInfo.features & PROTO_FEATURE_RETRANSMIT, 0);
+		ASSERT_EQ(res.response.getInfo.windowSize, PROGRAMMER_HISTORY_SIZE);
+	}
+
+	// Small response is remembered, retransmitted request is not executed again
+	data.transfers = 0;
+
+	_sendRequest(&prog, PROTO_CMD_FLASH_WRITE_PAGE, writePage, {}, 0x11);
+	_sendRequest(&prog, PROTO_CMD_FLASH_WRITE_PAGE, writePage, {}, 0x11);
+
+	ASSERT_EQ(data.transfers,        6);
+	ASSERT_EQ(data.responses.size(), 5);
+	ASSERT_EQ(data.responses[4],     data.responses[3]);
+
+	// Request following a lost one is not executed
+	_sendRequest(&prog, PROTO_CMD_SPI_TRANSFER, transfer, {}, 0x13);
+
+	ASSERT_EQ(data.transfers,        6);
+	ASSERT_EQ(data.responses.size(), 6);
+	_assertResponse(data.responses.back(), PROTO_ERROR_OUT_OF_SEQUENCE, 0x13);
+
+	// ID of other request
+	_sendRequest(&prog, PROTO_CMD_SPI_TRANSFER, transfer, {}, 0x11);
+
+	ASSERT_EQ(data.transfers,        6);
+	ASSERT_EQ(data.responses.size(), 7);
+	_assertResponse(data.responses.back(), PROTO_ERROR_OUT_OF_SEQUENCE, 0x11);
+
+	// Big response of not idempotent request is not remembered
+	_sendRequest(&prog, PROTO_CMD_SPI_TRANSFER, transfer, {}, 0x12);
+	_assertResponse(data.responses.back(), PROTO_NO_ERROR, 0x12);
+
+	_sendRequest(&prog, PROTO_CMD_SPI_TRANSFER, transfer, {}, 0x12);
+	_assertResponse(data.responses.back(), PROTO_ERROR_DUPLICATE, 0x12);
+
+	ASSERT_EQ(data.transfers,        7);
+	ASSERT_EQ(data.responses.size(), 9);
+
+	// Idempotent request is executed again
+	_sendRequest(&prog, PROTO_CMD_FLASH_READ, flashRead, {}, 0x13);
+	_sendRequest(&prog, PROTO_CMD_FLASH_READ, flashRead, {}, 0x13);
+
+	ASSERT_EQ(data.transfers,        7 + 2 * 2);
+	ASSERT_EQ(data.responses.size(), 11);
+	_assertResponse(data.responses.back(), PROTO_NO_ERROR, 0x13);
+
+	// The oldest requests are forgotten
+	for (uint8_t id = 0x14; id < 0x14 + PROGRAMMER_HISTORY_SIZE; id++) {
+		_sendRequest(&prog, PROTO_CMD_FLASH_WRITE_PAGE, writePage, {}, id);
+	}
+
+	ASSERT_EQ(data.responses.size(), 11 + PROGRAMMER_HISTORY_SIZE);
+
+	_sendRequest(&prog, PROTO_CMD_FLASH_WRITE_PAGE, writePage, {}, 0x11);
+
+	ASSERT_EQ(data.responses.size(), 11 + PROGRAMMER_HISTORY_SIZE + 1);
+	_assertResponse(data.responses.back(), PROTO_ERROR_OUT_OF_SEQUENCE, 0x11);
+}
+
+
+TEST(firmware_programmer, proto_nak) {
+	std::vector<uint8_t> buffer(64, 0);
+
+	Programmer             prog;
+	RetransmissionTestData data = {};
+
+	programmer_setup(
+		&prog, buffer.data(), buffer.size(), _requestRetransmissionCallback, _responseRetransmissionCallback, &data
+	);
+
+	_sendRequest(&prog, PROTO_CMD_GET_INFO, [](ProtoReq &) {}, {}, 0x10);
+
+	ASSERT_EQ(data.responses.size(), 1);
+
+	// Broken frame is answered at once with its ID
+	{
+		std::vector<uint8_t> frame(16, 0);
+
+		ProtoPkt pkt;
+
+		proto_pkt_init   (&pkt, frame.data(), frame.size(), PROTO_CMD_SPI_TRANSFER, 0x11);
+		proto_pkt_prepare(&pkt, frame.data(), frame.size(), 0);
+
+		frame.resize(proto_pkt_encode(&pkt, frame.data(), frame.size()));
+		frame.back() ^= 0x01;
+
+		programmer_putBytes(&prog, frame.data(), frame.size());
+	}
+
+	ASSERT_EQ(data.transfers,        0);
+	ASSERT_EQ(data.responses.size(), 2);
+	_assertResponse(data.responses.back(), PROTO_ERROR_INVALID_CRC, 0x11);
+
+	// Not executed, so the request sent again is not a duplicate
+	_sendRequest(&prog, PROTO_CMD_FLASH_WRITE_PAGE, [](ProtoReq &req) {
+		req.request.flashWritePage.pollLimit = 1;
+		req.request.flashWritePage.dataSize  = 4;
+	}, {}, 0x11);
+
+	ASSERT_EQ(data.transfers,        6);
+	ASSERT_EQ(data.responses.size(), 3);
+	_assertResponse(data.responses.back(), PROTO_NO_ERROR, 0x11);
+
+	// Unknown command
+	_sendRequest(&prog, 0x0f, [](ProtoReq &) {}, {}, 0x12);
+
+	ASSERT_EQ(data.transfers,        6);
+	ASSERT_EQ(data.responses.size(), 4);
+	_assertResponse(data.responses.back(), PROTO_ERROR_INVALID_CMD, 0x12);
+}
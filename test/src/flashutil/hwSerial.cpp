@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <termios.h>
+
+#include "flashutil/serial/hw.h"
+
+
+/*
+ * Pseudo terminal, HwSerial opens its slave side, the test talks to the master.
+ */
+class PseudoTerminal {
+	public:
+		PseudoTerminal() {
+			this->master = posix_openpt(O_RDWR | O_NOCTTY);
+
+			if (this->master >= 0) {
+				if (grantpt(this->master) != 0 || unlockpt(this->master) != 0) {
+					close(this->master);
+
+					this->master = -1;
+
+				} else {
+					struct termios options;
+
+					this->path = ptsname(this->master);
+
+					// Raw mode, echo would send written data back
+					tcgetattr(this->master, &options);
+					cfmakeraw(&options);
+					tcsetattr(this->master, TCSANOW, &options);
+				}
+			}
+		}
+
+		~PseudoTerminal() {
+			if (this->master >= 0) {
+				close(this->master);
+			}
+		}
+
+		void write(const std::vector<uint8_t> &data) {
+			for (size_t written = 0; written < data.size();) {
+				ssize_t ret = ::write(this->master, data.data() + written, data.size() - written);
+
+				ASSERT_GT(ret, 0);
+
+				written += ret;
+			}
+		}
+
+		std::vector<uint8_t> read(size_t size) {
+			std::vector<uint8_t> ret(size);
+
+			for (size_t received = 0; received < size;) {
+				ssize_t r = ::read(this->master, ret.data() + received, size - received);
+
+				if (r <= 0) {
+					ret.resize(received);
+					break;
+				}
+
+				received += r;
+			}
+
+			return ret;
+		}
+
+		int         master;
+		std::string path;
+};
+
+
+class HwSerialTest : public ::testing::TestWithParam<HwSerial::IoMode> {
+};
+
+
+TEST_P(HwSerialTest, write_read) {
+	PseudoTerminal pty;
+
+	if (pty.master < 0) {
+		GTEST_SKIP() << "Pseudo terminals are not available";
+	}
+
+	HwSerial serial(pty.path, 115200, GetParam());
+
+	{
+		std::vector<uint8_t> data({ 0x01, 0x02, 0x03, 0x04 });
+
+		serial.write(data.data(), data.size(), 100);
+
+		ASSERT_EQ(pty.read(data.size()), data);
+	}
+
+	{
+		std::vector<uint8_t> data({ 0x10, 0x20, 0x30, 0x40, 0x50 });
+		std::vector<uint8_t> received(16);
+
+		pty.write(data);
+
+		serial.read(received.data(), 2, 1000);
+
+		ASSERT_EQ(received[0], 0x10);
+		ASSERT_EQ(received[1], 0x20);
+
+		// Remaining bytes are available, readSome does not wait for more than minSize
+		size_t size = 0;
+
+		while (size < 3) {
+			size += serial.readSome(received.data() + size, 1, received.size() - size, 1000);
+		}
+
+		ASSERT_EQ(size, 3);
+		ASSERT_EQ(std::vector<uint8_t>(received.begin(), received.begin() + 3), std::vector<uint8_t>({ 0x30, 0x40, 0x50 }));
+	}
+}
+
+
+TEST_P(HwSerialTest, timeout) {
+	PseudoTerminal pty;
+
+	if (pty.master < 0) {
+		GTEST_SKIP() << "Pseudo terminals are not available";
+	}
+
+	HwSerial serial(pty.path, 115200, GetParam());
+
+	uint8_t byte;
+
+	ASSERT_ANY_THROW(serial.read(&byte, 1, 50));
+}
+
+
+TEST_P(HwSerialTest, bulk_transfer) {
+	PseudoTerminal pty;
+
+	if (pty.master < 0) {
+		GTEST_SKIP() << "Pseudo terminals are not available";
+	}
+
+	HwSerial serial(pty.path, 115200, GetParam());
+
+	// More than the background ring buffer keeps
+	std::vector<uint8_t> data(200 * 1024);
+
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = i * 13;
+	}
+
+	std::thread writer([&pty, &data]() {
+		pty.write(data);
+	});
+
+	{
+		std::vector<uint8_t> received(data.size());
+
+		serial.read(received.data(), received.size(), 5000);
+
+		writer.join();
+
+		ASSERT_EQ(received, data);
+	}
+}
+
+
+INSTANTIATE_TEST_SUITE_P(flashutil_hw_serial, HwSerialTest,
+	testing::Values(HwSerial::IoMode::SYNC, HwSerial::IoMode::BACKGROUND)
+);
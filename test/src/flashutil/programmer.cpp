@@ -2,14 +2,19 @@
 #include <libgen.h>
 #include <gtest/gtest.h>
 
+#include "common/protocol.h"
+
 #include "flashutil/spi/serial.h"
 #include "flashutil/serial/hw.h"
+#include "flashutil/serial/capture.h"
+#include "flashutil/serial/replay.h"
 #include "flashutil/programmer.h"
 #include "flashutil/entryPoint.h"
 #include "flashutil/flash/registry/reader/json.h"
 #include "flashutil/debug.h"
 
 #include "serialProgrammer.h"
+#include "virtualLink.h"
 
 #define PAGE_SIZE        (16)
 #define PAGE_COUNT       (32)
@@ -24,6 +29,17 @@
 
 #define PAYLOAD_SIZE 13
 
+// Big enough to carry whole page in a single frame
+#define LARGE_PAYLOAD_SIZE 64
+
+// Frames big enough to be protected with CRC16 and CRC32 checksums
+#define CRC16_PAYLOAD_SIZE 512
+#define CRC32_PAYLOAD_SIZE 5000
+
+// Frames of high RAM programmers, the biggest one exceeds VLEN range
+#define HUGE_PAYLOAD_SIZE (16 * 1024)
+#define MAX_PAYLOAD_SIZE  0xffff
+
 
 static FlashRegistry &getFlashRegistry() {
 	static FlashRegistry registry;
@@ -44,7 +60,7 @@ static FlashRegistry &getFlashRegistry() {
 }
 
 
-static std::unique_ptr<Serial> createSerial(Flash &info) {
+static std::unique_ptr<Serial> createSerial(Flash &info, size_t payloadSize = PAYLOAD_SIZE) {
 	const char *path = getenv("TEST_SERIAL_PATH");
 
 	if (path != nullptr) {
@@ -72,7 +88,7 @@ static std::unique_ptr<Serial> createSerial(Flash &info) {
 
 		info.setProtectMask(0x8c);
 
-		return std::make_unique<SerialProgrammer>(info, PAYLOAD_SIZE);
+		return std::make_unique<SerialProgrammer>(info, payloadSize);
 	}
 }
 
@@ -97,10 +113,530 @@ TEST(flashutil_entry_point, detect_flash) {
 }
 
 
-TEST(flashutil_entry_point, write_erase_block) {
+TEST(flashutil_entry_point, spi_capabilities) {
+	using Operation = Spi::Capabilities::Operation;
+
+	Flash flashInfo;
+
+	std::unique_ptr<Serial> serial = createSerial(flashInfo, LARGE_PAYLOAD_SIZE);
+	std::unique_ptr<Spi>    spi    = std::make_unique<SerialSpi>(*serial.get());
+
+	// Before GET_INFO only plain transfers are assumed
+	ASSERT_EQ   (spi->getCapabilities().pipelineDepth(), 1);
+	ASSERT_FALSE(spi->getCapabilities().supports(Operation::FLASH_READ));
+
+	spi->attach();
+	{
+		const auto &caps = spi->getCapabilities();
+
+		ASSERT_EQ(caps.frameSize(),     LARGE_PAYLOAD_SIZE);
+		ASSERT_EQ(caps.pipelineDepth(), 4);
+		ASSERT_EQ(caps.maxClock(),      0);
+		ASSERT_EQ(caps.ioWidths(),      Spi::Capabilities::IO_WIDTH_SINGLE);
+
+		for (auto op : {
+			Operation::FLASH_READ, Operation::FLASH_WRITE_PAGE, Operation::POLL, Operation::FLASH_CRC32,
+			Operation::FLASH_BLANK_CHECK, Operation::FLASH_COMPARE, Operation::BATCH
+		}) {
+			ASSERT_TRUE(caps.supports(op));
+		}
+	}
+	spi->detach();
+}
+
+
+
+TEST(flashutil_entry_point, spi_statistics) {
 	Flash flashInfo;
 
-	auto serial = createSerial(flashInfo);
+	std::unique_ptr<Serial> serial = createSerial(flashInfo, LARGE_PAYLOAD_SIZE);
+	SerialSpi               spi(*serial.get());
+	Programmer              programmer(spi, &getFlashRegistry());
+
+	programmer.begin(&flashInfo);
+	{
+		programmer.read(0, PAGE_SIZE);
+		programmer.writePage(0, std::vector<uint8_t>(PAGE_SIZE, 0x5a));
+	}
+	programmer.end();
+
+	{
+		const auto &statistics = spi.getStatistics();
+		const auto &commands   = statistics.commands();
+
+		for (auto name : {"GET_INFO", "FLASH_READ", "FLASH_WRITE_PAGE"}) {
+			ASSERT_NE(commands.find(name), commands.end()) << name;
+
+			const auto &c = commands.at(name);
+
+			ASSERT_GT(c.framesSent,      0) << name;
+			ASSERT_GT(c.framesReceived,  0) << name;
+			ASSERT_EQ(c.errors,          0) << name;
+			ASSERT_GT(c.txWire,          c.txPayload) << name;
+			ASSERT_GT(c.rxWire,          c.rxPayload) << name;
+			ASSERT_EQ(c.latency.count(), c.framesSent) << name;
+		}
+
+		ASSERT_GT(statistics.write.count(),  0);
+		ASSERT_GT(statistics.wait.count(),   0);
+		ASSERT_GT(statistics.decode.count(), 0);
+		ASSERT_GT(statistics.statusPolls,    0);
+	}
+}
+
+
+TEST(flashutil_entry_point, serial_capture_replay) {
+	Flash flashInfo;
+
+	std::unique_ptr<Serial> serial = createSerial(flashInfo, LARGE_PAYLOAD_SIZE);
+	std::stringstream       trace;
+
+	std::vector<uint8_t> page(PAGE_SIZE);
+	std::vector<uint8_t> pageRead;
+
+	for (size_t i = 0; i < page.size(); i++) {
+		page[i] = i * 7;
+	}
+
+	{
+		CaptureSerial capture(*serial.get(), trace);
+		SerialSpi     spi(capture);
+		Programmer    programmer(spi, &getFlashRegistry());
+
+		programmer.begin(&flashInfo);
+		{
+			programmer.writePage(PAGE_SIZE, page);
+
+			pageRead = programmer.read(PAGE_SIZE, PAGE_SIZE);
+		}
+		programmer.end();
+	}
+
+	ASSERT_EQ(pageRead, page);
+
+	// The same session is played back without the programmer
+	{
+		std::istringstream input(trace.str());
+		ReplaySerial       replay(input, ReplaySerial::Timing::FAST);
+		SerialSpi          spi(replay);
+		Programmer         programmer(spi, &getFlashRegistry());
+
+		programmer.begin(&flashInfo);
+		{
+			programmer.writePage(PAGE_SIZE, page);
+
+			ASSERT_EQ(programmer.read(PAGE_SIZE, PAGE_SIZE), page);
+		}
+		programmer.end();
+	}
+
+	// Diverging session is detected
+	{
+		std::istringstream input(trace.str());
+		ReplaySerial       replay(input, ReplaySerial::Timing::FAST);
+		SerialSpi          spi(replay);
+		uint32_t           crc;
+
+		spi.attach();
+
+		ASSERT_ANY_THROW(spi.flashCrc32(0, PAGE_SIZE, crc));
+	}
+}
+
+
+/*
+ * Passes calls to the wrapped serial, keeps SYNC bytes of written frames.
+ */
+class SyncRecordingSerial : public Serial {
+	public:
+		SyncRecordingSerial(Serial &serial) : serial(serial) {
+		}
+
+		void write(void *buffer, std::size_t bufferSize, int timeoutMs) override {
+			if (bufferSize > 0) {
+				this->syncs.push_back(*(uint8_t *) buffer & PROTO_SYNC_NIBBLE_MASK);
+			}
+
+			this->serial.write(buffer, bufferSize, timeoutMs);
+		}
+
+		void read(void *buffer, std::size_t bufferSize, int timeoutMs) override {
+			this->serial.read(buffer, bufferSize, timeoutMs);
+		}
+
+		std::size_t readSome(void *buffer, std::size_t minSize, std::size_t bufferSize, int timeoutMs) override {
+			return this->serial.readSome(buffer, minSize, bufferSize, timeoutMs);
+		}
+
+		int getBaudRate() override {
+			return this->serial.getBaudRate();
+		}
+
+		void setBaudRate(int baud) override {
+			this->serial.setBaudRate(baud);
+		}
+
+		Serial &serial;
+
+		std::vector<uint8_t> syncs;
+};
+
+
+TEST(flashutil_entry_point, serial_checksum_per_frame) {
+	Flash flashInfo;
+
+	std::unique_ptr<Serial> serial = createSerial(flashInfo, CRC32_PAYLOAD_SIZE);
+
+	if (dynamic_cast<SerialProgrammer *>(serial.get()) == nullptr) {
+		GTEST_SKIP() << "Checksums of frames are tested with simulated programmer only";
+	}
+
+	SyncRecordingSerial     recording(*serial.get());
+	SerialSpi               spi(recording);
+
+	spi.attach();
+
+	// Short request and its response
+	recording.syncs.clear();
+	{
+		Spi::Messages msgs;
+
+		msgs.add().send().byte(0x05);
+		msgs.at(0).recv().skip(1).bytes(1);
+
+		spi.transfer(msgs);
+	}
+	ASSERT_EQ(recording.syncs, std::vector<uint8_t>({ PROTO_SYNC_NIBBLE }));
+
+	// Short request answered with big response
+	recording.syncs.clear();
+	{
+		std::vector<uint8_t> data(PAGE_SIZE * PAGE_COUNT);
+
+		ASSERT_TRUE(spi.flashRead(0, data.data(), data.size()));
+	}
+	ASSERT_EQ(recording.syncs, std::vector<uint8_t>({ PROTO_SYNC_NIBBLE_CRC32 }));
+
+	// Big request, page program is ignored without write enable
+	recording.syncs.clear();
+	{
+		Spi::Messages msgs;
+
+		std::vector<uint8_t> data(CRC32_PAYLOAD_SIZE / 2);
+
+		for (size_t i = 0; i < data.size(); i++) {
+			data[i] = i * 7;
+		}
+
+		data[0] = 0x02;
+
+		msgs.add().send().data(data.data(), data.size());
+
+		spi.transfer(msgs);
+	}
+	ASSERT_EQ(recording.syncs, std::vector<uint8_t>({ PROTO_SYNC_NIBBLE_CRC16 }));
+}
+
+
+/*
+ * Time of reading size bytes by plain transfers over virtual link.
+ */
+static std::chrono::microseconds _getVirtualLinkReadTime(const VirtualLink::Profile &profile, uint8_t windowSize, size_t size) {
+	Flash flashInfo;
+
+	std::unique_ptr<Serial> serial = createSerial(flashInfo, LARGE_PAYLOAD_SIZE);
+
+	auto programmerSerial = dynamic_cast<SerialProgrammer *>(serial.get());
+	if (programmerSerial == nullptr) {
+		return std::chrono::microseconds(0);
+	}
+
+	programmerSerial->setWindowSize(windowSize);
+
+	{
+		VirtualLink link(*serial.get(), profile);
+		SerialSpi   spi(link);
+
+		spi.attach();
+
+		{
+			Spi::Messages msgs;
+
+			msgs.add().recv().bytes(size);
+
+			auto begin = std::chrono::steady_clock::now();
+
+			spi.transfer(msgs);
+
+			return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin);
+		}
+	}
+}
+
+
+TEST(flashutil_entry_point, virtual_link_latency) {
+	if (getenv("TEST_SERIAL_PATH") != nullptr) {
+		GTEST_SKIP() << "Virtual link is tested with simulated programmer only";
+	}
+
+	// Every request waits for USB frames in both directions
+	ASSERT_GE(_getVirtualLinkReadTime(VirtualLink::Profile::pico(), 1, 8), std::chrono::microseconds(1000));
+
+	// Request and response bytes are sent by UART, short response waits for the latency timer
+	ASSERT_GE(_getVirtualLinkReadTime(VirtualLink::Profile::ftdi(115200, 4000), 1, 8), std::chrono::microseconds(4000));
+}
+
+
+TEST(flashutil_entry_point, virtual_link_pipelining) {
+	if (getenv("TEST_SERIAL_PATH") != nullptr) {
+		GTEST_SKIP() << "Virtual link is tested with simulated programmer only";
+	}
+
+	// Read split into 16 frames
+	auto stopAndWait = _getVirtualLinkReadTime(VirtualLink::Profile::pico(), 1, 16 * 48);
+	auto pipelined   = _getVirtualLinkReadTime(VirtualLink::Profile::pico(), 4, 16 * 48);
+
+	ASSERT_LT(pipelined * 3, stopAndWait * 2);
+}
+
+TEST(flashutil_entry_point, virtual_link_nak) {
+	Flash flashInfo;
+
+	std::unique_ptr<Serial> serial = createSerial(flashInfo, LARGE_PAYLOAD_SIZE);
+
+	auto programmerSerial = dynamic_cast<SerialProgrammer *>(serial.get());
+	if (programmerSerial == nullptr) {
+		GTEST_SKIP() << "Virtual link is tested with simulated programmer only";
+	}
+
+	programmerSerial->setWindowSize(4);
+
+	VirtualLink link(*serial.get(), VirtualLink::Profile::pico());
+	SerialSpi   spi(link);
+
+	spi.attach();
+
+	programmerSerial->setCorruption(5, 0);
+	{
+		Spi::Messages msgs;
+
+		msgs.add().recv().bytes(64 * 48);
+
+		auto begin = std::chrono::steady_clock::now();
+
+		spi.transfer(msgs);
+
+		auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin);
+
+		auto retries = spi.getStatistics().commands().at("SPI_TRANSFER").retries;
+
+		// Broken requests are answered at once, nothing waits for timeout or for silence on the link (20 ms)
+		ASSERT_GT(retries, 2);
+		ASSERT_LT(elapsed.count(), retries * 20) << retries;
+	}
+	programmerSerial->setCorruption(0, 0);
+}
+
+
+TEST(flashutil_entry_point, spi_clock_calibration) {
+	Flash flashInfo;
+
+	std::unique_ptr<Serial> serial = createSerial(flashInfo, LARGE_PAYLOAD_SIZE);
+
+	auto programmerSerial = dynamic_cast<SerialProgrammer *>(serial.get());
+	if (programmerSerial == nullptr) {
+		GTEST_SKIP() << "Calibration is tested with simulated programmer only";
+	}
+
+	programmerSerial->setSpiClock(16000000, 3000000);
+
+	// The fastest of 16, 8, 4, 2 and 1MHz which reads the same as the slowest one
+	{
+		SerialSpi  spi(*serial.get());
+		Programmer programmer(spi, &getFlashRegistry());
+
+		programmer.begin(&flashInfo);
+		{
+			ASSERT_EQ(spi.getConfig().clock(), 2000000);
+
+			auto data = programmer.read(0, PAGE_SIZE);
+
+			ASSERT_EQ(data, std::vector<uint8_t>(PAGE_SIZE, 0xff));
+		}
+		programmer.end();
+	}
+
+	// Explicitly configured clock is not calibrated
+	{
+		SerialSpi  spi(*serial.get());
+		Programmer programmer(spi, &getFlashRegistry());
+
+		spi.setConfig(Spi::Config().clock(1000000).mode(0));
+
+		programmer.begin(&flashInfo);
+		{
+			ASSERT_EQ(spi.getConfig().clock(), 1000000);
+		}
+		programmer.end();
+	}
+}
+
+
+
+TEST(flashutil_entry_point, serial_baud_upgrade) {
+	Flash flashInfo;
+
+	std::unique_ptr<Serial> serial = createSerial(flashInfo, LARGE_PAYLOAD_SIZE);
+
+	auto programmerSerial = dynamic_cast<SerialProgrammer *>(serial.get());
+	if (programmerSerial == nullptr) {
+		GTEST_SKIP() << "Baud upgrade is tested with simulated programmer only";
+	}
+
+	// The fastest rate accepted by the programmer within the limit
+	{
+		programmerSerial->setBaudRates(115200, {500000, 1000000, 2000000}, 2000000);
+
+		SerialSpi  spi(*serial.get());
+		Programmer programmer(spi, &getFlashRegistry());
+
+		spi.setMaxBaudRate(1000000);
+
+		programmer.begin(&flashInfo);
+		{
+			ASSERT_EQ(serial->getBaudRate(),                   1000000);
+			ASSERT_EQ(programmerSerial->getProgrammerBaudRate(), 1000000);
+
+			auto data = programmer.read(0, PAGE_SIZE);
+
+			ASSERT_EQ(data, std::vector<uint8_t>(PAGE_SIZE, 0xff));
+		}
+		programmer.end();
+	}
+
+	// Rate accepted by the programmer but not working on the link is abandoned
+	{
+		programmerSerial->setBaudRates(115200, {1000000, 2000000}, 1000000);
+
+		SerialSpi  spi(*serial.get());
+		Programmer programmer(spi, &getFlashRegistry());
+
+		spi.setMaxBaudRate(2000000);
+
+		auto begin = std::chrono::steady_clock::now();
+
+		programmer.begin(&flashInfo);
+		{
+			// Programmer of the simulator reverts the rate at once, so the host does not wait for the whole confirmation window
+			ASSERT_LT(std::chrono::steady_clock::now() - begin, std::chrono::milliseconds(PROTO_SERIAL_BAUD_TIMEOUT_MS));
+
+			ASSERT_EQ(serial->getBaudRate(),                   1000000);
+			ASSERT_EQ(programmerSerial->getProgrammerBaudRate(), 1000000);
+
+			auto data = programmer.read(0, PAGE_SIZE);
+
+			ASSERT_EQ(data, std::vector<uint8_t>(PAGE_SIZE, 0xff));
+		}
+		programmer.end();
+	}
+
+	// Upgrade is disabled by default
+	{
+		programmerSerial->setBaudRates(115200, {1000000}, 1000000);
+
+		SerialSpi  spi(*serial.get());
+		Programmer programmer(spi, &getFlashRegistry());
+
+		programmer.begin(&flashInfo);
+		{
+			ASSERT_EQ(serial->getBaudRate(), 115200);
+		}
+		programmer.end();
+	}
+}
+
+TEST(flashutil_entry_point, serial_retransmission) {
+	for (size_t payloadSize : {(size_t) PAYLOAD_SIZE, (size_t) LARGE_PAYLOAD_SIZE}) {
+		Flash flashInfo;
+
+		std::unique_ptr<Serial> serial = createSerial(flashInfo, payloadSize);
+
+		auto programmerSerial = dynamic_cast<SerialProgrammer *>(serial.get());
+		if (programmerSerial == nullptr) {
+			GTEST_SKIP() << "Retransmission is tested with simulated programmer only";
+		}
+
+		std::vector<uint8_t> data(PAGE_SIZE * PAGE_COUNT);
+
+		for (size_t i = 0; i < data.size(); i++) {
+			data[i] = i * 13;
+		}
+
+		SerialSpi  spi(*serial.get());
+		Programmer programmer(spi, &getFlashRegistry());
+
+		programmer.begin(&flashInfo);
+		{
+			// GET_INFO of attach is not retransmitted
+			programmerSerial->setCorruption(17, 13);
+
+			for (size_t address = 0; address < data.size(); address += PAGE_SIZE) {
+				programmer.writePage(address, std::vector<uint8_t>(data.begin() + address, data.begin() + address + PAGE_SIZE));
+			}
+
+			ASSERT_EQ(programmer.read(0, data.size()), data) << payloadSize;
+
+			// Lost responses of plain transfers are not remembered, the whole transaction is repeated
+			programmerSerial->setCorruption(17, 181);
+
+			for (int i = 0; i < 8; i++) {
+				Spi::Messages cmd;
+				Spi::Messages msgs;
+
+				// CS transaction is split between transfers every other time
+				Spi::Messages &cmdMsgs = (i % 2) ? cmd : msgs;
+
+				cmdMsgs.add().send().byte(0x03).byte(0x00).byte(0x00).byte(0x00);
+				cmdMsgs.at(0).flags().chipDeselect(false);
+
+				msgs.add().recv().bytes(data.size());
+
+				if (cmd.count() > 0) {
+					spi.transfer(cmd);
+				}
+
+				spi.transfer(msgs);
+
+				ASSERT_EQ(msgs.at(msgs.count() - 1).recv().data(), data) << payloadSize;
+			}
+
+			programmerSerial->setCorruption(0, 0);
+		}
+		programmer.end();
+
+		{
+			uint64_t retries = 0;
+			uint64_t errors  = 0;
+
+			for (const auto &c : spi.getStatistics().commands()) {
+				retries += c.second.retries;
+				errors  += c.second.errors;
+			}
+
+			ASSERT_GT(retries, 0) << payloadSize;
+			ASSERT_GT(errors,  0) << payloadSize;
+
+			// Multi-frame response is resumed
+			ASSERT_GT(spi.getStatistics().commands().at("FLASH_READ").retries, 0) << payloadSize;
+		}
+	}
+}
+
+
+static void _writeEraseBlock(size_t payloadSize) {
+	Flash flashInfo;
+
+	auto serial = createSerial(flashInfo, payloadSize);
 
 	std::unique_ptr<Spi> spi = std::make_unique<SerialSpi>(*serial.get());
 
@@ -244,13 +780,164 @@ TEST(flashutil_entry_point, write_erase_block) {
 
 		flashutil::EntryPoint::call(*spi.get(), getFlashRegistry(), flashInfo, operations);
 	}
+
+	// Erases check the block before and after erasing, pages to be written are checked together with their chunk
+	{
+		auto &commands = spi->getStatistics().commands();
+
+		if (commands.count("FLASH_BLANK_CHECK") > 0) {
+			ASSERT_LE(commands.at("FLASH_BLANK_CHECK").framesSent, 2 * 4);
+		}
+	}
 }
 
 
-TEST(flashutil_entry_point, write_program_whole) {
+TEST(flashutil_entry_point, write_erase_block) {
+	_writeEraseBlock(PAYLOAD_SIZE);
+}
+
+
+TEST(flashutil_entry_point, write_erase_block_large_frames) {
+	_writeEraseBlock(LARGE_PAYLOAD_SIZE);
+}
+
+
+TEST(flashutil_entry_point, write_erase_block_crc16_frames) {
+	_writeEraseBlock(CRC16_PAYLOAD_SIZE);
+}
+
+
+TEST(flashutil_entry_point, write_erase_block_crc32_frames) {
+	_writeEraseBlock(CRC32_PAYLOAD_SIZE);
+}
+
+
+/*
+ * Geometry of 256 KiB chip with 64 KiB blocks, pages are as small as the simulated flash needs.
+ */
+static void _setLargeGeometry(Flash &info) {
+	info.setId({ 0x01, 0x02, 0x03 });
+
+	info.setBlockSize  (64 * 1024);
+	info.setBlockCount (4);
+	info.setSectorSize (4 * 1024);
+	info.setSectorCount(64);
+	info.setPageSize   (PAGE_SIZE);
+	info.setPageCount  (256 * 1024 / PAGE_SIZE);
+}
+
+
+TEST(flashutil_entry_point, read_large_chip) {
+	if (getenv("TEST_SERIAL_PATH") != nullptr) {
+		GTEST_SKIP() << "Large chip is tested with simulated programmer only";
+	}
+
+	// Reads longer than 64 KiB, decoded size of a frame is limited by uint16_t
+	Flash flashInfo;
+
+	_setLargeGeometry(flashInfo);
+
+	SerialProgrammer serial(flashInfo, HUGE_PAYLOAD_SIZE);
+	SerialSpi        spi(serial);
+	Programmer       programmer(spi, &getFlashRegistry());
+
+	std::vector<uint8_t> data(flashInfo.getSize(), 0xff);
+
+	programmer.begin(&flashInfo);
+	{
+		// Pages around 64 KiB boundary
+		for (uint32_t address = 0xff00; address < 0x10100; address += flashInfo.getPageSize()) {
+			std::vector<uint8_t> page(flashInfo.getPageSize());
+
+			for (size_t i = 0; i < page.size(); i++) {
+				page[i] = address + i * 7;
+			}
+
+			programmer.writePage(address, page);
+
+			std::copy(page.begin(), page.end(), data.begin() + address);
+		}
+
+		ASSERT_EQ(programmer.read(0, 0x10000), std::vector<uint8_t>(data.begin(), data.begin() + 0x10000));
+		ASSERT_EQ(programmer.read(0, 0x20000), std::vector<uint8_t>(data.begin(), data.begin() + 0x20000));
+		ASSERT_EQ(programmer.read(0, data.size()), data);
+	}
+	programmer.end();
+}
+
+
+TEST(flashutil_entry_point, virtual_link_broken_stream) {
+	if (getenv("TEST_SERIAL_PATH") != nullptr) {
+		GTEST_SKIP() << "Virtual link is tested with simulated programmer only";
+	}
+
+	Flash flashInfo;
+
+	_setLargeGeometry(flashInfo);
+
+	SerialProgrammer serial(flashInfo, LARGE_PAYLOAD_SIZE);
+
+	// Read takes longer than a single response timeout
+	std::vector<uint8_t> data(60 * 1024);
+
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = i * 13 + i / 256;
+	}
+
+	{
+		SerialSpi  spi(serial);
+		Programmer programmer(spi, &getFlashRegistry());
+
+		programmer.begin(&flashInfo);
+		{
+			for (size_t address = 0; address < data.size(); address += PAGE_SIZE) {
+				programmer.writePage(address, std::vector<uint8_t>(data.begin() + address, data.begin() + address + PAGE_SIZE));
+			}
+		}
+		programmer.end();
+	}
+
+	std::chrono::milliseconds cleanTime(0);
+
+	// Byte beyond the stream is never damaged
+	for (size_t offset : {SIZE_MAX / 2, (size_t) 3000, (size_t) 20000}) {
+		VirtualLink link(serial, VirtualLink::Profile::arduino(500000));
+		SerialSpi   spi(link);
+
+		std::vector<uint8_t> buffer(data.size());
+
+		spi.attach();
+
+		// Frames following the broken one are drained while the programmer keeps sending them
+		serial.corruptResponseByte(offset);
+
+		auto begin = std::chrono::steady_clock::now();
+
+		ASSERT_TRUE(spi.flashRead(0, buffer.data(), buffer.size()));
+		ASSERT_EQ(buffer, data) << offset;
+
+		auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin);
+
+		if (offset == SIZE_MAX / 2) {
+			// Longer than response timeout of the host (1 s)
+			ASSERT_GT(elapsed.count(), 1000);
+			ASSERT_EQ(spi.getStatistics().commands().at("FLASH_READ").retries, 0);
+
+			cleanTime = elapsed;
+
+		} else {
+			// Stream is drained and the rest of data is read again
+			ASSERT_EQ(spi.getStatistics().commands().at("FLASH_READ").retries, 1) << offset;
+			ASSERT_LT(elapsed, cleanTime * 3) << offset;
+		}
+	}
+}
+
+
+static void _writeProgramWhole(size_t payloadSize, flashutil::EntryPoint::VerifyMode verifyMode = flashutil::EntryPoint::VerifyMode::READ) {
 	Flash flashInfo;
 
-	auto serial = createSerial(flashInfo);
+	auto serial = createSerial(flashInfo, payloadSize);
 
 	std::unique_ptr<Spi> spi = std::make_unique<SerialSpi>(*serial.get());
 
@@ -318,6 +1005,7 @@ TEST(flashutil_entry_point, write_program_whole) {
 			params.mode                = flashutil::EntryPoint::Mode::CHIP;
 			params.omitRedundantWrites = false;
 			params.verify              = true;
+			params.verifyMode          = verifyMode;
 			params.inStream            = &srcData;
 			params.index               = 0;
 
@@ -341,3 +1029,28 @@ TEST(flashutil_entry_point, write_program_whole) {
 		ASSERT_EQ(randomData, readData.str());
 	}
 }
+
+
+TEST(flashutil_entry_point, write_program_whole) {
+	_writeProgramWhole(PAYLOAD_SIZE);
+}
+
+
+TEST(flashutil_entry_point, write_program_whole_large_frames) {
+	_writeProgramWhole(LARGE_PAYLOAD_SIZE);
+}
+
+
+TEST(flashutil_entry_point, write_program_whole_huge_frames) {
+	_writeProgramWhole(HUGE_PAYLOAD_SIZE);
+}
+
+
+TEST(flashutil_entry_point, write_program_whole_max_frames) {
+	_writeProgramWhole(MAX_PAYLOAD_SIZE);
+}
+
+
+TEST(flashutil_entry_point, write_program_whole_crc_verify) {
+	_writeProgramWhole(PAYLOAD_SIZE, flashutil::EntryPoint::VerifyMode::CRC);
+}
@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+#include <thread>
+
+#include "flashutil/ringBuffer.h"
+
+
+TEST(flashutil_ring_buffer, capacity) {
+	ASSERT_EQ(RingBuffer(1).capacity(),    1);
+	ASSERT_EQ(RingBuffer(100).capacity(),  128);
+	ASSERT_EQ(RingBuffer(4096).capacity(), 4096);
+}
+
+
+TEST(flashutil_ring_buffer, wrap_around) {
+	RingBuffer ring(8);
+
+	std::vector<uint8_t> out(8);
+
+	ASSERT_EQ(ring.write((const uint8_t *) "abcdef", 6), 6);
+	ASSERT_EQ(ring.read(out.data(), 4), 4);
+
+	ASSERT_EQ(ring.available(), 2);
+	ASSERT_EQ(ring.getFree(),   6);
+
+	// Contiguous area ends at the end of the buffer
+	{
+		std::size_t size;
+
+		ring.getWriteArea(size);
+
+		ASSERT_EQ(size, 2);
+	}
+
+	// Written data wraps around, the rest does not fit
+	ASSERT_EQ(ring.write((const uint8_t *) "ghijklmn", 8), 6);
+	ASSERT_EQ(ring.getFree(), 0);
+
+	ASSERT_EQ(ring.read(out.data(), out.size()), 8);
+	ASSERT_EQ(std::string(out.begin(), out.end()), "efghijkl");
+
+	ASSERT_EQ(ring.available(), 0);
+}
+
+
+TEST(flashutil_ring_buffer, clear) {
+	RingBuffer ring(16);
+
+	ring.write((const uint8_t *) "abc", 3);
+	ring.clear();
+
+	ASSERT_EQ(ring.available(), 0);
+	ASSERT_EQ(ring.getFree(),   16);
+}
+
+
+TEST(flashutil_ring_buffer, producer_consumer) {
+	RingBuffer ring(64);
+
+	const size_t dataSize = 64 * 1024;
+
+	std::thread producer([&ring, dataSize]() {
+		for (size_t i = 0; i < dataSize;) {
+			std::size_t size;
+			uint8_t    *area = ring.getWriteArea(size);
+
+			size = std::min(size, dataSize - i);
+
+			if (size == 0) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			for (size_t j = 0; j < size; j++) {
+				area[j] = (i + j) & 0xff;
+			}
+
+			ring.commit(size);
+
+			i += size;
+		}
+	});
+
+	{
+		std::vector<uint8_t> buffer(48);
+		size_t               received = 0;
+		bool                 valid    = true;
+
+		while (received < dataSize) {
+			size_t size = ring.read(buffer.data(), buffer.size());
+
+			if (size == 0) {
+				std::this_thread::yield();
+			}
+
+			for (size_t j = 0; j < size; j++) {
+				valid &= buffer[j] == ((received + j) & 0xff);
+			}
+
+			received += size;
+		}
+
+		ASSERT_TRUE(valid);
+	}
+
+	producer.join();
+}
@@ -1,4 +1,7 @@
+#include <cstdint>
 #include <cstring>
+#include <algorithm>
+#include <random>
 
 #include "serialProgrammer.h"
 
@@ -307,8 +310,41 @@ struct SerialProgrammer::Impl {
 	std::vector<uint8_t> packetBuffer;
 	std::vector<uint8_t> outputBuffer;
 	DummyFlash           flash;
+	uint32_t             spiClock;
+	uint32_t             reliableClock;
+
+	// Baud rates of both link sides, 0 when the link has no baud rate
+	int                  hostBaud;
+	int                  programmerBaud;
+	int                  previousBaud;
+	int                  pendingBaud;
+	int                  reliableBaud;
+	bool                 baudConfirmed;
+	std::vector<int>     acceptedBauds;
+
+	// Frames counted to damage every period-th one
+	size_t               requestPeriod;
+	size_t               responsePeriod;
+	std::minstd_rand     corruptionRandom;
+
+	// Bytes sent by the programmer and offset of the byte to be damaged, SIZE_MAX if none
+	size_t               responseBytes;
+	size_t               corruptedByte;
 
 	Impl(const Flash &flashInfo, size_t transferSize) : packetBuffer(transferSize), flash(flashInfo) {
+		this->spiClock       = 0;
+		this->reliableClock  = 0;
+		this->hostBaud       = 0;
+		this->programmerBaud = 0;
+		this->previousBaud   = 0;
+		this->pendingBaud    = 0;
+		this->reliableBaud   = 0;
+		this->baudConfirmed  = true;
+		this->requestPeriod  = 0;
+		this->responsePeriod = 0;
+		this->responseBytes  = 0;
+		this->corruptedByte  = SIZE_MAX;
+
 		programmer_setup(
 			&this->programmer,
 			this->packetBuffer.data(),
@@ -317,13 +353,45 @@ struct SerialProgrammer::Impl {
 			_programmerResponseCallback,
 			this
 		);
+
+		// Responses are buffered, so any number of requests can be queued.
+		programmer_setWindowSize(&this->programmer, 4);
 	}
 
 	void write(void *buffer, std::size_t bufferSize, int timeoutMs) {
 		uint8_t *bytes = reinterpret_cast<uint8_t *>(buffer);
 
-		for (size_t i = 0; i < bufferSize; i++) {
-			programmer_putByte(&this->programmer, bytes[i]);
+		if (this->hostBaud != this->programmerBaud || this->programmerBaud > this->reliableBaud) {
+			DEBUG("Dropped %zu bytes, host baud: %d, programmer baud: %d", bufferSize, this->hostBaud, this->programmerBaud);
+
+			// Programmer does not receive anything valid until confirmation timeout
+			if (! this->baudConfirmed) {
+				this->programmerBaud = this->previousBaud;
+				this->baudConfirmed  = true;
+			}
+
+			return;
+		}
+
+		this->baudConfirmed = true;
+
+		// Every write carries a single frame, the host's buffer is left intact
+		std::vector<uint8_t> damaged;
+
+		if (this->requestPeriod != 0 && bufferSize > 0 && (this->corruptionRandom() % this->requestPeriod) == 0) {
+			damaged.assign(bytes, bytes + bufferSize);
+			damaged.back() ^= 0x01;
+
+			bytes = damaged.data();
+		}
+
+		while (bufferSize > 0) {
+			uint16_t chunkSize = std::min<size_t>(bufferSize, UINT16_MAX);
+
+			programmer_putBytes(&this->programmer, bytes, chunkSize);
+
+			bytes      += chunkSize;
+			bufferSize -= chunkSize;
 		}
 	}
 
@@ -340,6 +408,15 @@ struct SerialProgrammer::Impl {
 		this->outputBuffer.erase(beg, end);
 	}
 
+	// Everything buffered is available at once, like responses queued in the serial port driver
+	size_t readSome(void *buffer, std::size_t minSize, std::size_t bufferSize, int timeoutMs) {
+		size_t size = std::max(minSize, std::min(bufferSize, this->outputBuffer.size()));
+
+		this->read(buffer, size, timeoutMs);
+
+		return size;
+	}
+
 	static void _programmerRequestCallback(ProtoReq *request, ProtoRes *response, void *callbackData) {
 		Impl *self = reinterpret_cast<Impl *>(callbackData);
 
@@ -368,6 +445,11 @@ struct SerialProgrammer::Impl {
 							received = self->flash.transfer(0xff);
 						}
 
+						// Bit slip caused by too fast clock
+						if (self->reliableClock != 0 && self->spiClock > self->reliableClock) {
+							received = (received << 1) | 0x01;
+						}
+
 						if (toRecv) {
 							if (i >= req.rxSkipSize) {
 								res.rxBuffer[i - req.rxSkipSize] = received;
@@ -387,6 +469,24 @@ struct SerialProgrammer::Impl {
 				}
 				break;
 
+			case PROTO_CMD_SPI_CONFIG:
+				{
+					self->spiClock = response->response.spiConfig.clock;
+				}
+				break;
+
+			case PROTO_CMD_SERIAL_BAUD:
+				{
+					int baud = request->request.serialBaud.baud;
+
+					if (self->programmerBaud != 0 && std::find(self->acceptedBauds.begin(), self->acceptedBauds.end(), baud) != self->acceptedBauds.end()) {
+						self->pendingBaud = baud;
+
+						response->response.serialBaud.baud = baud;
+					}
+				}
+				break;
+
 			default:
 				break;
 		}
@@ -398,6 +498,24 @@ struct SerialProgrammer::Impl {
 		TRACE("CALL");
 
 		std::copy(buffer, buffer + bufferSize, std::back_inserter(self->outputBuffer));
+
+		if (self->responsePeriod != 0 && bufferSize > 0 && (self->corruptionRandom() % self->responsePeriod) == 0) {
+			self->outputBuffer.back() ^= 0x01;
+		}
+
+		if (self->corruptedByte >= self->responseBytes && self->corruptedByte - self->responseBytes < bufferSize) {
+			self->outputBuffer[self->outputBuffer.size() - bufferSize + self->corruptedByte - self->responseBytes] ^= 0x01;
+		}
+
+		self->responseBytes += bufferSize;
+
+		// New rate is used once the response is sent
+		if (self->pendingBaud != 0) {
+			self->previousBaud   = self->programmerBaud;
+			self->programmerBaud = self->pendingBaud;
+			self->pendingBaud    = 0;
+			self->baudConfirmed  = false;
+		}
 	}
 };
 
@@ -419,3 +537,55 @@ void SerialProgrammer::write(void *buffer, std::size_t bufferSize, int timeoutMs
 void SerialProgrammer::read(void *buffer, std::size_t bufferSize, int timeoutMs) {
 	this->_self->read(buffer, bufferSize, timeoutMs);
 }
+
+
+void SerialProgrammer::setSpiClock(uint32_t maxClock, uint32_t reliableClock) {
+	programmer_setSpiInfo(&this->_self->programmer, maxClock, PROTO_IO_WIDTH_SINGLE);
+
+	this->_self->reliableClock = reliableClock;
+}
+
+
+void SerialProgrammer::setWindowSize(uint8_t windowSize) {
+	programmer_setWindowSize(&this->_self->programmer, windowSize);
+}
+
+
+void SerialProgrammer::setBaudRates(int baud, const std::vector<int> &accepted, int reliableBaud) {
+	this->_self->hostBaud       = baud;
+	this->_self->programmerBaud = baud;
+	this->_self->acceptedBauds  = accepted;
+	this->_self->reliableBaud   = reliableBaud;
+}
+
+
+int SerialProgrammer::getProgrammerBaudRate() const {
+	return this->_self->programmerBaud;
+}
+
+
+void SerialProgrammer::setCorruption(size_t requestPeriod, size_t responsePeriod) {
+	this->_self->requestPeriod  = requestPeriod;
+	this->_self->responsePeriod = responsePeriod;
+	this->_self->corruptionRandom.seed();
+}
+
+
+void SerialProgrammer::corruptResponseByte(size_t offset) {
+	this->_self->corruptedByte = this->_self->responseBytes + offset;
+}
+
+
+int SerialProgrammer::getBaudRate() {
+	return this->_self->hostBaud;
+}
+
+
+void SerialProgrammer::setBaudRate(int baud) {
+	this->_self->hostBaud = baud;
+}
+
+
+std::size_t SerialProgrammer::readSome(void *buffer, std::size_t minSize, std::size_t bufferSize, int timeoutMs) {
+	return this->_self->readSome(buffer, minSize, bufferSize, timeoutMs);
+}
@@ -13,6 +13,48 @@ class SerialProgrammer : public Serial {
 
 		virtual void write(void *buffer, std::size_t bufferSize, int timeoutMs) override;
 		virtual void read(void *buffer, std::size_t bufferSize, int timeoutMs) override;
+		virtual std::size_t readSome(void *buffer, std::size_t minSize, std::size_t bufferSize, int timeoutMs) override;
+
+		virtual int  getBaudRate() override;
+		virtual void setBaudRate(int baud) override;
+
+		/*
+		 * Reports maxClock by GET_INFO. Data read by the flash is corrupted while
+		 * SPI clock set by SPI_CONFIG exceeds reliableClock.
+		 */
+		void setSpiClock(uint32_t maxClock, uint32_t reliableClock);
+
+		/*
+		 * Number of requests processed without waiting for responses, 4 by
+		 * default.
+		 */
+		void setWindowSize(uint8_t windowSize);
+
+		/*
+		 * Simulates UART link with initial baud rate. SERIAL_BAUD accepts rates
+		 * from accepted list, data sent with different rates on both sides or
+		 * with rate above reliableBaud is lost.
+		 */
+		void setBaudRates(int baud, const std::vector<int> &accepted, int reliableBaud);
+
+		/*
+		 * Rate used by the programmer side of the link.
+		 */
+		int getProgrammerBaudRate() const;
+
+		/*
+		 * Damages checksum of on average every requestPeriod-th frame received
+		 * by the programmer and every responsePeriod-th frame sent by it, 0
+		 * disables damaging in given direction. Frames are picked randomly, but
+		 * the sequence is the same after every call.
+		 */
+		void setCorruption(size_t requestPeriod, size_t responsePeriod);
+
+		/*
+		 * Damages a single byte sent by the programmer, offset is counted from
+		 * the first byte sent after the call.
+		 */
+		void corruptResponseByte(size_t offset);
 
 	private:
 		class Impl;
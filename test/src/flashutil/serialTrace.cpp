@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <sstream>
+#include <algorithm>
+
+#include "flashutil/serial/capture.h"
+#include "flashutil/serial/replay.h"
+#include "flashutil/serial/trace.h"
+
+
+/*
+ * Answers each write with its bytes reversed after a delay.
+ */
+class DelayedEchoSerial : public Serial {
+	public:
+		DelayedEchoSerial(int delayMs) : _delayMs(delayMs) {
+		}
+
+		void write(void *buffer, std::size_t bufferSize, int timeoutMs) override {
+			const uint8_t *bytes = (const uint8_t *) buffer;
+
+			this->_pending.assign(bytes, bytes + bufferSize);
+
+			std::reverse(this->_pending.begin(), this->_pending.end());
+		}
+
+		void read(void *buffer, std::size_t bufferSize, int timeoutMs) override {
+			if (bufferSize > this->_pending.size()) {
+				throw std::runtime_error("Timeout");
+			}
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(this->_delayMs));
+
+			std::copy(this->_pending.begin(), this->_pending.begin() + bufferSize, (uint8_t *) buffer);
+
+			this->_pending.erase(this->_pending.begin(), this->_pending.begin() + bufferSize);
+		}
+
+		int getBaudRate() override {
+			return 115200;
+		}
+
+	private:
+		int                  _delayMs;
+		std::vector<uint8_t> _pending;
+};
+
+
+static std::string _captureSession() {
+	std::ostringstream output;
+
+	DelayedEchoSerial echo(30);
+	CaptureSerial     capture(echo, output);
+
+	uint8_t data[4] = { 1, 2, 3, 4 };
+	uint8_t rx[4];
+
+	capture.write(data, sizeof(data), 100);
+	capture.read(rx, 2, 100);
+	capture.read(rx + 2, 2, 100);
+
+	capture.setBaudRate(1000000);
+
+	EXPECT_ANY_THROW(capture.read(rx, 1, 100));
+
+	return output.str();
+}
+
+
+static void _replaySession(ReplaySerial &replay) {
+	uint8_t data[4] = { 1, 2, 3, 4 };
+	uint8_t rx[4];
+
+	ASSERT_EQ(replay.getBaudRate(), 115200);
+
+	// Writes may be split differently than during capture
+	replay.write(data,     1, 100);
+	replay.write(data + 1, 3, 100);
+
+	// Chunk recorded later is not available yet
+	ASSERT_EQ(replay.readSome(rx,     1, sizeof(rx), 100), 2);
+	ASSERT_EQ(replay.readSome(rx + 2, 2, 2,          100), 2);
+	ASSERT_EQ(std::vector<uint8_t>(rx, rx + 4), std::vector<uint8_t>({ 4, 3, 2, 1 }));
+
+	replay.setBaudRate(1000000);
+
+	ASSERT_EQ(replay.getBaudRate(), 1000000);
+
+	ASSERT_ANY_THROW(replay.read(rx, 1, 100));
+}
+
+
+TEST(flashutil_serial_trace, records) {
+	std::istringstream  input(_captureSession());
+	SerialTrace::Record record;
+
+	record.timeUs = 0;
+
+	ASSERT_EQ(SerialTrace::readHeader(input), 115200);
+
+	for (auto type : { SerialTrace::Type::WRITE, SerialTrace::Type::READ, SerialTrace::Type::READ, SerialTrace::Type::BAUD, SerialTrace::Type::TIMEOUT }) {
+		ASSERT_TRUE(SerialTrace::readRecord(input, record));
+		ASSERT_EQ  (record.type, type);
+	}
+
+	ASSERT_FALSE(SerialTrace::readRecord(input, record));
+
+	// Both reads waited for the echo
+	ASSERT_GE(record.timeUs, 60000);
+}
+
+
+TEST(flashutil_serial_trace, replay_timing) {
+	std::string trace = _captureSession();
+
+	for (auto timing : { ReplaySerial::Timing::ORIGINAL, ReplaySerial::Timing::FAST }) {
+		std::istringstream input(trace);
+		ReplaySerial       replay(input, timing);
+
+		auto begin = std::chrono::steady_clock::now();
+
+		_replaySession(replay);
+
+		auto elapsed = std::chrono::steady_clock::now() - begin;
+
+		if (timing == ReplaySerial::Timing::ORIGINAL) {
+			ASSERT_GE(elapsed, std::chrono::milliseconds(60));
+
+		} else {
+			ASSERT_LT(elapsed, std::chrono::milliseconds(30));
+		}
+	}
+}
+
+
+TEST(flashutil_serial_trace, replay_mismatch) {
+	std::istringstream input(_captureSession());
+	ReplaySerial       replay(input, ReplaySerial::Timing::FAST);
+
+	uint8_t data[4] = { 1, 2, 0, 4 };
+
+	ASSERT_ANY_THROW(replay.write(data, sizeof(data), 100));
+}
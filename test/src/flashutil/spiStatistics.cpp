@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+
+#include "flashutil/spi.h"
+
+
+TEST(flashutil_spi_statistics, histogram) {
+	Spi::Statistics::Histogram h;
+
+	ASSERT_EQ(h.count(),           0);
+	ASSERT_EQ(h.min(),             0);
+	ASSERT_EQ(h.percentile(0.5),   0);
+
+	for (uint64_t value : {0, 1, 2, 3, 100, 100, 100, 5000}) {
+		h.add(value);
+	}
+
+	ASSERT_EQ(h.count(), 8);
+	ASSERT_EQ(h.sum(),   5306);
+	ASSERT_EQ(h.min(),   0);
+	ASSERT_EQ(h.max(),   5000);
+	ASSERT_EQ(h.mean(),  663);
+
+	ASSERT_EQ(h.bucket(0),  1);
+	ASSERT_EQ(h.bucket(1),  1);
+	ASSERT_EQ(h.bucket(2),  2);
+	ASSERT_EQ(h.bucket(7),  3);
+	ASSERT_EQ(h.bucket(13), 1);
+
+	// Upper bounds of buckets, limited by the maximal value
+	ASSERT_EQ(h.percentile(0.25), 1);
+	ASSERT_EQ(h.percentile(0.5),  3);
+	ASSERT_EQ(h.percentile(0.75), 127);
+	ASSERT_EQ(h.percentile(1.0),  5000);
+
+	h.reset();
+
+	ASSERT_EQ(h.count(), 0);
+	ASSERT_EQ(h.max(),   0);
+}
+
+
+TEST(flashutil_spi_statistics, reset) {
+	Spi::Statistics statistics;
+
+	statistics.command("GET_INFO").framesSent++;
+	statistics.write.add(10);
+	statistics.statusPolls = 5;
+
+	ASSERT_EQ(statistics.commands().size(), 1);
+
+	statistics.reset();
+
+	ASSERT_TRUE(statistics.commands().empty());
+	ASSERT_EQ  (statistics.write.count(), 0);
+	ASSERT_EQ  (statistics.statusPolls,   0);
+}
@@ -0,0 +1,350 @@
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <condition_variable>
+
+#include "virtualLink.h"
+
+#include "flashutil/exception.h"
+#include "flashutil/debug.h"
+
+
+using Clock = std::chrono::steady_clock;
+
+
+VirtualLink::Profile VirtualLink::Profile::arduino(int baud) {
+	Profile ret;
+
+	ret.baud           = baud;
+	ret.usbFrameUs     = 1000;
+	ret.usbFrameBytes  = 640;
+	ret.usbPacketSize  = 64;
+	ret.latencyTimerUs = 1000;
+	ret.deviceChunkUs  = 40;
+	ret.deviceByteNs   = 2500;
+
+	return ret;
+}
+
+
+VirtualLink::Profile VirtualLink::Profile::ftdi(int baud, unsigned latencyTimerUs) {
+	Profile ret = arduino(baud);
+
+	ret.latencyTimerUs = latencyTimerUs;
+
+	return ret;
+}
+
+
+VirtualLink::Profile VirtualLink::Profile::pico() {
+	Profile ret;
+
+	ret.baud           = 0;
+	ret.usbFrameUs     = 1000;
+	ret.usbFrameBytes  = 13 * 64;
+	ret.usbPacketSize  = 64;
+	ret.latencyTimerUs = 0;
+	ret.deviceChunkUs  = 10;
+	ret.deviceByteNs   = 150;
+
+	return ret;
+}
+
+
+struct VirtualLink::Impl {
+	struct Chunk {
+		Clock::time_point    readyAt;
+		std::vector<uint8_t> data;
+	};
+
+	Serial &device;
+	Profile profile;
+
+	std::mutex              mutex;
+	std::condition_variable cond;
+	bool                    stop;
+
+	std::deque<Chunk> toDevice;
+	std::deque<Chunk> toHost;
+
+	// Origin of USB frames
+	Clock::time_point epoch;
+
+	// UART of each direction and the programmer are busy until
+	Clock::time_point hostTxFree;
+	Clock::time_point deviceTxFree;
+	Clock::time_point deviceFree;
+
+	std::thread thread;
+
+	Impl(Serial &device, const Profile &profile) : device(device), profile(profile) {
+		this->stop         = false;
+		this->epoch        = Clock::now();
+		this->hostTxFree   = this->epoch;
+		this->deviceTxFree = this->epoch;
+		this->deviceFree   = this->epoch;
+
+		this->thread = std::thread(&Impl::deviceLoop, this);
+	}
+
+	~Impl() {
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+
+			this->stop = true;
+		}
+
+		this->cond.notify_all();
+		this->thread.join();
+	}
+
+	std::chrono::nanoseconds byteTime() const {
+		// Start bit, 8 data bits and stop bit
+		return std::chrono::nanoseconds(this->profile.baud ? 10 * 1000000000ll / this->profile.baud : 0);
+	}
+
+	Clock::time_point nextFrame(Clock::time_point time) const {
+		if (this->profile.usbFrameUs == 0) {
+			return time;
+		}
+
+		{
+			auto frame = std::chrono::microseconds(this->profile.usbFrameUs);
+			auto count = (time - this->epoch + frame - std::chrono::nanoseconds(1)) / frame;
+
+			return this->epoch + count * frame;
+		}
+	}
+
+	// Splits data into chunks carried by consecutive USB frames
+	void scheduleUsb(std::deque<Chunk> &queue, Clock::time_point time, const uint8_t *data, std::size_t size) {
+		Clock::time_point frame = this->nextFrame(time);
+
+		for (std::size_t done = 0; done < size;) {
+			std::size_t chunkSize = size - done;
+
+			if (this->profile.usbFrameUs != 0) {
+				chunkSize = std::min(chunkSize, this->profile.usbFrameBytes);
+			}
+
+			queue.push_back({ frame, std::vector<uint8_t>(data + done, data + done + chunkSize) });
+
+			frame += std::chrono::microseconds(this->profile.usbFrameUs);
+			done  += chunkSize;
+		}
+	}
+
+	void write(const uint8_t *data, std::size_t size) {
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		std::size_t first = this->toDevice.size();
+
+		this->scheduleUsb(this->toDevice, Clock::now(), data, size);
+
+		// Bridge forwards data by UART
+		if (this->profile.baud != 0) {
+			for (std::size_t i = first; i < this->toDevice.size(); i++) {
+				Chunk &c = this->toDevice[i];
+
+				this->hostTxFree = std::max(c.readyAt, this->hostTxFree) + c.data.size() * this->byteTime();
+
+				c.readyAt = this->hostTxFree;
+			}
+		}
+
+		this->cond.notify_all();
+	}
+
+	// Response leaving the programmer at time
+	void scheduleResponse(Clock::time_point time, const uint8_t *data, std::size_t size) {
+		if (this->profile.baud == 0) {
+			this->scheduleUsb(this->toHost, time, data, size);
+
+			return;
+		}
+
+		{
+			Clock::time_point start = std::max(time, this->deviceTxFree);
+			std::size_t       packet = this->profile.usbFrameUs ? this->profile.usbPacketSize : size;
+
+			this->deviceTxFree = start + size * this->byteTime();
+
+			// Full packets go in the next frame, the last partial one waits for the latency timer
+			for (std::size_t done = 0; done < size;) {
+				std::size_t       chunkSize = std::min(packet, size - done);
+				Clock::time_point received  = start + (done + chunkSize) * this->byteTime();
+
+				if (chunkSize < packet) {
+					received += std::chrono::microseconds(this->profile.latencyTimerUs);
+				}
+
+				this->toHost.push_back({ this->nextFrame(received), std::vector<uint8_t>(data + done, data + done + chunkSize) });
+
+				done += chunkSize;
+			}
+		}
+	}
+
+	void deviceLoop() {
+		std::vector<uint8_t>         response(64 * 1024);
+		std::unique_lock<std::mutex> lock(this->mutex);
+
+		while (! this->stop) {
+			if (this->toDevice.empty()) {
+				this->cond.wait(lock);
+				continue;
+			}
+
+			if (this->toDevice.front().readyAt > Clock::now()) {
+				this->cond.wait_until(lock, this->toDevice.front().readyAt);
+				continue;
+			}
+
+			{
+				Chunk       chunk = std::move(this->toDevice.front());
+				std::size_t responseSize;
+
+				this->toDevice.pop_front();
+
+				// Device is used by this thread only
+				lock.unlock();
+				{
+					this->device.write(chunk.data.data(), chunk.data.size(), 0);
+
+					// Long streams (FLASH_READ) may not fit into the buffer at once
+					responseSize = 0;
+
+					while (true) {
+						std::size_t size = this->device.readSome(response.data() + responseSize, 0, response.size() - responseSize, 0);
+
+						if (size == 0) {
+							break;
+						}
+
+						responseSize += size;
+
+						if (responseSize == response.size()) {
+							response.resize(response.size() * 2);
+						}
+					}
+				}
+				lock.lock();
+
+				this->deviceFree = std::max(chunk.readyAt, this->deviceFree)
+					+ std::chrono::microseconds(this->profile.deviceChunkUs)
+					+ std::chrono::nanoseconds((uint64_t) this->profile.deviceByteNs * (chunk.data.size() + responseSize));
+
+				if (responseSize > 0) {
+					this->scheduleResponse(this->deviceFree, response.data(), responseSize);
+
+					this->cond.notify_all();
+				}
+			}
+		}
+	}
+
+	std::size_t getAvailable(Clock::time_point now) const {
+		std::size_t ret = 0;
+
+		for (const auto &c : this->toHost) {
+			if (c.readyAt > now) {
+				break;
+			}
+
+			ret += c.data.size();
+		}
+
+		return ret;
+	}
+
+	std::size_t readSome(uint8_t *buffer, std::size_t minSize, std::size_t bufferSize, int timeoutMs) {
+		std::unique_lock<std::mutex> lock(this->mutex);
+
+		Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMs ? timeoutMs : 100000000);
+
+		while (true) {
+			Clock::time_point now = Clock::now();
+
+			if (this->getAvailable(now) >= std::max<std::size_t>(minSize, 1) || (minSize == 0)) {
+				break;
+			}
+
+			if (now >= deadline) {
+				throw_Exception("Timeout occurred while waiting on data");
+			}
+
+			{
+				Clock::time_point wakeUp = deadline;
+
+				for (const auto &c : this->toHost) {
+					if (c.readyAt > now) {
+						wakeUp = std::min(wakeUp, c.readyAt);
+						break;
+					}
+				}
+
+				this->cond.wait_until(lock, wakeUp);
+			}
+		}
+
+		{
+			Clock::time_point now  = Clock::now();
+			std::size_t       done = 0;
+
+			while (done < bufferSize && ! this->toHost.empty() && this->toHost.front().readyAt <= now) {
+				Chunk      &c    = this->toHost.front();
+				std::size_t size = std::min(bufferSize - done, c.data.size());
+
+				std::copy(c.data.begin(), c.data.begin() + size, buffer + done);
+
+				c.data.erase(c.data.begin(), c.data.begin() + size);
+				if (c.data.empty()) {
+					this->toHost.pop_front();
+				}
+
+				done += size;
+			}
+
+			return done;
+		}
+	}
+};
+
+
+VirtualLink::VirtualLink(Serial &device, const Profile &profile) {
+	this->_self = std::make_unique<Impl>(device, profile);
+}
+
+
+VirtualLink::~VirtualLink() {
+}
+
+
+void VirtualLink::write(void *buffer, std::size_t bufferSize, int timeoutMs) {
+	this->_self->write((const uint8_t *) buffer, bufferSize);
+}
+
+
+void VirtualLink::read(void *buffer, std::size_t bufferSize, int timeoutMs) {
+	this->readSome(buffer, bufferSize, bufferSize, timeoutMs);
+}
+
+
+std::size_t VirtualLink::readSome(void *buffer, std::size_t minSize, std::size_t bufferSize, int timeoutMs) {
+	return this->_self->readSome((uint8_t *) buffer, minSize, bufferSize, timeoutMs);
+}
+
+
+int VirtualLink::getBaudRate() {
+	return this->_self->profile.baud;
+}
+
+
+void VirtualLink::setBaudRate(int baud) {
+	std::lock_guard<std::mutex> lock(this->_self->mutex);
+
+	this->_self->profile.baud = baud;
+}
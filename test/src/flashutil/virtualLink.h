@@ -0,0 +1,64 @@
+#ifndef FLASHUTIL_VIRTUALLINK_H_
+#define FLASHUTIL_VIRTUALLINK_H_
+
+#include <memory>
+
+#include "flashutil/serial.h"
+
+
+/*
+ * Serial link with timing of a real programmer connection. Bytes written by
+ * the host reach the device serial (e.g. SerialProgrammer) after the time
+ * needed by USB and UART, responses come back the same way. The device is
+ * served by a dedicated thread, so the host sees real latencies.
+ */
+class VirtualLink : public Serial {
+	public:
+		struct Profile {
+			// UART rate between the USB bridge and the programmer, 0 for native USB
+			int baud;
+
+			// USB frame period, data crosses USB only on frame boundaries, 0 without USB
+			unsigned usbFrameUs;
+
+			// Bytes carried by a single USB frame in each direction
+			std::size_t usbFrameBytes;
+
+			// Packet of the bridge, a full packet is sent to the host in the next frame
+			std::size_t usbPacketSize;
+
+			// Partial packet is held by the bridge for this time (FTDI latency timer)
+			unsigned latencyTimerUs;
+
+			// Programmer time spent on each received chunk and each byte of request and response
+			unsigned deviceChunkUs;
+			unsigned deviceByteNs;
+
+			// ATmega328P at 16MHz behind ATmega16U2 bridge (Arduino Uno)
+			static Profile arduino(int baud = 500000);
+
+			// ATmega328P at 16MHz behind FTDI FT232R, latency timer of Linux driver is 16ms by default
+			static Profile ftdi(int baud = 500000, unsigned latencyTimerUs = 16000);
+
+			// RP2040 with native USB CDC (Raspberry Pi Pico)
+			static Profile pico();
+		};
+
+	public:
+		VirtualLink(Serial &device, const Profile &profile);
+		virtual ~VirtualLink();
+
+		virtual void write(void *buffer, std::size_t bufferSize, int timeoutMs) override;
+		virtual void read(void *buffer, std::size_t bufferSize, int timeoutMs) override;
+		virtual std::size_t readSome(void *buffer, std::size_t minSize, std::size_t bufferSize, int timeoutMs) override;
+
+		virtual int  getBaudRate() override;
+		virtual void setBaudRate(int baud) override;
+
+	private:
+		class Impl;
+
+		std::unique_ptr<Impl> _self;
+};
+
+#endif /* FLASHUTIL_VIRTUALLINK_H_ */